@@ -49,8 +49,12 @@ public class JrSkeletalMeshMerger : ModuleRules
 				"UnrealEd",
                 "AssetRegistry",
 				"AnimToTexture",
+				"BlueprintGraph",
 				"MaterialEditor",
-				"RawMesh"
+				"RawMesh",
+				"MeshReductionInterface",
+				"SkeletalMeshUtilitiesCommon",
+				"TargetPlatform"
 				// ... add private dependencies that you statically link with here ...	
 			}
 			);
@@ -0,0 +1,116 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "JrChildMeshSetup.h"
+#include "AnimationRuntime.h"
+#include "Animation/MorphTarget.h"
+#include "Engine/SkeletalMesh.h"
+#include "Rendering/SkeletalMeshRenderData.h"
+
+EJrChildMeshMode FJrChildMeshSetup::Classify(const USkeletalMesh* ChildMesh, const USkeletalMesh* LeaderMesh, FName& OutBoneName)
+{
+	OutBoneName = NAME_None;
+	if (!ChildMesh || !LeaderMesh || !CanFollowLeaderPose(ChildMesh, LeaderMesh))
+	{
+		return EJrChildMeshMode::Independent;
+	}
+
+	OutBoneName = FindRigidBone(ChildMesh);
+	return OutBoneName.IsNone() ? EJrChildMeshMode::LeaderPose : EJrChildMeshMode::StaticOnBone;
+}
+
+bool FJrChildMeshSetup::CanFollowLeaderPose(const USkeletalMesh* ChildMesh, const USkeletalMesh* LeaderMesh, float Tolerance)
+{
+	const FSkeletalMeshRenderData* RenderData = const_cast<USkeletalMesh*>(ChildMesh)->GetResourceForRendering();
+	if (!RenderData || RenderData->LODRenderData.Num() == 0)
+	{
+		return false;
+	}
+
+	const FReferenceSkeleton& ChildRefSkeleton = ChildMesh->GetRefSkeleton();
+	const FReferenceSkeleton& LeaderRefSkeleton = LeaderMesh->GetRefSkeleton();
+	TSet<FBoneIndexType> CheckedBones;
+	for (const FSkeletalMeshLODRenderData& LODData : RenderData->LODRenderData)
+	{
+		for (const FSkelMeshRenderSection& Section : LODData.RenderSections)
+		{
+			for (const FBoneIndexType BoneIndex : Section.BoneMap)
+			{
+				bool bAlreadyChecked = false;
+				CheckedBones.Add(BoneIndex, &bAlreadyChecked);
+				if (bAlreadyChecked)
+				{
+					continue;
+				}
+
+				const int32 LeaderBoneIndex = LeaderRefSkeleton.FindBoneIndex(ChildRefSkeleton.GetBoneName(BoneIndex));
+				if (LeaderBoneIndex == INDEX_NONE)
+				{
+					return false;
+				}
+
+				// the follower gets the leader component space transforms, the child is skinned against its own reference pose
+				const FTransform ChildPose = FAnimationRuntime::GetComponentSpaceTransformRefPose(ChildRefSkeleton, BoneIndex);
+				const FTransform LeaderPose = FAnimationRuntime::GetComponentSpaceTransformRefPose(LeaderRefSkeleton, LeaderBoneIndex);
+				if (!ChildPose.Equals(LeaderPose, Tolerance))
+				{
+					return false;
+				}
+			}
+		}
+	}
+	return true;
+}
+
+FName FJrChildMeshSetup::FindRigidBone(const USkeletalMesh* Mesh)
+{
+	const FSkeletalMeshRenderData* RenderData = const_cast<USkeletalMesh*>(Mesh)->GetResourceForRendering();
+	if (!RenderData || RenderData->LODRenderData.Num() == 0 || Mesh->GetMorphTargets().Num() > 0 || Mesh->GetMeshClothingAssets().Num() > 0)
+	{
+		return NAME_None;
+	}
+
+	int32 RigidBone = INDEX_NONE;
+	for (const FSkeletalMeshLODRenderData& LODData : RenderData->LODRenderData)
+	{
+		const FSkinWeightVertexBuffer* SkinWeights = LODData.GetSkinWeightVertexBuffer();
+		for (const FSkelMeshRenderSection& Section : LODData.RenderSections)
+		{
+			for (uint32 VertIdx = Section.BaseVertexIndex; VertIdx < Section.BaseVertexIndex + Section.NumVertices; VertIdx++)
+			{
+				const FSkinWeightInfo Weights = SkinWeights->GetVertexSkinWeights(VertIdx);
+				int32 VertexBone = INDEX_NONE;
+				for (int32 Influence = 0; Influence < MAX_TOTAL_INFLUENCES; Influence++)
+				{
+					if (Weights.InfluenceWeights[Influence] == 0)
+					{
+						continue;
+					}
+					if (VertexBone != INDEX_NONE || !Section.BoneMap.IsValidIndex(Weights.InfluenceBones[Influence]))
+					{
+						return NAME_None;
+					}
+					VertexBone = Section.BoneMap[Weights.InfluenceBones[Influence]];
+				}
+
+				if (VertexBone == INDEX_NONE || (RigidBone != INDEX_NONE && VertexBone != RigidBone))
+				{
+					return NAME_None;
+				}
+				RigidBone = VertexBone;
+			}
+		}
+	}
+
+	return RigidBone != INDEX_NONE ? Mesh->GetRefSkeleton().GetBoneName(RigidBone) : NAME_None;
+}
+
+FTransform FJrChildMeshSetup::GetRigidMeshRelativeTransform(const USkeletalMesh* Mesh, FName BoneName)
+{
+	// the static mesh is the reference pose, the skinned vertices follow the bone by its inverse reference pose
+	const int32 BoneIndex = Mesh->GetRefSkeleton().FindBoneIndex(BoneName);
+	if (BoneIndex == INDEX_NONE)
+	{
+		return FTransform::Identity;
+	}
+	return FAnimationRuntime::GetComponentSpaceTransformRefPose(Mesh->GetRefSkeleton(), BoneIndex).Inverse();
+}
@@ -0,0 +1,143 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "JrCrowdBuilder.h"
+#include "JrSkeletalMergingLibrary.h"
+#include "SkeletalMergingLibrary.h"
+#include "Components/HierarchicalInstancedStaticMeshComponent.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Engine/SkeletalMesh.h"
+#include "Engine/StaticMesh.h"
+#include "GameFramework/Actor.h"
+#include "Misc/PackageName.h"
+#include "StaticMeshResources.h"
+#include "UObject/SavePackage.h"
+
+#include UE_INLINE_GENERATED_CPP_BY_NAME(JrCrowdBuilder)
+
+namespace JrCrowdBuilder
+{
+	/** Returns the static mesh of a merged character, converted once and saved under 'PackagePath'. */
+	static UStaticMesh* GetConvertedMesh(USkeletalMesh* SkeletalMesh, const FString& PackagePath, TMap<USkeletalMesh*, UStaticMesh*>& ConvertedMeshes)
+	{
+		if (UStaticMesh** ConvertedMesh = ConvertedMeshes.Find(SkeletalMesh))
+		{
+			return *ConvertedMesh;
+		}
+
+		UStaticMesh* StaticMesh = UJrSkeletalMergingLibrary::ConvertSkeletalMeshToStaticMesh(SkeletalMesh, PackagePath / TEXT("SM_") + SkeletalMesh->GetName());
+		if (StaticMesh)
+		{
+			UPackage* Package = StaticMesh->GetPackage();
+			FSavePackageArgs SaveArgs;
+			SaveArgs.TopLevelFlags = RF_Public | RF_Standalone;
+			UPackage::SavePackage(Package, StaticMesh, *FPackageName::LongPackageNameToFilename(Package->GetName(), FPackageName::GetAssetPackageExtension()), SaveArgs);
+		}
+		else
+		{
+			UE_LOG(LogSkeletalMeshMerge, Warning, TEXT("Crowd: %s could not be converted to a static mesh, its instances are skipped."), *SkeletalMesh->GetName());
+		}
+
+		ConvertedMeshes.Add(SkeletalMesh, StaticMesh);
+		return StaticMesh;
+	}
+
+	/** Returns the sections of a static mesh LOD 0, one draw each. */
+	static int32 GetNumDraws(const UStaticMesh* StaticMesh)
+	{
+		const FStaticMeshRenderData* RenderData = StaticMesh->GetRenderData();
+		return RenderData && RenderData->LODResources.Num() > 0 ? RenderData->LODResources[0].Sections.Num() : 1;
+	}
+}
+
+FJrCrowdBuildResult FJrCrowdBuilder::Build(AActor* Owner, const TArray<FJrCrowdInstance>& Instances, const FJrCrowdSettings& Settings)
+{
+	using namespace JrCrowdBuilder;
+
+	FJrCrowdBuildResult Result;
+	if (!Owner)
+	{
+		UE_LOG(LogSkeletalMeshMerge, Warning, TEXT("Crowd: no owner actor."));
+		return Result;
+	}
+
+	// 按Mesh分组, 每组一个实例化组件
+	TMap<USkeletalMesh*, UStaticMesh*> ConvertedMeshes;
+	TMap<UStaticMesh*, TArray<int32>> MeshInstances;
+	for (int32 InstanceIdx = 0; InstanceIdx < Instances.Num(); InstanceIdx++)
+	{
+		const FJrCrowdInstance& Instance = Instances[InstanceIdx];
+		UStaticMesh* StaticMesh = Instance.StaticMesh;
+		if (!StaticMesh && Instance.SkeletalMesh)
+		{
+			StaticMesh = GetConvertedMesh(Instance.SkeletalMesh, Settings.ConvertedMeshPath, ConvertedMeshes);
+		}
+
+		if (StaticMesh)
+		{
+			MeshInstances.FindOrAdd(StaticMesh).Add(InstanceIdx);
+		}
+		else
+		{
+			Result.NumSkippedInstances++;
+		}
+	}
+
+	const int32 NumCustomDataFloats = Settings.bWriteAnimationCustomData ? NumAnimationCustomData : 0;
+	TArray<FTransform> Transforms;
+	TArray<float> CustomData;
+	CustomData.SetNum(NumCustomDataFloats);
+	for (const TPair<UStaticMesh*, TArray<int32>>& Pair : MeshInstances)
+	{
+		UStaticMesh* StaticMesh = Pair.Key;
+		const TSubclassOf<UInstancedStaticMeshComponent> ComponentClass = Settings.bUseHierarchicalInstancing ?
+			UHierarchicalInstancedStaticMeshComponent::StaticClass() : UInstancedStaticMeshComponent::StaticClass();
+		UInstancedStaticMeshComponent* Component = NewObject<UInstancedStaticMeshComponent>(Owner, ComponentClass,
+			MakeUniqueObjectName(Owner, ComponentClass, *(TEXT("Crowd_") + StaticMesh->GetName())), RF_Transactional);
+		Component->SetStaticMesh(StaticMesh);
+		Component->SetMobility(EComponentMobility::Movable);
+		Component->SetCullDistances(Settings.InstanceStartCullDistance, Settings.InstanceEndCullDistance);
+		if (USceneComponent* RootComponent = Owner->GetRootComponent())
+		{
+			Component->SetupAttachment(RootComponent);
+		}
+		else
+		{
+			Owner->SetRootComponent(Component);
+		}
+		Owner->AddInstanceComponent(Component);
+		Component->RegisterComponent();
+
+		// 先设置CustomData数量, 批量添加的实例会分配好CustomData
+		Component->SetNumCustomDataFloats(NumCustomDataFloats);
+
+		Transforms.Reset(Pair.Value.Num());
+		for (const int32 InstanceIdx : Pair.Value)
+		{
+			Transforms.Add(Instances[InstanceIdx].Transform);
+		}
+		const TArray<int32> InstanceIndices = Component->AddInstances(Transforms, true, true);
+
+		if (NumCustomDataFloats > 0)
+		{
+			for (int32 Idx = 0; Idx < InstanceIndices.Num(); Idx++)
+			{
+				const FJrCrowdAnimation& Animation = Instances[Pair.Value[Idx]].Animation;
+				CustomData[AnimationIndexCustomData] = (float)Animation.AnimationIndex;
+				CustomData[FrameOffsetCustomData] = Animation.FrameOffset;
+				CustomData[PlayRateCustomData] = Animation.PlayRate;
+				Component->SetCustomData(InstanceIndices[Idx], CustomData, false);
+			}
+			Component->MarkRenderStateDirty();
+		}
+
+		const int32 NumDraws = GetNumDraws(StaticMesh);
+		Result.Components.Add(Component);
+		Result.NumInstances += InstanceIndices.Num();
+		Result.NumDrawCalls += NumDraws;
+		Result.NumDrawCallsWithoutInstancing += NumDraws * InstanceIndices.Num();
+	}
+
+	UE_LOG(LogSkeletalMeshMerge, Log, TEXT("Crowd: %d instances in %d components, %d draws instead of %d (%d instances skipped)."),
+		Result.NumInstances, Result.Components.Num(), Result.NumDrawCalls, Result.NumDrawCallsWithoutInstancing, Result.NumSkippedInstances);
+	return Result;
+}
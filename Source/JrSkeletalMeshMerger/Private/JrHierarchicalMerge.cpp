@@ -0,0 +1,323 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "JrHierarchicalMerge.h"
+#include "JrMergedMeshCache.h"
+#include "JrSkeletalMergingLibrary.h"
+#include "JrSkeletalMeshMergeFunc.h"
+#include "SkeletalMergingLibrary.h"
+#include "Async/ParallelFor.h"
+#include "Engine/SkeletalMesh.h"
+#include "Misc/SecureHash.h"
+#include "UObject/GarbageCollection.h"
+#include "UObject/Package.h"
+
+namespace JrHierarchicalMerge
+{
+	struct FCachedSubgroup
+	{
+		TStrongObjectPtr<USkeletalMesh> Mesh;
+		/** LOD 0 vertex sources, mesh indices relative to the first source of the subgroup. */
+		TArray<FIntPoint> VertexProvenance;
+	};
+
+	/** Intermediate meshes kept by bCacheSubgroups, by subgroup key. Only used on the game thread. */
+	static TMap<FString, FCachedSubgroup> SubgroupCache;
+
+	/** Keys of SubgroupCache, least recently used first. */
+	static TArray<FString> SubgroupCacheOrder;
+
+	/** Number of intermediate meshes SubgroupCache keeps, the least recently used ones are released first. */
+	static constexpr int32 MaxCachedSubgroups = 64;
+
+	static const FCachedSubgroup* FindCachedSubgroup(const FString& Key)
+	{
+		const FCachedSubgroup* Cached = SubgroupCache.Find(Key);
+		if (Cached)
+		{
+			SubgroupCacheOrder.Remove(Key);
+			SubgroupCacheOrder.Add(Key);
+		}
+		return Cached;
+	}
+
+	static FCachedSubgroup& AddCachedSubgroup(const FString& Key)
+	{
+		while (SubgroupCacheOrder.Num() >= MaxCachedSubgroups)
+		{
+			SubgroupCache.Remove(SubgroupCacheOrder[0]);
+			SubgroupCacheOrder.RemoveAt(0);
+		}
+		SubgroupCacheOrder.Remove(Key);
+		SubgroupCacheOrder.Add(Key);
+		return SubgroupCache.Add(Key);
+	}
+
+	/** Source mesh or intermediate mesh of the merge tree. */
+	struct FNode
+	{
+		USkeletalMesh* Mesh = nullptr;
+		TStrongObjectPtr<USkeletalMesh> Intermediate;
+		FString Key;
+		int32 FirstSource = 0;
+		TArray<FIntPoint> VertexProvenance;
+	};
+
+	/** Input and output of one intermediate merge, filled on the game thread and merged on a worker. */
+	struct FGroupMerge
+	{
+		int32 GroupIdx = INDEX_NONE;
+		TArray<USkeletalMesh*> Meshes;
+		FSkelMeshMergeUVTransformMapping UVTransforms;
+		TArray<FIntPoint> VertexProvenance;
+		TUniquePtr<FJrSkeletalMeshMerge> Merger;
+		bool bMerged = false;
+	};
+
+	/**
+	 * Splits 'NumNodes' nodes in the fewest consecutive groups of at most 'GroupSize' nodes, with balanced sizes
+	 * (with a group size of 3 or more and more nodes than a group, every group has at least 2 nodes).
+	 * @return first node and node count of each group
+	 */
+	static TArray<TPair<int32, int32>> MakeGroups(int32 NumNodes, int32 GroupSize)
+	{
+		const int32 NumGroups = FMath::DivideAndRoundUp(NumNodes, GroupSize);
+		TArray<TPair<int32, int32>> Groups;
+		Groups.Reserve(NumGroups);
+		int32 FirstNode = 0;
+		for (int32 GroupIdx = 0; GroupIdx < NumGroups; GroupIdx++)
+		{
+			const int32 NumGroupNodes = (NumNodes - FirstNode) / (NumGroups - GroupIdx);
+			Groups.Emplace(FirstNode, NumGroupNodes);
+			FirstNode += NumGroupNodes;
+		}
+		return Groups;
+	}
+
+	static FString HashKeyText(const FString& KeyText)
+	{
+		FSHAHash Hash;
+		const FTCHARToUTF8 UTF8(*KeyText);
+		FSHA1::HashBuffer(UTF8.Get(), UTF8.Length(), Hash.Hash);
+		return Hash.ToString();
+	}
+}
+
+bool FJrHierarchicalMerge::CanMergeHierarchically(const FSkeletalMeshMergeParams& Params, const FJrSkeletalMeshMergeOptions& Options, int32 NumSources)
+{
+	if (!Options.bHierarchicalMerge || NumSources <= FMath::Max(Options.HierarchicalGroupSize, 3))
+	{
+		return false;
+	}
+
+	// these compare a part with the other parts or with the whole merged mesh
+	if (Options.PartMaskRules.Num() > 0 || Options.PartCullRules.Num() > 0 || Options.MinPartScreenSize > 0.f || Params.MeshSectionMappings.Num() == NumSources)
+	{
+		UE_LOG(LogSkeletalMeshMerge, Log, TEXT("Hierarchical merge: part mask rules, part culling and forced section mappings need a flat merge."));
+		return false;
+	}
+	return true;
+}
+
+bool FJrHierarchicalMerge::MergeSubgroups(const FSkeletalMeshMergeParams& Params, const TArray<USkeletalMesh*>& SourceMeshes, const TArray<USkeletalMesh*>& MeshesToMerge,
+	const FJrSkeletalMeshMergeOptions& Options, USkeleton* Skeleton, FJrHierarchicalMergeResult& OutResult)
+{
+	using namespace JrHierarchicalMerge;
+	check(IsInGameThread());
+	check(SourceMeshes.Num() == MeshesToMerge.Num());
+
+	const int32 GroupSize = FMath::Max(Options.HierarchicalGroupSize, 3);
+
+	// per-mesh steps only, the merged skeleton and LODs are reduced once by the final merge
+	FJrSkeletalMeshMergeOptions LeafOptions = Options;
+	LeafOptions.bPruneUnusedBones = false;
+	LeafOptions.LODBoneReductions.Empty();
+	LeafOptions.bUseMergeCache = false;
+	LeafOptions.bHierarchicalMerge = false;
+	LeafOptions.bMeasurePositionErrors = false;
+
+	// every leaf group synthesizes up to the LOD count of the whole merge, so every intermediate has the same LOD count
+	if (Options.bSynthesizeMissingLODs && Options.MaxLODCount <= 0)
+	{
+		int32 MaxSourceLODCount = 0;
+		for (const USkeletalMesh* Mesh : MeshesToMerge)
+		{
+			MaxSourceLODCount = FMath::Max(MaxSourceLODCount, Mesh->GetLODNum());
+		}
+		LeafOptions.MaxLODCount = FMath::Max(MaxSourceLODCount - Params.StripTopLODS, 1);
+	}
+
+	// the upper levels only combine intermediates, the leaves already stripped, transformed and synthesized the source LODs
+	FJrSkeletalMeshMergeOptions LevelOptions = LeafOptions;
+	LevelOptions.bSynthesizeMissingLODs = false;
+	LevelOptions.BoneNameRemaps.Reset();
+
+	// the first mesh is a copy whose skeleton holds the bones of every skeleton of the merge (bSkeletonBefore), or whose LODs
+	// the engine reduced for the LOD count of the whole merge: its group depends on every source, not only on the group sources
+	const bool bFirstMeshPrepared = (Params.Skeleton && Params.bSkeletonBefore) || (Options.bSynthesizeMissingLODs && Options.bPreferEngineReduction);
+
+	OutResult = FJrHierarchicalMergeResult();
+	OutResult.FinalOptions = Options;
+	OutResult.FinalOptions.bSynthesizeMissingLODs = false;
+	OutResult.FinalOptions.bHierarchicalMerge = false;
+	OutResult.FinalOptions.BoneNameRemaps.Reset();
+
+	TArray<FNode> Nodes;
+	Nodes.SetNum(MeshesToMerge.Num());
+	for (int32 MeshIdx = 0; MeshIdx < MeshesToMerge.Num(); MeshIdx++)
+	{
+		Nodes[MeshIdx].Mesh = MeshesToMerge[MeshIdx];
+		Nodes[MeshIdx].FirstSource = MeshIdx;
+	}
+
+	const TArray<FSkelMeshMergeSectionMapping> NoSectionMappings;
+	bool bLeafLevel = true;
+	while (Nodes.Num() > GroupSize)
+	{
+		const TArray<TPair<int32, int32>> Groups = MakeGroups(Nodes.Num(), GroupSize);
+		TArray<FNode> Parents;
+		Parents.SetNum(Groups.Num());
+		TArray<FGroupMerge> GroupMerges;
+
+		for (int32 GroupIdx = 0; GroupIdx < Groups.Num(); GroupIdx++)
+		{
+			const int32 FirstNode = Groups[GroupIdx].Key;
+			const int32 NumGroupNodes = Groups[GroupIdx].Value;
+			FNode& Parent = Parents[GroupIdx];
+			Parent.FirstSource = Nodes[FirstNode].FirstSource;
+
+			if (Options.bCacheSubgroups)
+			{
+				if (bLeafLevel)
+				{
+					// same key as a merge of the group alone, from the meshes given by the caller
+					FSkeletalMeshMergeParams GroupParams = Params;
+					GroupParams.MeshesToMerge.Reset();
+					GroupParams.MeshSectionMappings.Reset();
+					GroupParams.UVTransformsPerMesh.Reset();
+					for (int32 NodeIdx = FirstNode; NodeIdx < FirstNode + NumGroupNodes; NodeIdx++)
+					{
+						GroupParams.MeshesToMerge.Add(SourceMeshes[NodeIdx]);
+						if (Params.UVTransformsPerMesh.IsValidIndex(NodeIdx))
+						{
+							GroupParams.UVTransformsPerMesh.Add(Params.UVTransformsPerMesh[NodeIdx]);
+						}
+					}
+					Parent.Key = FJrMergedMeshCache::MakeKey(GroupParams, LeafOptions);
+					if (FirstNode == 0 && bFirstMeshPrepared)
+					{
+						Parent.Key = HashKeyText(FString::Printf(TEXT("JRHM0|%s|%s"), *Parent.Key, *FJrMergedMeshCache::MakeKey(Params, LeafOptions)));
+					}
+				}
+				else
+				{
+					FString KeyText = TEXT("JRHM");
+					for (int32 NodeIdx = FirstNode; NodeIdx < FirstNode + NumGroupNodes; NodeIdx++)
+					{
+						KeyText += TEXT("|") + Nodes[NodeIdx].Key;
+					}
+					Parent.Key = HashKeyText(KeyText);
+				}
+
+				if (const FCachedSubgroup* Cached = FindCachedSubgroup(Parent.Key))
+				{
+					Parent.Intermediate = Cached->Mesh;
+					Parent.Mesh = Cached->Mesh.Get();
+					Parent.VertexProvenance = Cached->VertexProvenance;
+					for (FIntPoint& VertexSource : Parent.VertexProvenance)
+					{
+						VertexSource.X += Parent.FirstSource;
+					}
+					OutResult.CacheHits++;
+					continue;
+				}
+			}
+
+			// UObjects are created on the game thread, the workers only fill them (the sockets are added once merged)
+			Parent.Intermediate = TStrongObjectPtr<USkeletalMesh>(NewObject<USkeletalMesh>(GetTransientPackage(), NAME_None, RF_Transient));
+			Parent.Mesh = Parent.Intermediate.Get();
+			Parent.Mesh->SetSkeleton(Skeleton ? Skeleton : Nodes[FirstNode].Mesh->GetSkeleton());
+
+			FGroupMerge& GroupMerge = GroupMerges.AddDefaulted_GetRef();
+			GroupMerge.GroupIdx = GroupIdx;
+			for (int32 NodeIdx = FirstNode; NodeIdx < FirstNode + NumGroupNodes; NodeIdx++)
+			{
+				GroupMerge.Meshes.Add(Nodes[NodeIdx].Mesh);
+				if (bLeafLevel && Params.UVTransformsPerMesh.IsValidIndex(NodeIdx))
+				{
+					GroupMerge.UVTransforms.UVTransformsPerMesh.Add(Params.UVTransformsPerMesh[NodeIdx]);
+				}
+			}
+		}
+
+		const int32 StripTopLODs = bLeafLevel ? Params.StripTopLODS : 0;
+		const FJrSkeletalMeshMergeOptions& GroupOptions = bLeafLevel ? LeafOptions : LevelOptions;
+		ParallelFor(GroupMerges.Num(), [&](int32 MergeIdx)
+		{
+			// the workers read the source meshes
+			FGCScopeGuard GCGuard;
+
+			FGroupMerge& GroupMerge = GroupMerges[MergeIdx];
+			GroupMerge.Merger = MakeUnique<FJrSkeletalMeshMerge>(Parents[GroupMerge.GroupIdx].Mesh, GroupMerge.Meshes, NoSectionMappings, StripTopLODs,
+				EMeshBufferAccess::ForceCPUAndGPU, &GroupMerge.UVTransforms, &GroupOptions);
+			GroupMerge.Merger->SetBuildRenderResources(false);
+			GroupMerge.Merger->SetBuildSockets(false);
+			GroupMerge.bMerged = GroupMerge.Merger->DoMerge();
+			GroupMerge.VertexProvenance = GroupMerge.Merger->GetVertexProvenance();
+		});
+
+		for (const FGroupMerge& GroupMerge : GroupMerges)
+		{
+			if (!GroupMerge.bMerged)
+			{
+				UE_LOG(LogSkeletalMeshMerge, Warning, TEXT("Hierarchical merge: failed to merge the group of %d meshes starting at source %d."),
+					GroupMerge.Meshes.Num(), Parents[GroupMerge.GroupIdx].FirstSource);
+				return false;
+			}
+
+			// duplicating the sockets creates UObjects, so it is done here on the game thread
+			GroupMerge.Merger->BuildMergedSockets();
+
+			// provenance of the intermediate in source meshes, through the provenance of its children
+			FNode& Parent = Parents[GroupMerge.GroupIdx];
+			const int32 FirstNode = Groups[GroupMerge.GroupIdx].Key;
+			Parent.VertexProvenance.Reserve(GroupMerge.VertexProvenance.Num());
+			for (const FIntPoint& VertexSource : GroupMerge.VertexProvenance)
+			{
+				const FNode& Child = Nodes[FirstNode + VertexSource.X];
+				Parent.VertexProvenance.Add(bLeafLevel ? FIntPoint(Child.FirstSource, VertexSource.Y) : Child.VertexProvenance[VertexSource.Y]);
+			}
+
+			if (Options.bCacheSubgroups)
+			{
+				FCachedSubgroup& Cached = AddCachedSubgroup(Parent.Key);
+				Cached.Mesh = Parent.Intermediate;
+				Cached.VertexProvenance = Parent.VertexProvenance;
+				for (FIntPoint& VertexSource : Cached.VertexProvenance)
+				{
+					VertexSource.X -= Parent.FirstSource;
+				}
+			}
+			OutResult.NumMerges++;
+		}
+
+		Nodes = MoveTemp(Parents);
+		bLeafLevel = false;
+	}
+
+	for (FNode& Node : Nodes)
+	{
+		OutResult.Meshes.Add(Node.Intermediate);
+		OutResult.VertexProvenance.Add(MoveTemp(Node.VertexProvenance));
+	}
+
+	UE_LOG(LogSkeletalMeshMerge, Log, TEXT("Hierarchical merge: %d sources merged into %d intermediate meshes (%d built, %d from the subgroup cache)."),
+		MeshesToMerge.Num(), Nodes.Num(), OutResult.NumMerges, OutResult.CacheHits);
+	return true;
+}
+
+void FJrHierarchicalMerge::ClearSubgroupCache()
+{
+	check(IsInGameThread());
+	JrHierarchicalMerge::SubgroupCache.Empty();
+	JrHierarchicalMerge::SubgroupCacheOrder.Empty();
+}
@@ -0,0 +1,286 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "JrMergeBenchmark.h"
+#include "JrSkeletalMergingLibrary.h"
+#include "JrSkeletalMeshMergeFunc.h"
+#include "Engine/SkeletalMesh.h"
+#include "Engine/SkeletalMeshSocket.h"
+#include "GPUSkinVertexFactory.h"
+#include "HAL/PlatformMemory.h"
+#include "Materials/Material.h"
+#include "Materials/MaterialInstanceConstant.h"
+#include "Misc/DateTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Rendering/SkeletalMeshRenderData.h"
+
+#include UE_INLINE_GENERATED_CPP_BY_NAME(JrMergeBenchmark)
+
+FJrMergeBenchmarkReport FJrMergeBenchmark::Run(const FJrMergeBenchmarkSettings& InSettings)
+{
+	FJrMergeBenchmarkReport Report;
+
+	// ClampMin only applies in the editor UI, the commandlet passes -Vertices= as it is (a triangle strip needs 3 vertices)
+	FJrMergeBenchmarkSettings Settings = InSettings;
+	Settings.VerticesPerSection = FMath::Max(Settings.VerticesPerSection, 3);
+
+	TArray<UMaterialInterface*> Materials;
+	for (int32 MaterialIdx = 0; MaterialIdx < FMath::Max(1, Settings.NumMaterials); MaterialIdx++)
+	{
+		UMaterialInstanceConstant* Material = NewObject<UMaterialInstanceConstant>(GetTransientPackage());
+		Material->Parent = UMaterial::GetDefaultMaterial(MD_Surface);
+		Materials.Add(Material);
+	}
+
+	struct FAxis
+	{
+		FName Name;
+		const TArray<int32>& Sizes;
+	};
+	const FAxis Axes[] = {
+		{ TEXT("Parts"), Settings.PartCounts },
+		{ TEXT("Bones"), Settings.BoneCounts },
+		{ TEXT("Sections"), Settings.SectionCounts },
+	};
+
+	for (const FAxis& Axis : Axes)
+	{
+		TArray<double> Sizes;
+		TArray<double> Times;
+		TArray<double> Memory;
+		for (const int32 Size : Axis.Sizes)
+		{
+			const int32 NumParts = Axis.Name == TEXT("Parts") ? Size : Settings.BaselineParts;
+			const int32 NumBones = Axis.Name == TEXT("Bones") ? Size : Settings.BaselineBones;
+			const int32 NumSections = Axis.Name == TEXT("Sections") ? Size : Settings.BaselineSections;
+			if (NumParts < 2 || NumBones < 2 || NumSections < 1)
+			{
+				continue;
+			}
+
+			const FJrMergeBenchmarkSample& Sample = Report.Samples.Add_GetRef(MeasureMerge(Axis.Name, NumParts, NumBones, NumSections, Settings, Materials));
+			UE_LOG(LogSkeletalMeshMerge, Display, TEXT("Merge benchmark: %d parts, %d bones, %d sections per part -> %.2f ms, %lld bytes retained"),
+				NumParts, NumBones, NumSections, Sample.MergeMilliseconds, Sample.RetainedMemoryBytes);
+
+			Sizes.Add(Size);
+			Times.Add(FMath::Max(Sample.MergeMilliseconds, UE_KINDA_SMALL_NUMBER));
+			Memory.Add(FMath::Max<double>(Sample.RetainedMemoryBytes, 1.0));
+		}
+
+		if (Sizes.Num() >= 3)
+		{
+			FJrMergeScalingResult& Scaling = Report.Scaling.AddDefaulted_GetRef();
+			Scaling.Axis = Axis.Name;
+			Scaling.TimeExponent = FitExponent(Sizes, Times);
+			Scaling.MemoryExponent = FitExponent(Sizes, Memory);
+			Scaling.bSuperlinear = Scaling.TimeExponent > Settings.MaxScalingExponent;
+			Report.bPassed &= !Scaling.bSuperlinear;
+
+			UE_LOG(LogSkeletalMeshMerge, Display, TEXT("Merge benchmark: %s scaling exponent %.2f (time), %.2f (memory)%s"),
+				*Axis.Name.ToString(), Scaling.TimeExponent, Scaling.MemoryExponent, Scaling.bSuperlinear ? TEXT(" - SUPERLINEAR") : TEXT(""));
+		}
+	}
+
+	if (Settings.bWriteCSV)
+	{
+		FString CSV = TEXT("Axis,Parts,Bones,SectionsPerPart,InputVertices,MergedSections,MergedBones,MergeMs,SkeletonMs,RetainedMemoryBytes\n");
+		for (const FJrMergeBenchmarkSample& Sample : Report.Samples)
+		{
+			CSV += FString::Printf(TEXT("%s,%d,%d,%d,%d,%d,%d,%.3f,%.3f,%lld\n"), *Sample.Axis.ToString(), Sample.Parts, Sample.Bones, Sample.SectionsPerPart,
+				Sample.InputVertices, Sample.MergedSections, Sample.MergedBones, Sample.MergeMilliseconds, Sample.SkeletonMilliseconds, Sample.RetainedMemoryBytes);
+		}
+
+		const FString FileName = FPaths::ProjectSavedDir() / TEXT("JrMergeBenchmark") / FString::Printf(TEXT("MergeBenchmark_%s.csv"), *FDateTime::Now().ToString());
+		if (FFileHelper::SaveStringToFile(CSV, *FileName))
+		{
+			Report.CSVFile = FPaths::ConvertRelativePathToFull(FileName);
+		}
+	}
+
+	return Report;
+}
+
+USkeletalMesh* FJrMergeBenchmark::CreatePart(int32 PartIdx, int32 NumSharedBones, int32 NumUniqueBones, int32 NumSections, int32 VerticesPerSection, const TArray<UMaterialInterface*>& Materials)
+{
+	USkeletalMesh* Part = NewObject<USkeletalMesh>(GetTransientPackage(), *FString::Printf(TEXT("BenchmarkPart_%d"), PartIdx), RF_Transient);
+
+	// shared spine first, then a chain of bones only this part has
+	{
+		FReferenceSkeletonModifier Modifier(Part->GetRefSkeleton(), nullptr);
+		for (int32 BoneIdx = 0; BoneIdx < NumSharedBones; BoneIdx++)
+		{
+			const FName BoneName(*FString::Printf(TEXT("Shared_%d"), BoneIdx));
+			Modifier.Add(FMeshBoneInfo(BoneName, BoneName.ToString(), BoneIdx - 1), FTransform(FVector(0.f, 0.f, BoneIdx == 0 ? 0.f : 1.f)));
+		}
+		for (int32 BoneIdx = 0; BoneIdx < NumUniqueBones; BoneIdx++)
+		{
+			const FName BoneName(*FString::Printf(TEXT("Part%d_%d"), PartIdx, BoneIdx));
+			const int32 ParentIdx = BoneIdx == 0 ? (PartIdx % NumSharedBones) : NumSharedBones + BoneIdx - 1;
+			Modifier.Add(FMeshBoneInfo(BoneName, BoneName.ToString(), ParentIdx), FTransform(FVector(1.f, 0.f, 0.f)));
+		}
+	}
+	Part->CalculateInvRefMatrices();
+
+	const int32 NumBones = Part->GetRefSkeleton().GetRawBoneNum();
+	// one socket every part has and one of its own
+	for (const FName SocketBone : { Part->GetRefSkeleton().GetBoneName(0), Part->GetRefSkeleton().GetBoneName(NumBones - 1) })
+	{
+		USkeletalMeshSocket* Socket = NewObject<USkeletalMeshSocket>(Part);
+		Socket->BoneName = SocketBone;
+		Socket->SocketName = *FString::Printf(TEXT("%s_Socket"), *SocketBone.ToString());
+		Part->GetMeshOnlySocketList().Add(Socket);
+	}
+
+	for (UMaterialInterface* Material : Materials)
+	{
+		Part->GetMaterials().Add(FSkeletalMaterial(Material, true, false, Material->GetFName()));
+	}
+
+	Part->AllocateResourceForRendering();
+	FSkeletalMeshLODRenderData& LODData = *new FSkeletalMeshLODRenderData;
+	Part->GetResourceForRendering()->LODRenderData.Add(&LODData);
+	Part->AddLODInfo().ScreenSize = 1.f;
+
+	const int32 MaxGPUSkinBones = FGPUBaseSkinVertexFactory::GetMaxGPUSkinBones();
+	TArray<FBoneIndexType> BoneMap;
+	for (int32 BoneIdx = 0; BoneIdx < FMath::Min(NumBones, MaxGPUSkinBones); BoneIdx++)
+	{
+		BoneMap.Add(NumBones - 1 - BoneIdx);
+	}
+
+	const int32 NumVertices = NumSections * VerticesPerSection;
+	LODData.StaticVertexBuffers.PositionVertexBuffer.Init(NumVertices, true);
+	LODData.StaticVertexBuffers.StaticMeshVertexBuffer.Init(NumVertices, 1, true);
+	TArray<FSkinWeightInfo> SkinWeights;
+	SkinWeights.AddZeroed(NumVertices);
+	TArray<uint32> Indices;
+
+	for (int32 SectionIdx = 0; SectionIdx < NumSections; SectionIdx++)
+	{
+		FSkelMeshRenderSection& Section = LODData.RenderSections.AddDefaulted_GetRef();
+		Section.MaterialIndex = (PartIdx + SectionIdx) % Materials.Num();
+		Section.BaseVertexIndex = SectionIdx * VerticesPerSection;
+		Section.NumVertices = VerticesPerSection;
+		Section.BaseIndex = Indices.Num();
+		Section.NumTriangles = VerticesPerSection - 2;
+		Section.MaxBoneInfluences = 1;
+		Section.BoneMap = BoneMap;
+
+		// triangle strip along a zigzag, each vertex skinned to one bone of the section
+		for (int32 VertIdx = 0; VertIdx < VerticesPerSection; VertIdx++)
+		{
+			const uint32 Vertex = Section.BaseVertexIndex + VertIdx;
+			LODData.StaticVertexBuffers.PositionVertexBuffer.VertexPosition(Vertex) = FVector3f((float)(VertIdx / 2), (float)(VertIdx % 2), (float)PartIdx);
+			LODData.StaticVertexBuffers.StaticMeshVertexBuffer.SetVertexTangents(Vertex, FVector3f::ForwardVector, FVector3f::RightVector, FVector3f::UpVector);
+			LODData.StaticVertexBuffers.StaticMeshVertexBuffer.SetVertexUV(Vertex, 0, FVector2f((float)(VertIdx / 2), (float)(VertIdx % 2)));
+			SkinWeights[Vertex].InfluenceBones[0] = VertIdx % BoneMap.Num();
+			SkinWeights[Vertex].InfluenceWeights[0] = MAX_uint16;
+
+			if (VertIdx >= 2)
+			{
+				Indices.Append({ Vertex - 2, Vertex - 1, Vertex });
+			}
+		}
+	}
+
+	LODData.SkinWeightVertexBuffer.SetMaxBoneInfluences(1);
+	LODData.SkinWeightVertexBuffer.SetUse16BitBoneIndex(NumBones > MAX_uint8);
+	LODData.SkinWeightVertexBuffer.SetNeedsCPUAccess(true);
+	LODData.SkinWeightVertexBuffer = SkinWeights;
+	LODData.MultiSizeIndexContainer.RebuildIndexBuffer(sizeof(uint32), Indices);
+
+	for (int32 BoneIdx = 0; BoneIdx < NumBones; BoneIdx++)
+	{
+		LODData.RequiredBones.Add(BoneIdx);
+		LODData.ActiveBoneIndices.Add(BoneIdx);
+	}
+
+	Part->SetImportedBounds(FBoxSphereBounds(FVector::ZeroVector, FVector(VerticesPerSection), VerticesPerSection));
+	return Part;
+}
+
+FJrMergeBenchmarkSample FJrMergeBenchmark::MeasureMerge(FName Axis, int32 NumParts, int32 NumBones, int32 NumSections, const FJrMergeBenchmarkSettings& Settings, const TArray<UMaterialInterface*>& Materials)
+{
+	FJrMergeBenchmarkSample Sample;
+	Sample.Axis = Axis;
+	Sample.Parts = NumParts;
+	Sample.Bones = NumBones;
+	Sample.SectionsPerPart = NumSections;
+
+	// half of the bones are shared by every part, the other half is split between the parts
+	const int32 NumSharedBones = FMath::Max(1, NumBones / 2);
+	const int32 NumUniqueBones = FMath::Max(1, (NumBones - NumSharedBones) / NumParts);
+
+	TArray<USkeletalMesh*> Parts;
+	for (int32 PartIdx = 0; PartIdx < NumParts; PartIdx++)
+	{
+		Parts.Add(CreatePart(PartIdx, NumSharedBones, NumUniqueBones, NumSections, Settings.VerticesPerSection, Materials));
+	}
+	Sample.InputVertices = NumParts * NumSections * Settings.VerticesPerSection;
+
+	const TArray<FSkelMeshMergeSectionMapping> SectionMappings;
+	Sample.MergeMilliseconds = UE_MAX_FLT;
+	for (int32 Repetition = 0; Repetition < FMath::Max(1, Settings.Repetitions); Repetition++)
+	{
+		USkeletalMesh* MergedMesh = NewObject<USkeletalMesh>(GetTransientPackage(), NAME_None, RF_Transient);
+		FJrSkeletalMeshMerge Merger(MergedMesh, Parts, SectionMappings, 0);
+
+		const uint64 UsedMemoryBefore = FPlatformMemory::GetStats().UsedPhysical;
+		const double StartTime = FPlatformTime::Seconds();
+		const bool bMerged = Merger.DoMerge();
+		const float Milliseconds = (float)((FPlatformTime::Seconds() - StartTime) * 1000.0);
+		const uint64 UsedMemoryAfter = FPlatformMemory::GetStats().UsedPhysical;
+
+		if (!bMerged)
+		{
+			UE_LOG(LogSkeletalMeshMerge, Warning, TEXT("Merge benchmark: merge of %d parts failed"), NumParts);
+		}
+		else if (Milliseconds < Sample.MergeMilliseconds)
+		{
+			Sample.MergeMilliseconds = Milliseconds;
+			for (const FJrMergePhaseTiming& Timing : Merger.GetReport().PhaseTimings)
+			{
+				if (Timing.Phase == TEXT("Skeleton"))
+				{
+					Sample.SkeletonMilliseconds = Timing.Milliseconds;
+				}
+			}
+			Sample.MergedSections = Merger.GetReport().LODs.Num() > 0 ? Merger.GetReport().LODs[0].OutputSections : 0;
+			Sample.MergedBones = Merger.GetReport().BonesAfter;
+		}
+		Sample.RetainedMemoryBytes = FMath::Max<int64>(Sample.RetainedMemoryBytes, (int64)UsedMemoryAfter - (int64)UsedMemoryBefore);
+
+		MergedMesh->ReleaseResources();
+		MergedMesh->ReleaseResourcesFence.Wait();
+		MergedMesh->MarkAsGarbage();
+	}
+
+	for (USkeletalMesh* Part : Parts)
+	{
+		Part->MarkAsGarbage();
+	}
+
+	if (Sample.MergeMilliseconds == UE_MAX_FLT)
+	{
+		Sample.MergeMilliseconds = 0.f;
+	}
+	return Sample;
+}
+
+float FJrMergeBenchmark::FitExponent(const TArray<double>& X, const TArray<double>& Y)
+{
+	const int32 NumPoints = FMath::Min(X.Num(), Y.Num());
+	double SumX = 0.0, SumY = 0.0, SumXX = 0.0, SumXY = 0.0;
+	for (int32 PointIdx = 0; PointIdx < NumPoints; PointIdx++)
+	{
+		const double LogX = FMath::Loge(X[PointIdx]);
+		const double LogY = FMath::Loge(Y[PointIdx]);
+		SumX += LogX;
+		SumY += LogY;
+		SumXX += LogX * LogX;
+		SumXY += LogX * LogY;
+	}
+
+	const double Denominator = NumPoints * SumXX - SumX * SumX;
+	return FMath::Abs(Denominator) > UE_SMALL_NUMBER ? (float)((NumPoints * SumXY - SumX * SumY) / Denominator) : 0.f;
+}
@@ -0,0 +1,55 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "JrMergeBenchmarkCommandlet.h"
+#include "JrMergeBenchmark.h"
+#include "JrSkeletalMergingLibrary.h"
+
+#include UE_INLINE_GENERATED_CPP_BY_NAME(JrMergeBenchmarkCommandlet)
+
+UJrMergeBenchmarkCommandlet::UJrMergeBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsEditor = true;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UJrMergeBenchmarkCommandlet::Main(const FString& Params)
+{
+	FJrMergeBenchmarkSettings Settings;
+
+	// "-Parts=2,4,8" replaces the default sizes of an axis
+	auto ParseSizes = [&Params](const TCHAR* Switch, TArray<int32>& OutSizes)
+	{
+		FString Value;
+		if (FParse::Value(*Params, Switch, Value))
+		{
+			TArray<FString> Entries;
+			Value.ParseIntoArray(Entries, TEXT(","));
+			OutSizes.Reset();
+			for (const FString& Entry : Entries)
+			{
+				OutSizes.Add(FCString::Atoi(*Entry));
+			}
+		}
+	};
+	ParseSizes(TEXT("Parts="), Settings.PartCounts);
+	ParseSizes(TEXT("Bones="), Settings.BoneCounts);
+	ParseSizes(TEXT("Sections="), Settings.SectionCounts);
+	FParse::Value(*Params, TEXT("Vertices="), Settings.VerticesPerSection);
+	FParse::Value(*Params, TEXT("Repetitions="), Settings.Repetitions);
+	FParse::Value(*Params, TEXT("MaxExponent="), Settings.MaxScalingExponent);
+
+	const FJrMergeBenchmarkReport Report = FJrMergeBenchmark::Run(Settings);
+	if (!Report.CSVFile.IsEmpty())
+	{
+		UE_LOG(LogSkeletalMeshMerge, Display, TEXT("Merge benchmark: samples written to %s"), *Report.CSVFile);
+	}
+
+	if (!Report.bPassed)
+	{
+		UE_LOG(LogSkeletalMeshMerge, Error, TEXT("Merge benchmark: superlinear scaling detected"));
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,307 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "JrMergePartitioner.h"
+#include "JrSkeletalMergingLibrary.h"
+#include "JrSkeletalMeshMergeTypes.h"
+#include "SkeletalMergingLibrary.h"
+#include "Engine/SkeletalMesh.h"
+#include "Engine/SkinnedAssetCommon.h"
+#include "Rendering/SkeletalMeshRenderData.h"
+
+#include UE_INLINE_GENERATED_CPP_BY_NAME(JrMergePartitioner)
+
+namespace JrMergePartitioner
+{
+	/** What a group of sources adds to a merged mesh. */
+	struct FPartStats
+	{
+		TArray<int32> SourceIndices;
+		int32 NumVertices = 0;
+		TSet<FName> Bones;
+		/** Bones of the merged section of each material. */
+		TMap<const UMaterialInterface*, TSet<FName>> MaterialBones;
+
+		void Append(const FPartStats& Other)
+		{
+			SourceIndices.Append(Other.SourceIndices);
+			NumVertices += Other.NumVertices;
+			Bones.Append(Other.Bones);
+			for (const TPair<const UMaterialInterface*, TSet<FName>>& Pair : Other.MaterialBones)
+			{
+				MaterialBones.FindOrAdd(Pair.Key).Append(Pair.Value);
+			}
+		}
+
+		int32 GetMaxSectionBones() const
+		{
+			int32 MaxSectionBones = 0;
+			for (const TPair<const UMaterialInterface*, TSet<FName>>& Pair : MaterialBones)
+			{
+				MaxSectionBones = FMath::Max(MaxSectionBones, Pair.Value.Num());
+			}
+			return MaxSectionBones;
+		}
+	};
+
+	/** Returns the material of a source section, the way the merge matches sections. */
+	static const UMaterialInterface* GetSectionMaterial(const USkeletalMesh* Mesh, int32 LODIdx, int32 SectionIdx, const FSkelMeshRenderSection& Section)
+	{
+		const TArray<FSkeletalMaterial>& Materials = Mesh->GetMaterials();
+		if (Materials.Num() == 0)
+		{
+			return nullptr;
+		}
+
+		int32 MaterialIndex = Section.MaterialIndex;
+		const FSkeletalMeshLODInfo* LODInfo = Mesh->GetLODInfo(LODIdx);
+		if (LODInfo && LODInfo->LODMaterialMap.IsValidIndex(SectionIdx) && LODInfo->LODMaterialMap[SectionIdx] != INDEX_NONE)
+		{
+			MaterialIndex = LODInfo->LODMaterialMap[SectionIdx];
+		}
+		return Materials[FMath::Clamp(MaterialIndex, 0, Materials.Num() - 1)].MaterialInterface;
+	}
+
+	static void GatherStats(const USkeletalMesh* Mesh, int32 MeshIdx, int32 SourceLODIdx, const FJrSkeletalMeshMergeOptions& Options, FPartStats& OutStats)
+	{
+		OutStats.SourceIndices.Add(MeshIdx);
+
+		const FReferenceSkeleton& RefSkeleton = Mesh->GetRefSkeleton();
+		const FSkeletalMeshRenderData* RenderData = const_cast<USkeletalMesh*>(Mesh)->GetResourceForRendering();
+		if (!RenderData || RenderData->LODRenderData.Num() == 0)
+		{
+			return;
+		}
+
+		// a bone and its ancestors, the merged skeleton keeps the whole chain
+		auto AddBoneChain = [&RefSkeleton](int32 BoneIndex, TSet<FName>& Bones)
+		{
+			for (; BoneIndex != INDEX_NONE; BoneIndex = RefSkeleton.GetRawParentIndex(BoneIndex))
+			{
+				bool bAlreadyInSet = false;
+				Bones.Add(RefSkeleton.GetBoneName(BoneIndex), &bAlreadyInSet);
+				if (bAlreadyInSet)
+				{
+					break;
+				}
+			}
+		};
+
+		if (!Options.bPruneUnusedBones)
+		{
+			for (int32 BoneIndex = 0; BoneIndex < RefSkeleton.GetRawBoneNum(); BoneIndex++)
+			{
+				OutStats.Bones.Add(RefSkeleton.GetBoneName(BoneIndex));
+			}
+		}
+		else
+		{
+			// pruning keeps the bones skinned by any LOD
+			for (const FSkeletalMeshLODRenderData& LODData : RenderData->LODRenderData)
+			{
+				for (const FSkelMeshRenderSection& Section : LODData.RenderSections)
+				{
+					for (const FBoneIndexType BoneIndex : Section.BoneMap)
+					{
+						AddBoneChain(BoneIndex, OutStats.Bones);
+					}
+				}
+			}
+			for (const FName& BoneName : Options.BonesToKeep)
+			{
+				const int32 BoneIndex = RefSkeleton.FindRawBoneIndex(BoneName);
+				if (BoneIndex != INDEX_NONE)
+				{
+					AddBoneChain(BoneIndex, OutStats.Bones);
+				}
+			}
+		}
+
+		const int32 LODIdx = FMath::Min(SourceLODIdx, RenderData->LODRenderData.Num() - 1);
+		const FSkeletalMeshLODRenderData& LODData = RenderData->LODRenderData[LODIdx];
+		OutStats.NumVertices = LODData.GetNumVertices();
+		for (int32 SectionIdx = 0; SectionIdx < LODData.RenderSections.Num(); SectionIdx++)
+		{
+			const FSkelMeshRenderSection& Section = LODData.RenderSections[SectionIdx];
+			TSet<FName>& SectionBones = OutStats.MaterialBones.FindOrAdd(GetSectionMaterial(Mesh, LODIdx, SectionIdx, Section));
+			for (const FBoneIndexType BoneIndex : Section.BoneMap)
+			{
+				SectionBones.Add(RefSkeleton.GetBoneName(BoneIndex));
+			}
+		}
+	}
+
+	static int32 GetMaxVertices(const FJrMergeBudget& Budget)
+	{
+		int32 MaxVertices = Budget.MaxVertices > 0 ? Budget.MaxVertices : MAX_int32;
+		if (Budget.bFitIn16BitIndices)
+		{
+			// skeletal sections use absolute indices, the whole LOD must be indexable with 16 bits
+			MaxVertices = FMath::Min<int32>(MaxVertices, MAX_uint16 + 1);
+		}
+		return MaxVertices;
+	}
+
+	/** Returns whether 'Part' can be added to the merged mesh 'Bin' within 'Budget'. */
+	static bool Fits(const FPartStats& Bin, const FPartStats& Part, const FJrMergeBudget& Budget)
+	{
+		if ((int64)Bin.NumVertices + Part.NumVertices > GetMaxVertices(Budget))
+		{
+			return false;
+		}
+
+		if (Budget.MaxBones > 0)
+		{
+			int32 NumBones = Bin.Bones.Num();
+			for (const FName& BoneName : Part.Bones)
+			{
+				NumBones += Bin.Bones.Contains(BoneName) ? 0 : 1;
+			}
+			if (NumBones > Budget.MaxBones)
+			{
+				return false;
+			}
+		}
+
+		if (Budget.MaxSectionBones > 0)
+		{
+			for (const TPair<const UMaterialInterface*, TSet<FName>>& Pair : Part.MaterialBones)
+			{
+				int32 NumSectionBones = Pair.Value.Num();
+				if (const TSet<FName>* BinSectionBones = Bin.MaterialBones.Find(Pair.Key))
+				{
+					NumSectionBones = BinSectionBones->Num();
+					for (const FName& BoneName : Pair.Value)
+					{
+						NumSectionBones += BinSectionBones->Contains(BoneName) ? 0 : 1;
+					}
+				}
+				if (NumSectionBones > Budget.MaxSectionBones)
+				{
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	static int32 FindRoot(TArray<int32>& Parents, int32 Index)
+	{
+		while (Parents[Index] != Index)
+		{
+			Parents[Index] = Parents[Parents[Index]];
+			Index = Parents[Index];
+		}
+		return Index;
+	}
+}
+
+FJrMergePartitionResult FJrMergePartitioner::Partition(const FSkeletalMeshMergeParams& Params, const FJrSkeletalMeshMergeOptions& Options, const FJrMergeBudget& Budget)
+{
+	using namespace JrMergePartitioner;
+
+	FJrMergePartitionResult Result;
+	Result.SourcePartitions.Init(INDEX_NONE, Params.MeshesToMerge.Num());
+
+	// one entry per valid source
+	TArray<FPartStats> Sources;
+	for (int32 MeshIdx = 0; MeshIdx < Params.MeshesToMerge.Num(); MeshIdx++)
+	{
+		if (const USkeletalMesh* Mesh = Params.MeshesToMerge[MeshIdx])
+		{
+			GatherStats(Mesh, MeshIdx, Params.StripTopLODS, Options, Sources.AddDefaulted_GetRef());
+		}
+	}
+
+	// sources sharing a material, directly or through other sources, are one cluster
+	TArray<int32> Parents;
+	Parents.SetNumUninitialized(Sources.Num());
+	TMap<const UMaterialInterface*, int32> MaterialSources;
+	for (int32 SourceIdx = 0; SourceIdx < Sources.Num(); SourceIdx++)
+	{
+		Parents[SourceIdx] = SourceIdx;
+		for (const TPair<const UMaterialInterface*, TSet<FName>>& Pair : Sources[SourceIdx].MaterialBones)
+		{
+			if (const int32* OtherSourceIdx = MaterialSources.Find(Pair.Key))
+			{
+				Parents[FindRoot(Parents, SourceIdx)] = FindRoot(Parents, *OtherSourceIdx);
+			}
+			else
+			{
+				MaterialSources.Add(Pair.Key, SourceIdx);
+			}
+		}
+	}
+
+	TMap<int32, FPartStats> Clusters;
+	for (int32 SourceIdx = 0; SourceIdx < Sources.Num(); SourceIdx++)
+	{
+		Clusters.FindOrAdd(FindRoot(Parents, SourceIdx)).Append(Sources[SourceIdx]);
+	}
+
+	// items to pack: whole clusters, or the sources of a cluster over the budget on its own
+	const FPartStats EmptyBin;
+	TArray<const FPartStats*> Items;
+	for (const TPair<int32, FPartStats>& Cluster : Clusters)
+	{
+		if (Fits(EmptyBin, Cluster.Value, Budget))
+		{
+			Items.Add(&Cluster.Value);
+			continue;
+		}
+
+		UE_LOG(LogSkeletalMeshMerge, Warning, TEXT("Merge partition: the %d sources sharing materials with %s are over the budget together and are split."),
+			Cluster.Value.SourceIndices.Num(), *Params.MeshesToMerge[Cluster.Value.SourceIndices[0]]->GetName());
+		for (const int32 MeshIdx : Cluster.Value.SourceIndices)
+		{
+			Items.Add(Sources.FindByPredicate([MeshIdx](const FPartStats& Source) { return Source.SourceIndices[0] == MeshIdx; }));
+		}
+	}
+
+	// first fit decreasing, source order between equal items
+	Items.StableSort([](const FPartStats& A, const FPartStats& B)
+	{
+		return A.NumVertices != B.NumVertices ? A.NumVertices > B.NumVertices : A.SourceIndices[0] < B.SourceIndices[0];
+	});
+
+	TArray<FPartStats> Bins;
+	TArray<bool> BinsWithinBudget;
+	for (const FPartStats* Item : Items)
+	{
+		FPartStats* Bin = Bins.FindByPredicate([Item, &Budget](const FPartStats& Other) { return Fits(Other, *Item, Budget); });
+		if (!Bin)
+		{
+			BinsWithinBudget.Add(Fits(EmptyBin, *Item, Budget));
+			Bin = &Bins.AddDefaulted_GetRef();
+		}
+		Bin->Append(*Item);
+	}
+
+	TArray<int32> BinOrder;
+	for (int32 BinIdx = 0; BinIdx < Bins.Num(); BinIdx++)
+	{
+		Bins[BinIdx].SourceIndices.Sort();
+		BinOrder.Add(BinIdx);
+	}
+	BinOrder.Sort([&Bins](int32 A, int32 B) { return Bins[A].SourceIndices[0] < Bins[B].SourceIndices[0]; });
+
+	for (const int32 BinIdx : BinOrder)
+	{
+		const FPartStats& Bin = Bins[BinIdx];
+		FJrMergePartition& Partition = Result.Partitions.AddDefaulted_GetRef();
+		Partition.SourceIndices = Bin.SourceIndices;
+		Partition.NumVertices = Bin.NumVertices;
+		Partition.NumBones = Bin.Bones.Num();
+		Partition.MaxSectionBones = Bin.GetMaxSectionBones();
+		Partition.bWithinBudget = BinsWithinBudget[BinIdx];
+		Result.bWithinBudget &= Partition.bWithinBudget;
+
+		for (const int32 MeshIdx : Bin.SourceIndices)
+		{
+			Result.SourcePartitions[MeshIdx] = Result.Partitions.Num() - 1;
+		}
+	}
+
+	UE_LOG(LogSkeletalMeshMerge, Log, TEXT("Merge partition: %d sources in %d clusters split into %d merged meshes%s."),
+		Sources.Num(), Clusters.Num(), Result.Partitions.Num(), Result.bWithinBudget ? TEXT("") : TEXT(", some sources are over the budget alone"));
+	return Result;
+}
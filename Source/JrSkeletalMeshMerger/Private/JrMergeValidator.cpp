@@ -0,0 +1,188 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "JrMergeValidator.h"
+#include "JrSkeletalMergingLibrary.h"
+#include "JrSkeletalMeshMergeTypes.h"
+#include "Animation/AnimSequence.h"
+#include "Animation/Skeleton.h"
+#include "Engine/SkeletalMesh.h"
+#include "Rendering/SkeletalMeshRenderData.h"
+
+#include UE_INLINE_GENERATED_CPP_BY_NAME(JrMergeValidator)
+
+FJrMergeValidationReport FJrMergeValidator::Validate(USkeletalMesh* MergedMesh, const TArray<FTransform>& PartTransforms, const TArray<UAnimSequence*>& Animations, int32 NumFramesPerAnimation)
+{
+	FJrMergeValidationReport Report;
+
+	UJrMergeProvenanceUserData* Provenance = MergedMesh ? MergedMesh->GetAssetUserData<UJrMergeProvenanceUserData>() : nullptr;
+	if (!Provenance)
+	{
+		UE_LOG(LogSkeletalMeshMerge, Warning, TEXT("Merge validation: %s has no provenance data, merge it with bRecordVertexProvenance"), MergedMesh ? *MergedMesh->GetName() : TEXT("None"));
+		return Report;
+	}
+
+	const FSkeletalMeshLODRenderData& MergedLODData = MergedMesh->GetResourceForRendering()->LODRenderData[0];
+	const int32 NumMergedVertices = MergedLODData.GetNumVertices();
+	if (Provenance->VertexPartIndices.Num() != NumMergedVertices || Provenance->VertexSourceIndices.Num() != NumMergedVertices)
+	{
+		UE_LOG(LogSkeletalMeshMerge, Warning, TEXT("Merge validation: provenance data of %s doesn't match its LOD 0"), *MergedMesh->GetName());
+		return Report;
+	}
+
+	TArray<USkeletalMesh*> Parts;
+	TArray<const FSkeletalMeshLODRenderData*> PartLODData;
+	for (const TSoftObjectPtr<USkeletalMesh>& SourceMesh : Provenance->SourceMeshes)
+	{
+		USkeletalMesh* Part = SourceMesh.LoadSynchronous();
+		if (!Part)
+		{
+			UE_LOG(LogSkeletalMeshMerge, Warning, TEXT("Merge validation: part %s of %s can't be loaded"), *SourceMesh.ToString(), *MergedMesh->GetName());
+			return Report;
+		}
+
+		const FSkeletalMeshRenderData* PartResource = Part->GetResourceForRendering();
+		Parts.Add(Part);
+		PartLODData.Add(&PartResource->LODRenderData[FMath::Min(Provenance->SourceLODIndex, PartResource->LODRenderData.Num() - 1)]);
+
+		FJrPartValidationResult& PartResult = Report.Parts.AddDefaulted_GetRef();
+		PartResult.Part = Part;
+	}
+
+	// the reference pose, then evenly spaced frames of each animation
+	TArray<TPair<const UAnimSequence*, double>> Frames;
+	Frames.Emplace(nullptr, 0.0);
+	for (const UAnimSequence* Animation : Animations)
+	{
+		if (Animation)
+		{
+			const int32 NumFrames = FMath::Max(NumFramesPerAnimation, 1);
+			for (int32 FrameIdx = 0; FrameIdx < NumFrames; FrameIdx++)
+			{
+				Frames.Emplace(Animation, NumFrames > 1 ? Animation->GetPlayLength() * FrameIdx / (NumFrames - 1) : 0.0);
+			}
+		}
+	}
+
+	TArray<double> ErrorSums;
+	ErrorSums.SetNumZeroed(Parts.Num());
+	for (int32 VertIdx = 0; VertIdx < NumMergedVertices; VertIdx++)
+	{
+		const int32 PartIdx = Provenance->VertexPartIndices[VertIdx];
+		if (Report.Parts.IsValidIndex(PartIdx))
+		{
+			Report.Parts[PartIdx].NumVertices++;
+		}
+	}
+
+	TArray<FMatrix44f> MergedMatrices;
+	TArray<TArray<FMatrix44f>> PartMatrices;
+	PartMatrices.SetNum(Parts.Num());
+	for (const TPair<const UAnimSequence*, double>& Frame : Frames)
+	{
+		ComputeSkinningMatrices(MergedMesh, Frame.Key, Frame.Value, MergedMatrices);
+		for (int32 PartIdx = 0; PartIdx < Parts.Num(); PartIdx++)
+		{
+			ComputeSkinningMatrices(Parts[PartIdx], Frame.Key, Frame.Value, PartMatrices[PartIdx]);
+		}
+
+		for (int32 VertIdx = 0; VertIdx < NumMergedVertices; VertIdx++)
+		{
+			const int32 PartIdx = Provenance->VertexPartIndices[VertIdx];
+			if (!Parts.IsValidIndex(PartIdx))
+			{
+				continue;
+			}
+
+			const FVector3f PartPosition = SkinVertex(*PartLODData[PartIdx], Provenance->VertexSourceIndices[VertIdx], PartMatrices[PartIdx]);
+			const FVector3f Expected = PartTransforms.IsValidIndex(PartIdx) ? FVector3f(PartTransforms[PartIdx].TransformPosition(FVector(PartPosition))) : PartPosition;
+			const float Error = FVector3f::Distance(Expected, SkinVertex(MergedLODData, VertIdx, MergedMatrices));
+
+			FJrPartValidationResult& PartResult = Report.Parts[PartIdx];
+			PartResult.MaxError = FMath::Max(PartResult.MaxError, Error);
+			ErrorSums[PartIdx] += Error;
+		}
+	}
+
+	Report.bValid = true;
+	Report.NumFrames = Frames.Num();
+	for (int32 PartIdx = 0; PartIdx < Report.Parts.Num(); PartIdx++)
+	{
+		FJrPartValidationResult& PartResult = Report.Parts[PartIdx];
+		PartResult.MeanError = PartResult.NumVertices > 0 ? (float)(ErrorSums[PartIdx] / ((double)PartResult.NumVertices * Frames.Num())) : 0.f;
+		Report.MaxError = FMath::Max(Report.MaxError, PartResult.MaxError);
+
+		UE_LOG(LogSkeletalMeshMerge, Log, TEXT("Merge validation: %s, %d vertices, max error %.4f, mean error %.4f"),
+			*PartResult.Part->GetName(), PartResult.NumVertices, PartResult.MaxError, PartResult.MeanError);
+	}
+
+	return Report;
+}
+
+void FJrMergeValidator::ComputeSkinningMatrices(const USkeletalMesh* Mesh, const UAnimSequence* Animation, double Time, TArray<FMatrix44f>& OutMatrices)
+{
+	const FReferenceSkeleton& RefSkeleton = Mesh->GetRefSkeleton();
+	const int32 NumBones = RefSkeleton.GetRawBoneNum();
+	const USkeleton* AnimSkeleton = Animation ? Animation->GetSkeleton() : nullptr;
+
+	TArray<FTransform> RefComponentSpace;
+	TArray<FTransform> PoseComponentSpace;
+	RefComponentSpace.SetNum(NumBones);
+	PoseComponentSpace.SetNum(NumBones);
+	OutMatrices.SetNum(NumBones);
+
+	for (int32 BoneIndex = 0; BoneIndex < NumBones; BoneIndex++)
+	{
+		const FTransform& RefLocal = RefSkeleton.GetRawRefBonePose()[BoneIndex];
+		FTransform PoseLocal = RefLocal;
+
+		// bones are matched by name, like the leader pose of the original actor
+		if (AnimSkeleton)
+		{
+			const int32 SkeletonBoneIndex = AnimSkeleton->GetReferenceSkeleton().FindBoneIndex(RefSkeleton.GetBoneName(BoneIndex));
+			if (SkeletonBoneIndex != INDEX_NONE)
+			{
+				Animation->GetBoneTransform(PoseLocal, FSkeletonPoseBoneIndex(SkeletonBoneIndex), Time, false);
+			}
+		}
+
+		const int32 ParentIndex = RefSkeleton.GetRawParentIndex(BoneIndex);
+		RefComponentSpace[BoneIndex] = ParentIndex == INDEX_NONE ? RefLocal : RefLocal * RefComponentSpace[ParentIndex];
+		PoseComponentSpace[BoneIndex] = ParentIndex == INDEX_NONE ? PoseLocal : PoseLocal * PoseComponentSpace[ParentIndex];
+
+		OutMatrices[BoneIndex] = FMatrix44f(RefComponentSpace[BoneIndex].ToMatrixWithScale().Inverse() * PoseComponentSpace[BoneIndex].ToMatrixWithScale());
+	}
+}
+
+FVector3f FJrMergeValidator::SkinVertex(const FSkeletalMeshLODRenderData& LODData, int32 VertIdx, const TArray<FMatrix44f>& SkinningMatrices)
+{
+	int32 SectionIdx = INDEX_NONE;
+	int32 SectionVertIdx = INDEX_NONE;
+	LODData.GetSectionFromVertexIndex(VertIdx, SectionIdx, SectionVertIdx);
+
+	const FVector3f& Position = LODData.StaticVertexBuffers.PositionVertexBuffer.VertexPosition(VertIdx);
+	if (!LODData.RenderSections.IsValidIndex(SectionIdx))
+	{
+		return Position;
+	}
+
+	const TArray<FBoneIndexType>& BoneMap = LODData.RenderSections[SectionIdx].BoneMap;
+	const FSkinWeightInfo Weights = LODData.GetSkinWeightVertexBuffer()->GetVertexSkinWeights(VertIdx);
+
+	FVector3f SkinnedPosition = FVector3f::ZeroVector;
+	float TotalWeight = 0.f;
+	for (int32 Influence = 0; Influence < MAX_TOTAL_INFLUENCES; Influence++)
+	{
+		const float Weight = Weights.InfluenceWeights[Influence];
+		if (Weight > 0.f && BoneMap.IsValidIndex(Weights.InfluenceBones[Influence]))
+		{
+			const FBoneIndexType BoneIndex = BoneMap[Weights.InfluenceBones[Influence]];
+			if (SkinningMatrices.IsValidIndex(BoneIndex))
+			{
+				SkinnedPosition += FVector3f(SkinningMatrices[BoneIndex].TransformPosition(Position)) * Weight;
+				TotalWeight += Weight;
+			}
+		}
+	}
+
+	return TotalWeight > 0.f ? SkinnedPosition / TotalWeight : Position;
+}
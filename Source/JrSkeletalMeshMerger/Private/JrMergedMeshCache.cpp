@@ -0,0 +1,690 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "JrMergedMeshCache.h"
+#include "JrSkeletalMergingLibrary.h"
+#include "JrSkeletalMeshMergeTypes.h"
+#include "SkeletalMergingLibrary.h"
+#include "Async/MappedFileHandle.h"
+#include "Engine/SkeletalMesh.h"
+#include "Engine/SkeletalMeshSocket.h"
+#include "Engine/SkinnedAssetCommon.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFileManager.h"
+#include "Hash/CityHash.h"
+#include "Materials/MaterialInterface.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/SecureHash.h"
+#include "Rendering/SkeletalMeshModel.h"
+#include "Rendering/SkeletalMeshRenderData.h"
+
+namespace JrMergedMeshCache
+{
+	/** 'JRMC' */
+	static constexpr uint32 Magic = 0x434D524A;
+	/** Bump when the layout below or the engine buffer layouts change. */
+	static constexpr uint32 Version = 2;
+	static constexpr uint64 Alignment = 16;
+
+	enum ELODFlags : uint32
+	{
+		FullPrecisionUVs		= 1 << 0,
+		HighPrecisionTangents	= 1 << 1,
+		Use16BitBoneIndex		= 1 << 2,
+		VariableBonesPerVertex	= 1 << 3,
+		Use16BitBoneWeight		= 1 << 4,
+	};
+
+	struct FBlock
+	{
+		uint64 Offset = 0;
+		uint64 Size = 0;
+	};
+
+	struct FFileHeader
+	{
+		uint32 Magic = 0;
+		uint32 Version = 0;
+		/** Layout check, the blocks are raw engine structures. */
+		uint32 BoneIndexSize = 0;
+		uint32 NumLODs = 0;
+		uint32 NumBones = 0;
+		uint32 NumMaterials = 0;
+		uint32 NumSockets = 0;
+		uint32 bHasVertexColors = 0;
+		float BoundsOrigin[3] = {};
+		float BoundsExtent[3] = {};
+		float BoundsRadius = 0.f;
+		FBlock Strings;
+		FBlock Bones;
+		FBlock Materials;
+		FBlock Sockets;
+		FBlock LODs;
+		/** UJrMergeProvenanceUserData of the merged mesh, if it has one. */
+		uint32 bHasProvenance = 0;
+		int32 ProvenanceSourceLOD = 0;
+		/** String offset of each source mesh path. */
+		FBlock ProvenanceSources;
+		FBlock ProvenancePartIndices;
+		FBlock ProvenanceSourceIndices;
+		uint64 FileSize = 0;
+	};
+
+	struct FBoneRecord
+	{
+		uint32 NameOffset = 0;
+		int32 ParentIndex = INDEX_NONE;
+		float Rotation[4] = {};
+		float Translation[3] = {};
+		float Scale[3] = {};
+	};
+
+	struct FMaterialRecord
+	{
+		uint32 PathOffset = 0;
+		uint32 SlotNameOffset = 0;
+	};
+
+	struct FSocketRecord
+	{
+		uint32 NameOffset = 0;
+		uint32 BoneNameOffset = 0;
+		float Location[3] = {};
+		float Rotation[3] = {};
+		float Scale[3] = {};
+	};
+
+	struct FSectionRecord
+	{
+		int32 MaterialIndex = 0;
+		uint32 BaseIndex = 0;
+		uint32 NumTriangles = 0;
+		uint32 BaseVertexIndex = 0;
+		uint32 NumVertices = 0;
+		uint32 MaxBoneInfluences = 0;
+		/** Range of the section bone map in the LOD BoneMaps block. */
+		uint32 BoneMapStart = 0;
+		uint32 BoneMapNum = 0;
+	};
+
+	struct FLODRecord
+	{
+		float ScreenSize = 0.f;
+		float LODHysteresis = 0.f;
+		uint32 NumVertices = 0;
+		uint32 NumTexCoords = 0;
+		uint32 IndexStride = 0;
+		uint32 MaxBoneInfluences = 0;
+		uint32 NumBoneWeights = 0;
+		uint32 Flags = 0;
+		uint32 NumSections = 0;
+		FBlock Positions;
+		FBlock Tangents;
+		FBlock TexCoords;
+		FBlock Colors;
+		/** Raw FSkinWeightDataVertexBuffer data, the bone indices and weights of each vertex. */
+		FBlock SkinWeights;
+		/** Weight offset and influence count (uint32 pair) per vertex, the FSkinWeightLookupVertexBuffer content. */
+		FBlock SkinWeightLookup;
+		FBlock Indices;
+		FBlock Sections;
+		FBlock BoneMaps;
+		FBlock ActiveBones;
+		FBlock RequiredBones;
+	};
+
+	/**
+	* Builds the file in memory, every block aligned on 'Alignment'.
+	* Identical blocks are stored once on disk (e.g. merged LODs that copied the vertex buffers of the previous LOD),
+	* the loader still copies them into each LOD buffers.
+	*/
+	struct FWriter
+	{
+		TArray<uint8> Data;
+		TArray<uint8> StringPool;
+		TMultiMap<uint64, FBlock> BlocksByHash;
+
+		FBlock Write(const void* Src, uint64 Size)
+		{
+			const uint64 Hash = CityHash64(static_cast<const char*>(Src), Size);
+			for (auto It = BlocksByHash.CreateConstKeyIterator(Hash); It; ++It)
+			{
+				const FBlock& Written = It.Value();
+				if (Written.Size == Size && FMemory::Memcmp(Data.GetData() + Written.Offset, Src, Size) == 0)
+				{
+					return Written;
+				}
+			}
+
+			Data.SetNumZeroed(Align(Data.Num(), Alignment));
+			FBlock Block;
+			Block.Offset = Data.Num();
+			Block.Size = Size;
+			Data.Append(static_cast<const uint8*>(Src), Size);
+			BlocksByHash.Add(Hash, Block);
+			return Block;
+		}
+
+		template<typename T>
+		FBlock Write(const TArray<T>& Array)
+		{
+			return Write(Array.GetData(), Array.Num() * sizeof(T));
+		}
+
+		/** Adds a null terminated UTF-8 string to the pool, returns its offset in the pool. */
+		uint32 AddString(const FString& String)
+		{
+			const uint32 Offset = StringPool.Num();
+			const FTCHARToUTF8 UTF8(*String);
+			StringPool.Append(reinterpret_cast<const uint8*>(UTF8.Get()), UTF8.Length());
+			StringPool.Add(0);
+			return Offset;
+		}
+	};
+
+	/** Read access to the mapped file, every block is bounds checked once. */
+	struct FReader
+	{
+		const uint8* Data = nullptr;
+		uint64 Size = 0;
+		FBlock StringBlock;
+
+		bool IsValid(const FBlock& Block, uint64 ElementSize = 1) const
+		{
+			return Block.Offset <= Size && Block.Size <= Size - Block.Offset && Block.Size % ElementSize == 0;
+		}
+
+		template<typename T>
+		TArrayView<const T> View(const FBlock& Block) const
+		{
+			return TArrayView<const T>(reinterpret_cast<const T*>(Data + Block.Offset), (int32)(Block.Size / sizeof(T)));
+		}
+
+		FString GetString(uint32 Offset) const
+		{
+			if (Offset >= StringBlock.Size)
+			{
+				return FString();
+			}
+			const ANSICHAR* String = reinterpret_cast<const ANSICHAR*>(Data + StringBlock.Offset + Offset);
+			return FString(FUTF8ToTCHAR(String, (int32)FCStringAnsi::Strnlen(String, StringBlock.Size - Offset)));
+		}
+	};
+
+	/**
+	* Checks what the GPU would read out of range from a LOD whose blocks are in the file: the section vertex, index and bone map
+	* ranges, the material indices, and every index against the LOD vertex count.
+	*/
+	static bool AreLODRangesValid(const FReader& Reader, const FLODRecord& LOD, uint32 NumMaterials, uint32 NumBones)
+	{
+		const uint64 NumIndices = LOD.Indices.Size / LOD.IndexStride;
+		const TArrayView<const FBoneIndexType> BoneMaps = Reader.View<FBoneIndexType>(LOD.BoneMaps);
+		for (const FSectionRecord& Record : Reader.View<FSectionRecord>(LOD.Sections))
+		{
+			if (Record.MaterialIndex < 0 || (uint32)Record.MaterialIndex >= NumMaterials
+				|| (uint64)Record.BaseVertexIndex + Record.NumVertices > LOD.NumVertices
+				|| (uint64)Record.BaseIndex + (uint64)Record.NumTriangles * 3 > NumIndices
+				|| (uint64)Record.BoneMapStart + Record.BoneMapNum > (uint64)BoneMaps.Num())
+			{
+				return false;
+			}
+		}
+
+		for (const FBoneIndexType BoneIndex : BoneMaps)
+		{
+			if (BoneIndex >= NumBones)
+			{
+				return false;
+			}
+		}
+
+		auto AreIndicesValid = [&LOD, &Reader](auto IndexType)
+		{
+			for (const auto Index : Reader.View<decltype(IndexType)>(LOD.Indices))
+			{
+				if ((uint32)Index >= LOD.NumVertices)
+				{
+					return false;
+				}
+			}
+			return true;
+		};
+		return LOD.IndexStride == sizeof(uint16) ? AreIndicesValid(uint16()) : AreIndicesValid(uint32());
+	}
+}
+
+FString FJrMergedMeshCache::MakeKey(const FSkeletalMeshMergeParams& Params, const FJrSkeletalMeshMergeOptions& Options)
+{
+	FString KeyText = FString::Printf(TEXT("JRMC%u|"), JrMergedMeshCache::Version);
+	FSkeletalMeshMergeParams::StaticStruct()->ExportText(KeyText, &Params, nullptr, nullptr, PPF_None, nullptr);
+	KeyText += TEXT("|");
+	FJrSkeletalMeshMergeOptions::StaticStruct()->ExportText(KeyText, &Options, nullptr, nullptr, PPF_None, nullptr);
+
+	// the params only reference the meshes, a reimport changes their model id
+	for (const USkeletalMesh* Mesh : Params.MeshesToMerge)
+	{
+		if (Mesh)
+		{
+			KeyText += TEXT("|") + Mesh->GetPathName();
+#if WITH_EDITORONLY_DATA
+			if (const FSkeletalMeshModel* ImportedModel = const_cast<USkeletalMesh*>(Mesh)->GetImportedModel())
+			{
+				KeyText += TEXT("@") + ImportedModel->GetIdString();
+			}
+#endif
+		}
+	}
+
+	FSHAHash Hash;
+	const FTCHARToUTF8 UTF8(*KeyText);
+	FSHA1::HashBuffer(UTF8.Get(), UTF8.Length(), Hash.Hash);
+	return Hash.ToString();
+}
+
+FString FJrMergedMeshCache::GetCacheFilename(const FString& Key)
+{
+	return FPaths::ProjectSavedDir() / TEXT("JrMergeCache") / Key + TEXT(".jrmc");
+}
+
+bool FJrMergedMeshCache::Save(USkeletalMesh* MergedMesh, const FString& Filename)
+{
+	using namespace JrMergedMeshCache;
+
+	FSkeletalMeshRenderData* RenderData = MergedMesh ? MergedMesh->GetResourceForRendering() : nullptr;
+	if (!RenderData || RenderData->LODRenderData.Num() == 0)
+	{
+		return false;
+	}
+
+	FWriter Writer;
+	FFileHeader Header;
+	Header.Magic = Magic;
+	Header.Version = Version;
+	Header.BoneIndexSize = sizeof(FBoneIndexType);
+	Header.bHasVertexColors = MergedMesh->GetHasVertexColors();
+
+	const FBoxSphereBounds Bounds = MergedMesh->GetImportedBounds();
+	for (int32 Axis = 0; Axis < 3; Axis++)
+	{
+		Header.BoundsOrigin[Axis] = (float)Bounds.Origin[Axis];
+		Header.BoundsExtent[Axis] = (float)Bounds.BoxExtent[Axis];
+	}
+	Header.BoundsRadius = (float)Bounds.SphereRadius;
+
+	// reserve the header, it is written last once the blocks are known
+	Writer.Data.SetNumZeroed(sizeof(FFileHeader));
+
+	const FReferenceSkeleton& RefSkeleton = MergedMesh->GetRefSkeleton();
+	TArray<FBoneRecord> Bones;
+	for (int32 BoneIdx = 0; BoneIdx < RefSkeleton.GetRawBoneNum(); BoneIdx++)
+	{
+		const FTransform& Pose = RefSkeleton.GetRawRefBonePose()[BoneIdx];
+		FBoneRecord& Bone = Bones.AddDefaulted_GetRef();
+		Bone.NameOffset = Writer.AddString(RefSkeleton.GetBoneName(BoneIdx).ToString());
+		Bone.ParentIndex = RefSkeleton.GetRawParentIndex(BoneIdx);
+		for (int32 Axis = 0; Axis < 3; Axis++)
+		{
+			Bone.Translation[Axis] = (float)Pose.GetTranslation()[Axis];
+			Bone.Scale[Axis] = (float)Pose.GetScale3D()[Axis];
+		}
+		const FQuat Rotation = Pose.GetRotation();
+		Bone.Rotation[0] = (float)Rotation.X;
+		Bone.Rotation[1] = (float)Rotation.Y;
+		Bone.Rotation[2] = (float)Rotation.Z;
+		Bone.Rotation[3] = (float)Rotation.W;
+	}
+	Header.NumBones = Bones.Num();
+	Header.Bones = Writer.Write(Bones);
+
+	TArray<FMaterialRecord> Materials;
+	for (const FSkeletalMaterial& Material : MergedMesh->GetMaterials())
+	{
+		FMaterialRecord& Record = Materials.AddDefaulted_GetRef();
+		Record.PathOffset = Writer.AddString(Material.MaterialInterface ? Material.MaterialInterface->GetPathName() : FString());
+		Record.SlotNameOffset = Writer.AddString(Material.MaterialSlotName.ToString());
+	}
+	Header.NumMaterials = Materials.Num();
+	Header.Materials = Writer.Write(Materials);
+
+	TArray<FSocketRecord> Sockets;
+	for (const USkeletalMeshSocket* Socket : MergedMesh->GetMeshOnlySocketList())
+	{
+		if (Socket)
+		{
+			FSocketRecord& Record = Sockets.AddDefaulted_GetRef();
+			Record.NameOffset = Writer.AddString(Socket->SocketName.ToString());
+			Record.BoneNameOffset = Writer.AddString(Socket->BoneName.ToString());
+			for (int32 Axis = 0; Axis < 3; Axis++)
+			{
+				Record.Location[Axis] = (float)Socket->RelativeLocation[Axis];
+				Record.Scale[Axis] = (float)Socket->RelativeScale[Axis];
+			}
+			Record.Rotation[0] = (float)Socket->RelativeRotation.Pitch;
+			Record.Rotation[1] = (float)Socket->RelativeRotation.Yaw;
+			Record.Rotation[2] = (float)Socket->RelativeRotation.Roll;
+		}
+	}
+	Header.NumSockets = Sockets.Num();
+	Header.Sockets = Writer.Write(Sockets);
+
+	TArray<FLODRecord> LODs;
+	for (int32 LODIdx = 0; LODIdx < RenderData->LODRenderData.Num(); LODIdx++)
+	{
+		FSkeletalMeshLODRenderData& LODData = RenderData->LODRenderData[LODIdx];
+		FStaticMeshVertexBuffer& StaticMeshVertexBuffer = LODData.StaticVertexBuffers.StaticMeshVertexBuffer;
+		const FSkinWeightVertexBuffer& SkinWeightBuffer = *LODData.GetSkinWeightVertexBuffer();
+		const FSkeletalMeshLODInfo* LODInfo = MergedMesh->GetLODInfo(LODIdx);
+
+		FLODRecord& LOD = LODs.AddDefaulted_GetRef();
+		LOD.ScreenSize = LODInfo ? LODInfo->ScreenSize.Default : 0.f;
+		LOD.LODHysteresis = LODInfo ? LODInfo->LODHysteresis : 0.f;
+		LOD.NumVertices = LODData.GetNumVertices();
+		LOD.NumTexCoords = StaticMeshVertexBuffer.GetNumTexCoords();
+		LOD.MaxBoneInfluences = SkinWeightBuffer.GetMaxBoneInfluences();
+		LOD.Flags = (StaticMeshVertexBuffer.GetUseFullPrecisionUVs() ? FullPrecisionUVs : 0)
+			| (StaticMeshVertexBuffer.GetUseHighPrecisionTangentBasis() ? HighPrecisionTangents : 0)
+			| (SkinWeightBuffer.Use16BitBoneIndex() ? Use16BitBoneIndex : 0)
+			| (SkinWeightBuffer.GetVariableBonesPerVertex() ? VariableBonesPerVertex : 0)
+			| (SkinWeightBuffer.Use16BitBoneWeight() ? Use16BitBoneWeight : 0);
+
+		// buffers without CPU data can't be cached
+		void* PositionData = LODData.StaticVertexBuffers.PositionVertexBuffer.GetVertexData();
+		void* TangentData = StaticMeshVertexBuffer.GetTangentData();
+		void* TexCoordData = StaticMeshVertexBuffer.GetTexCoordData();
+		const FSkinWeightDataVertexBuffer* SkinWeightData = SkinWeightBuffer.GetDataVertexBuffer();
+		FRawStaticIndexBuffer16or32Interface* IndexBuffer = LODData.MultiSizeIndexContainer.GetIndexBuffer();
+		if (LOD.NumVertices == 0 || !PositionData || !TangentData || (LOD.NumTexCoords > 0 && !TexCoordData) || !IndexBuffer
+			|| SkinWeightBuffer.GetNumVertices() != LOD.NumVertices || !SkinWeightData->GetWeightData())
+		{
+			UE_LOG(LogSkeletalMeshMerge, Warning, TEXT("Merge cache: LOD %d of %s has no CPU data, merge it with CPU access to cache it"), LODIdx, *MergedMesh->GetName());
+			return false;
+		}
+
+		LOD.Positions = Writer.Write(PositionData, (uint64)LOD.NumVertices * LODData.StaticVertexBuffers.PositionVertexBuffer.GetStride());
+		LOD.Tangents = Writer.Write(TangentData, StaticMeshVertexBuffer.GetTangentSize());
+		LOD.TexCoords = Writer.Write(TexCoordData, StaticMeshVertexBuffer.GetTexCoordSize());
+		if (Header.bHasVertexColors && LODData.StaticVertexBuffers.ColorVertexBuffer.GetNumVertices() == LOD.NumVertices)
+		{
+			LOD.Colors = Writer.Write(LODData.StaticVertexBuffers.ColorVertexBuffer.GetVertexData(), (uint64)LOD.NumVertices * sizeof(FColor));
+		}
+
+		// the weight data is stored as packed by the buffer (variable influences, 8 or 16 bit weights), not expanded per vertex
+		LOD.NumBoneWeights = SkinWeightData->GetNumBoneWeights();
+		LOD.SkinWeights = Writer.Write(SkinWeightData->GetWeightData(), SkinWeightData->GetVertexDataSize());
+		const FSkinWeightLookupVertexBuffer* SkinWeightLookup = SkinWeightBuffer.GetLookupVertexBuffer();
+		if (SkinWeightLookup->GetNumVertices() == LOD.NumVertices)
+		{
+			TArray<uint32> Lookup;
+			Lookup.SetNumUninitialized(LOD.NumVertices * 2);
+			for (uint32 VertIdx = 0; VertIdx < LOD.NumVertices; VertIdx++)
+			{
+				SkinWeightLookup->GetWeightOffsetAndInfluenceCount(VertIdx, Lookup[VertIdx * 2], Lookup[VertIdx * 2 + 1]);
+			}
+			LOD.SkinWeightLookup = Writer.Write(Lookup);
+		}
+		else if (SkinWeightBuffer.GetVariableBonesPerVertex())
+		{
+			UE_LOG(LogSkeletalMeshMerge, Warning, TEXT("Merge cache: LOD %d of %s has no skin weight lookup data"), LODIdx, *MergedMesh->GetName());
+			return false;
+		}
+
+		LOD.IndexStride = LODData.MultiSizeIndexContainer.GetDataTypeSize();
+		LOD.Indices = Writer.Write(IndexBuffer->GetPointerTo(0), (uint64)IndexBuffer->Num() * LOD.IndexStride);
+
+		TArray<FSectionRecord> Sections;
+		TArray<FBoneIndexType> BoneMaps;
+		for (const FSkelMeshRenderSection& Section : LODData.RenderSections)
+		{
+			FSectionRecord& Record = Sections.AddDefaulted_GetRef();
+			Record.MaterialIndex = Section.MaterialIndex;
+			Record.BaseIndex = Section.BaseIndex;
+			Record.NumTriangles = Section.NumTriangles;
+			Record.BaseVertexIndex = Section.BaseVertexIndex;
+			Record.NumVertices = Section.NumVertices;
+			Record.MaxBoneInfluences = Section.MaxBoneInfluences;
+			Record.BoneMapStart = BoneMaps.Num();
+			Record.BoneMapNum = Section.BoneMap.Num();
+			BoneMaps.Append(Section.BoneMap);
+		}
+		LOD.NumSections = Sections.Num();
+		LOD.Sections = Writer.Write(Sections);
+		LOD.BoneMaps = Writer.Write(BoneMaps);
+		LOD.ActiveBones = Writer.Write(LODData.ActiveBoneIndices);
+		LOD.RequiredBones = Writer.Write(LODData.RequiredBones);
+	}
+	Header.NumLODs = LODs.Num();
+	Header.LODs = Writer.Write(LODs);
+
+	// the validator needs the provenance of a cached mesh as much as a merged one
+	if (const UJrMergeProvenanceUserData* Provenance = MergedMesh->GetAssetUserData<UJrMergeProvenanceUserData>())
+	{
+		TArray<uint32> SourceOffsets;
+		for (const TSoftObjectPtr<USkeletalMesh>& SourceMesh : Provenance->SourceMeshes)
+		{
+			SourceOffsets.Add(Writer.AddString(SourceMesh.ToSoftObjectPath().ToString()));
+		}
+		Header.bHasProvenance = 1;
+		Header.ProvenanceSourceLOD = Provenance->SourceLODIndex;
+		Header.ProvenanceSources = Writer.Write(SourceOffsets);
+		Header.ProvenancePartIndices = Writer.Write(Provenance->VertexPartIndices);
+		Header.ProvenanceSourceIndices = Writer.Write(Provenance->VertexSourceIndices);
+	}
+	Header.Strings = Writer.Write(Writer.StringPool);
+
+	Header.FileSize = Writer.Data.Num();
+	FMemory::Memcpy(Writer.Data.GetData(), &Header, sizeof(FFileHeader));
+
+	const FString TempFilename = Filename + TEXT(".tmp");
+	if (!FFileHelper::SaveArrayToFile(Writer.Data, *TempFilename))
+	{
+		return false;
+	}
+	return IFileManager::Get().Move(*Filename, *TempFilename, true, true);
+}
+
+USkeletalMesh* FJrMergedMeshCache::Load(const FString& Filename, UObject* Outer, EJrCPUAccessStream CPUAccessStreams)
+{
+	using namespace JrMergedMeshCache;
+
+	TUniquePtr<IMappedFileHandle> MappedFile(FPlatformFileManager::Get().GetPlatformFile().OpenMapped(*Filename));
+	if (!MappedFile || MappedFile->GetFileSize() < (int64)sizeof(FFileHeader))
+	{
+		return nullptr;
+	}
+	TUniquePtr<IMappedFileRegion> Region(MappedFile->MapRegion(0, MappedFile->GetFileSize()));
+	if (!Region)
+	{
+		return nullptr;
+	}
+
+	FReader Reader;
+	Reader.Data = Region->GetMappedPtr();
+	Reader.Size = Region->GetMappedSize();
+
+	FFileHeader Header;
+	FMemory::Memcpy(&Header, Reader.Data, sizeof(FFileHeader));
+	if (Header.Magic != Magic || Header.Version != Version || Header.FileSize != Reader.Size
+		|| Header.BoneIndexSize != sizeof(FBoneIndexType)
+		|| !Reader.IsValid(Header.Strings) || !Reader.IsValid(Header.Bones, sizeof(FBoneRecord)) || !Reader.IsValid(Header.Materials, sizeof(FMaterialRecord))
+		|| !Reader.IsValid(Header.Sockets, sizeof(FSocketRecord)) || !Reader.IsValid(Header.LODs, sizeof(FLODRecord))
+		|| Header.NumLODs == 0 || Header.Bones.Size != Header.NumBones * sizeof(FBoneRecord) || Header.LODs.Size != Header.NumLODs * sizeof(FLODRecord)
+		|| Header.Materials.Size != Header.NumMaterials * sizeof(FMaterialRecord)
+		|| !Reader.IsValid(Header.ProvenanceSources, sizeof(uint32)) || !Reader.IsValid(Header.ProvenancePartIndices, sizeof(int32))
+		|| !Reader.IsValid(Header.ProvenanceSourceIndices, sizeof(int32)) || Header.ProvenancePartIndices.Size != Header.ProvenanceSourceIndices.Size)
+	{
+		UE_LOG(LogSkeletalMeshMerge, Log, TEXT("Merge cache: %s is outdated or corrupt"), *Filename);
+		return nullptr;
+	}
+	Reader.StringBlock = Header.Strings;
+
+	// validate every LOD before creating anything
+	const TArrayView<const FLODRecord> LODs = Reader.View<FLODRecord>(Header.LODs);
+	for (const FLODRecord& LOD : LODs)
+	{
+		const bool bValid = Reader.IsValid(LOD.Positions) && Reader.IsValid(LOD.Tangents) && Reader.IsValid(LOD.TexCoords) && Reader.IsValid(LOD.Colors)
+			&& Reader.IsValid(LOD.SkinWeights) && Reader.IsValid(LOD.SkinWeightLookup, sizeof(uint32))
+			&& (LOD.SkinWeightLookup.Size == (uint64)LOD.NumVertices * 2 * sizeof(uint32) || (LOD.SkinWeightLookup.Size == 0 && !(LOD.Flags & VariableBonesPerVertex)))
+			&& (LOD.IndexStride == sizeof(uint16) || LOD.IndexStride == sizeof(uint32)) && Reader.IsValid(LOD.Indices, LOD.IndexStride)
+			&& Reader.IsValid(LOD.Sections, sizeof(FSectionRecord)) && LOD.Sections.Size == LOD.NumSections * sizeof(FSectionRecord)
+			&& Reader.IsValid(LOD.BoneMaps, sizeof(FBoneIndexType)) && Reader.IsValid(LOD.ActiveBones, sizeof(FBoneIndexType)) && Reader.IsValid(LOD.RequiredBones, sizeof(FBoneIndexType))
+			&& AreLODRangesValid(Reader, LOD, Header.NumMaterials, Header.NumBones);
+		if (!bValid)
+		{
+			UE_LOG(LogSkeletalMeshMerge, Log, TEXT("Merge cache: %s is corrupt"), *Filename);
+			return nullptr;
+		}
+	}
+
+	USkeletalMesh* Mesh = NewObject<USkeletalMesh>(Outer ? Outer : GetTransientPackage(), NAME_None, RF_Transient);
+
+	{
+		FReferenceSkeletonModifier Modifier(Mesh->GetRefSkeleton(), nullptr);
+		for (const FBoneRecord& Bone : Reader.View<FBoneRecord>(Header.Bones))
+		{
+			const FName BoneName(*Reader.GetString(Bone.NameOffset));
+			const FTransform Pose(
+				FQuat(Bone.Rotation[0], Bone.Rotation[1], Bone.Rotation[2], Bone.Rotation[3]),
+				FVector(Bone.Translation[0], Bone.Translation[1], Bone.Translation[2]),
+				FVector(Bone.Scale[0], Bone.Scale[1], Bone.Scale[2]));
+			Modifier.Add(FMeshBoneInfo(BoneName, BoneName.ToString(), Bone.ParentIndex), Pose);
+		}
+	}
+
+	for (const FMaterialRecord& Record : Reader.View<FMaterialRecord>(Header.Materials))
+	{
+		UMaterialInterface* Material = Cast<UMaterialInterface>(FSoftObjectPath(Reader.GetString(Record.PathOffset)).TryLoad());
+		Mesh->GetMaterials().Add(FSkeletalMaterial(Material, true, false, FName(*Reader.GetString(Record.SlotNameOffset))));
+	}
+
+	for (const FSocketRecord& Record : Reader.View<FSocketRecord>(Header.Sockets))
+	{
+		USkeletalMeshSocket* Socket = NewObject<USkeletalMeshSocket>(Mesh);
+		Socket->SocketName = FName(*Reader.GetString(Record.NameOffset));
+		Socket->BoneName = FName(*Reader.GetString(Record.BoneNameOffset));
+		Socket->RelativeLocation = FVector(Record.Location[0], Record.Location[1], Record.Location[2]);
+		Socket->RelativeRotation = FRotator(Record.Rotation[0], Record.Rotation[1], Record.Rotation[2]);
+		Socket->RelativeScale = FVector(Record.Scale[0], Record.Scale[1], Record.Scale[2]);
+		Mesh->GetMeshOnlySocketList().Add(Socket);
+	}
+
+	Mesh->SetHasVertexColors(Header.bHasVertexColors != 0);
+	Mesh->AllocateResourceForRendering();
+	FSkeletalMeshRenderData* RenderData = Mesh->GetResourceForRendering();
+
+	for (const FLODRecord& LOD : LODs)
+	{
+		FSkeletalMeshLODRenderData& LODData = *new FSkeletalMeshLODRenderData;
+		RenderData->LODRenderData.Add(&LODData);
+
+		FSkeletalMeshLODInfo& LODInfo = Mesh->AddLODInfo();
+		LODInfo.ScreenSize = LOD.ScreenSize;
+		LODInfo.LODHysteresis = LOD.LODHysteresis;
+		LODInfo.BuildSettings.bUseFullPrecisionUVs = (LOD.Flags & FullPrecisionUVs) != 0;
+		LODInfo.BuildSettings.bUseHighPrecisionTangentBasis = (LOD.Flags & HighPrecisionTangents) != 0;
+
+		const TArrayView<const FBoneIndexType> BoneMaps = Reader.View<FBoneIndexType>(LOD.BoneMaps);
+		for (const FSectionRecord& Record : Reader.View<FSectionRecord>(LOD.Sections))
+		{
+			FSkelMeshRenderSection& Section = LODData.RenderSections.AddDefaulted_GetRef();
+			Section.MaterialIndex = (uint16)Record.MaterialIndex;
+			Section.BaseIndex = Record.BaseIndex;
+			Section.NumTriangles = Record.NumTriangles;
+			Section.BaseVertexIndex = Record.BaseVertexIndex;
+			Section.NumVertices = Record.NumVertices;
+			Section.MaxBoneInfluences = Record.MaxBoneInfluences;
+			Section.BoneMap.Append(BoneMaps.Slice(Record.BoneMapStart, Record.BoneMapNum));
+
+			// no overlapping vertex data, same as a merged section built from synthesized indices
+			Section.DuplicatedVerticesBuffer.DupVertData.ResizeBuffer(1);
+			Section.DuplicatedVerticesBuffer.DupVertIndexData.ResizeBuffer(Section.NumVertices);
+			FMemory::Memzero(Section.DuplicatedVerticesBuffer.DupVertIndexData.GetDataPointer(), Section.NumVertices * sizeof(FIndexLengthPair));
+			FMemory::Memzero(Section.DuplicatedVerticesBuffer.DupVertData.GetDataPointer(), sizeof(uint32));
+		}
+
+		// same CPU copies as the merge keeps (FJrSkeletalMeshMergeOptions::CPUAccessStreams), every stream if the section bone maps
+		// above need CPU skinning
+		const bool bCPUSkinning = RenderData->RequiresCPUSkinning(GMaxRHIFeatureLevel);
+		const bool bPositionsCPUAccess = bCPUSkinning || EnumHasAnyFlags(CPUAccessStreams, EJrCPUAccessStream::Positions);
+		const bool bTangentsCPUAccess = bCPUSkinning || EnumHasAnyFlags(CPUAccessStreams, EJrCPUAccessStream::TangentsAndUVs);
+		const bool bSkinWeightsCPUAccess = bCPUSkinning || EnumHasAnyFlags(CPUAccessStreams, EJrCPUAccessStream::SkinWeights);
+		const bool bColorsCPUAccess = bCPUSkinning || EnumHasAnyFlags(CPUAccessStreams, EJrCPUAccessStream::Colors);
+
+		// the blocks are images of the buffer CPU data, copied as they are
+		FStaticMeshVertexBuffer& StaticMeshVertexBuffer = LODData.StaticVertexBuffers.StaticMeshVertexBuffer;
+		StaticMeshVertexBuffer.SetUseFullPrecisionUVs(LODInfo.BuildSettings.bUseFullPrecisionUVs);
+		StaticMeshVertexBuffer.SetUseHighPrecisionTangentBasis(LODInfo.BuildSettings.bUseHighPrecisionTangentBasis);
+		StaticMeshVertexBuffer.Init(LOD.NumVertices, LOD.NumTexCoords, bTangentsCPUAccess);
+		LODData.StaticVertexBuffers.PositionVertexBuffer.Init(LOD.NumVertices, bPositionsCPUAccess);
+		if (LOD.Positions.Size != (uint64)LOD.NumVertices * LODData.StaticVertexBuffers.PositionVertexBuffer.GetStride()
+			|| LOD.Tangents.Size != (uint64)StaticMeshVertexBuffer.GetTangentSize() || LOD.TexCoords.Size != (uint64)StaticMeshVertexBuffer.GetTexCoordSize())
+		{
+			UE_LOG(LogSkeletalMeshMerge, Log, TEXT("Merge cache: %s doesn't match the engine vertex layout"), *Filename);
+			Mesh->MarkAsGarbage();
+			return nullptr;
+		}
+		FMemory::Memcpy(LODData.StaticVertexBuffers.PositionVertexBuffer.GetVertexData(), Reader.Data + LOD.Positions.Offset, LOD.Positions.Size);
+		FMemory::Memcpy(StaticMeshVertexBuffer.GetTangentData(), Reader.Data + LOD.Tangents.Offset, LOD.Tangents.Size);
+		if (LOD.TexCoords.Size > 0)
+		{
+			FMemory::Memcpy(StaticMeshVertexBuffer.GetTexCoordData(), Reader.Data + LOD.TexCoords.Offset, LOD.TexCoords.Size);
+		}
+		if (LOD.Colors.Size == (uint64)LOD.NumVertices * sizeof(FColor))
+		{
+			LODData.StaticVertexBuffers.ColorVertexBuffer.InitFromColorArray(reinterpret_cast<const FColor*>(Reader.Data + LOD.Colors.Offset), LOD.NumVertices, sizeof(FColor), bColorsCPUAccess);
+		}
+
+		FSkinWeightVertexBuffer& SkinWeightBuffer = LODData.SkinWeightVertexBuffer;
+		SkinWeightBuffer.SetVariableBonesPerVertex((LOD.Flags & VariableBonesPerVertex) != 0);
+		SkinWeightBuffer.SetMaxBoneInfluences(LOD.MaxBoneInfluences);
+		SkinWeightBuffer.SetUse16BitBoneIndex((LOD.Flags & Use16BitBoneIndex) != 0);
+		SkinWeightBuffer.SetUse16BitBoneWeight((LOD.Flags & Use16BitBoneWeight) != 0);
+		SkinWeightBuffer.SetNeedsCPUAccess(bSkinWeightsCPUAccess);
+		SkinWeightBuffer.GetDataVertexBuffer()->Init(LOD.NumBoneWeights, LOD.NumVertices);
+		if (LOD.SkinWeights.Size != SkinWeightBuffer.GetDataVertexBuffer()->GetVertexDataSize())
+		{
+			UE_LOG(LogSkeletalMeshMerge, Log, TEXT("Merge cache: %s doesn't match the engine skin weight layout"), *Filename);
+			Mesh->MarkAsGarbage();
+			return nullptr;
+		}
+		FMemory::Memcpy(SkinWeightBuffer.GetDataVertexBuffer()->GetWeightData(), Reader.Data + LOD.SkinWeights.Offset, LOD.SkinWeights.Size);
+		if (LOD.SkinWeightLookup.Size > 0)
+		{
+			const TArrayView<const uint32> Lookup = Reader.View<uint32>(LOD.SkinWeightLookup);
+			FSkinWeightLookupVertexBuffer* LookupBuffer = SkinWeightBuffer.GetLookupVertexBuffer();
+			LookupBuffer->Init(LOD.NumVertices);
+			for (uint32 VertIdx = 0; VertIdx < LOD.NumVertices; VertIdx++)
+			{
+				LookupBuffer->SetWeightOffsetAndInfluenceCount(VertIdx, Lookup[VertIdx * 2], Lookup[VertIdx * 2 + 1]);
+			}
+		}
+
+		const uint32 NumIndices = (uint32)(LOD.Indices.Size / LOD.IndexStride);
+		LODData.MultiSizeIndexContainer.CreateIndexBuffer(LOD.IndexStride);
+		LODData.MultiSizeIndexContainer.GetIndexBuffer()->Insert(0, NumIndices);
+		FMemory::Memcpy(LODData.MultiSizeIndexContainer.GetIndexBuffer()->GetPointerTo(0), Reader.Data + LOD.Indices.Offset, LOD.Indices.Size);
+
+		LODData.ActiveBoneIndices.Append(Reader.View<FBoneIndexType>(LOD.ActiveBones));
+		LODData.RequiredBones.Append(Reader.View<FBoneIndexType>(LOD.RequiredBones));
+	}
+
+	if (Header.bHasProvenance)
+	{
+		UJrMergeProvenanceUserData* Provenance = NewObject<UJrMergeProvenanceUserData>(Mesh);
+		for (const uint32 PathOffset : Reader.View<uint32>(Header.ProvenanceSources))
+		{
+			Provenance->SourceMeshes.Add(TSoftObjectPtr<USkeletalMesh>(FSoftObjectPath(Reader.GetString(PathOffset))));
+		}
+		Provenance->SourceLODIndex = Header.ProvenanceSourceLOD;
+		Provenance->VertexPartIndices = TArray<int32>(Reader.View<int32>(Header.ProvenancePartIndices));
+		Provenance->VertexSourceIndices = TArray<int32>(Reader.View<int32>(Header.ProvenanceSourceIndices));
+		Mesh->AddAssetUserData(Provenance);
+	}
+
+	Mesh->CalculateInvRefMatrices();
+	Mesh->SetImportedBounds(FBoxSphereBounds(
+		FVector(Header.BoundsOrigin[0], Header.BoundsOrigin[1], Header.BoundsOrigin[2]),
+		FVector(Header.BoundsExtent[0], Header.BoundsExtent[1], Header.BoundsExtent[2]),
+		Header.BoundsRadius));
+	Mesh->InitResources();
+	return Mesh;
+}
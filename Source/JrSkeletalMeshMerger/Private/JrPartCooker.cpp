@@ -0,0 +1,175 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "JrPartCooker.h"
+#include "JrSkeletalMergingLibrary.h"
+#include "Engine/SkeletalMesh.h"
+#include "Hash/CityHash.h"
+#include "Rendering/SkeletalMeshModel.h"
+#include "Rendering/SkeletalMeshRenderData.h"
+
+#include UE_INLINE_GENERATED_CPP_BY_NAME(JrPartCooker)
+
+UJrCookedPartUserData* FJrPartCooker::CookPart(USkeletalMesh* Part, USkeletalMesh* MasterMesh)
+{
+	if (!Part || !MasterMesh || !Part->GetResourceForRendering())
+	{
+		return nullptr;
+	}
+
+	const FReferenceSkeleton& PartSkeleton = Part->GetRefSkeleton();
+	const FReferenceSkeleton& MasterSkeleton = MasterMesh->GetRefSkeleton();
+
+	// every part bone must be a master bone, otherwise the merged skeleton is not the master one
+	TArray<int32> PartToMasterBone;
+	PartToMasterBone.SetNumUninitialized(PartSkeleton.GetRawBoneNum());
+	for (int32 BoneIndex = 0; BoneIndex < PartSkeleton.GetRawBoneNum(); BoneIndex++)
+	{
+		PartToMasterBone[BoneIndex] = MasterSkeleton.FindRawBoneIndex(PartSkeleton.GetBoneName(BoneIndex));
+		if (PartToMasterBone[BoneIndex] == INDEX_NONE)
+		{
+			UE_LOG(LogSkeletalMeshMerge, Warning, TEXT("Part cooking: bone %s of %s is not in the master skeleton of %s"),
+				*PartSkeleton.GetBoneName(BoneIndex).ToString(), *Part->GetName(), *MasterMesh->GetName());
+			return nullptr;
+		}
+	}
+
+	UJrCookedPartUserData* CookedPart = NewObject<UJrCookedPartUserData>(Part);
+	CookedPart->MasterMesh = MasterMesh;
+	CookedPart->MasterSkeletonHash = HashSkeleton(MasterSkeleton);
+	CookedPart->PartSkeletonHash = HashSkeleton(PartSkeleton);
+	CookedPart->PartToMasterBone = MoveTemp(PartToMasterBone);
+
+	// same transform as the merge applies to the parts after the first one: part root space to master root space
+	Part->CalculateInvRefMatrices();
+	MasterMesh->CalculateInvRefMatrices();
+	const FMatrix44f NativeRootM = Part->GetRefBasesInvMatrix()[0];
+	const FMatrix44f MasterRootM = MasterMesh->GetRefBasesInvMatrix()[CookedPart->PartToMasterBone[0]];
+	const FMatrix44f RebaseMatrix = NativeRootM * MasterRootM.Inverse();
+	const bool bInMasterSpace = RebaseMatrix.Equals(FMatrix44f::Identity, UE_KINDA_SMALL_NUMBER);
+
+	const TIndirectArray<FSkeletalMeshLODRenderData>& LODRenderData = Part->GetResourceForRendering()->LODRenderData;
+	for (int32 LODIdx = 0; LODIdx < LODRenderData.Num(); LODIdx++)
+	{
+		const FSkeletalMeshLODRenderData& LODData = LODRenderData[LODIdx];
+		FJrCookedPartLOD& CookedLOD = CookedPart->LODs.AddDefaulted_GetRef();
+		CookedLOD.LODKey = MakeLODKey(Part, LODIdx);
+		CookedLOD.bInMasterSpace = bInMasterSpace;
+
+		if (!bInMasterSpace)
+		{
+			const FPositionVertexBuffer& PositionVertexBuffer = LODData.StaticVertexBuffers.PositionVertexBuffer;
+			const FStaticMeshVertexBuffer& StaticMeshVertexBuffer = LODData.StaticVertexBuffers.StaticMeshVertexBuffer;
+			const uint32 NumVertices = PositionVertexBuffer.GetNumVertices();
+			CookedLOD.Positions.SetNumUninitialized(NumVertices);
+			CookedLOD.TangentsX.SetNumUninitialized(NumVertices);
+			CookedLOD.TangentsZ.SetNumUninitialized(NumVertices);
+			for (uint32 VertIdx = 0; VertIdx < NumVertices; VertIdx++)
+			{
+				const FVector4f TangentZ = StaticMeshVertexBuffer.VertexTangentZ(VertIdx);
+				CookedLOD.Positions[VertIdx] = RebaseMatrix.TransformPosition(PositionVertexBuffer.VertexPosition(VertIdx));
+				CookedLOD.TangentsX[VertIdx] = FVector3f(RebaseMatrix.TransformVector(FVector3f(StaticMeshVertexBuffer.VertexTangentX(VertIdx))));
+				CookedLOD.TangentsZ[VertIdx] = FVector4f(FVector3f(RebaseMatrix.TransformVector(FVector3f(TangentZ))), TangentZ.W);
+			}
+		}
+
+		for (const FSkelMeshRenderSection& Section : LODData.RenderSections)
+		{
+			FJrCookedPartSection& CookedSection = CookedLOD.Sections.AddDefaulted_GetRef();
+			CookedSection.NumVertices = Section.NumVertices;
+			CookedSection.NumTriangles = Section.NumTriangles;
+			CookedSection.MaxBoneInfluences = Section.MaxBoneInfluences;
+			CookedSection.MasterBoneMap.Reserve(Section.BoneMap.Num());
+			for (const FBoneIndexType BoneIndex : Section.BoneMap)
+			{
+				CookedSection.MasterBoneMap.Add(CookedPart->PartToMasterBone[BoneIndex]);
+			}
+		}
+	}
+
+	Part->Modify();
+	Part->RemoveUserDataOfClass(UJrCookedPartUserData::StaticClass());
+	Part->AddAssetUserData(CookedPart);
+	Part->MarkPackageDirty();
+
+	UE_LOG(LogSkeletalMeshMerge, Log, TEXT("Part cooking: %s cooked against %s (%d LODs, %s)"), *Part->GetName(), *MasterMesh->GetName(),
+		CookedPart->LODs.Num(), bInMasterSpace ? TEXT("in master space") : TEXT("rebased"));
+	return CookedPart;
+}
+
+const UJrCookedPartUserData* FJrPartCooker::FindCookedData(const USkeletalMesh* Part, uint64 MergedSkeletonHash)
+{
+	const UJrCookedPartUserData* CookedPart = Part ? const_cast<USkeletalMesh*>(Part)->GetAssetUserData<UJrCookedPartUserData>() : nullptr;
+	if (!CookedPart || CookedPart->MasterSkeletonHash != MergedSkeletonHash)
+	{
+		return nullptr;
+	}
+
+	// the bone indices are only valid for the skeleton the part had when it was cooked
+	if (CookedPart->PartSkeletonHash != HashSkeleton(Part->GetRefSkeleton()) || CookedPart->PartToMasterBone.Num() != Part->GetRefSkeleton().GetRawBoneNum())
+	{
+		return nullptr;
+	}
+	return CookedPart;
+}
+
+uint64 FJrPartCooker::HashSkeleton(const FReferenceSkeleton& RefSkeleton)
+{
+	const TArray<FTransform>& RefBonePose = RefSkeleton.GetRawRefBonePose();
+	uint64 Hash = CityHash64(reinterpret_cast<const char*>(RefBonePose.GetData()), RefBonePose.Num() * sizeof(FTransform));
+	for (int32 BoneIndex = 0; BoneIndex < RefSkeleton.GetRawBoneNum(); BoneIndex++)
+	{
+		const FString BoneName = RefSkeleton.GetBoneName(BoneIndex).ToString();
+		const int32 ParentIndex = RefSkeleton.GetRawParentIndex(BoneIndex);
+		Hash = CityHash64WithSeed(reinterpret_cast<const char*>(*BoneName), BoneName.Len() * sizeof(TCHAR), Hash);
+		Hash = CityHash64WithSeed(reinterpret_cast<const char*>(&ParentIndex), sizeof(ParentIndex), Hash);
+	}
+	return FMath::Max<uint64>(Hash, 1);
+}
+
+uint64 FJrPartCooker::MakeLODKey(const USkeletalMesh* Mesh, int32 LODIndex)
+{
+	const FSkeletalMeshRenderData* RenderData = Mesh ? const_cast<USkeletalMesh*>(Mesh)->GetResourceForRendering() : nullptr;
+	if (!RenderData || !RenderData->LODRenderData.IsValidIndex(LODIndex))
+	{
+		return 0;
+	}
+
+	const FSkeletalMeshLODRenderData& LODData = RenderData->LODRenderData[LODIndex];
+	const uint32 Counts[] = { LODData.GetNumVertices(), (uint32)LODData.MultiSizeIndexContainer.GetIndexBuffer()->Num(), (uint32)LODData.RenderSections.Num() };
+	uint64 Hash = CityHash64(reinterpret_cast<const char*>(Counts), sizeof(Counts));
+#if WITH_EDITORONLY_DATA
+	if (const FSkeletalMeshModel* ImportedModel = const_cast<USkeletalMesh*>(Mesh)->GetImportedModel())
+	{
+		const FString ModelId = ImportedModel->GetIdString();
+		Hash = CityHash64WithSeed(reinterpret_cast<const char*>(*ModelId), ModelId.Len() * sizeof(TCHAR), Hash);
+	}
+#endif
+
+	// 0 stands for unknown content
+	return FMath::Max<uint64>(Hash, 1);
+}
+
+uint64 FJrPartCooker::HashLODVertices(const FSkeletalMeshLODRenderData& LODData)
+{
+	const FPositionVertexBuffer& Positions = LODData.StaticVertexBuffers.PositionVertexBuffer;
+	const FStaticMeshVertexBuffer& StaticMeshVertexBuffer = LODData.StaticVertexBuffers.StaticMeshVertexBuffer;
+	const FColorVertexBuffer& Colors = LODData.StaticVertexBuffers.ColorVertexBuffer;
+	const FSkinWeightDataVertexBuffer* SkinWeights = LODData.GetSkinWeightVertexBuffer()->GetDataVertexBuffer();
+
+	if (!Positions.GetVertexData() || !StaticMeshVertexBuffer.GetTangentData() || !StaticMeshVertexBuffer.GetTexCoordData() || !SkinWeights->GetWeightData())
+	{
+		return 0;
+	}
+
+	uint64 Hash = CityHash64(static_cast<const char*>(Positions.GetVertexData()), Positions.GetNumVertices() * Positions.GetStride());
+	Hash = CityHash64WithSeed(static_cast<const char*>(StaticMeshVertexBuffer.GetTangentData()), StaticMeshVertexBuffer.GetTangentSize(), Hash);
+	Hash = CityHash64WithSeed(static_cast<const char*>(StaticMeshVertexBuffer.GetTexCoordData()), StaticMeshVertexBuffer.GetTexCoordSize(), Hash);
+	Hash = CityHash64WithSeed(reinterpret_cast<const char*>(SkinWeights->GetWeightData()), SkinWeights->GetVertexDataSize(), Hash);
+	if (Colors.GetVertexData())
+	{
+		Hash = CityHash64WithSeed(static_cast<const char*>(Colors.GetVertexData()), Colors.GetNumVertices() * Colors.GetStride(), Hash);
+	}
+
+	// 0 stands for unknown content
+	return FMath::Max<uint64>(Hash, 1);
+}
@@ -8,9 +8,16 @@
 #include "EditorAssetLibrary.h"
 #include "EditorDialogLibrary.h"
 #include "IAssetTools.h"
+#include "IMeshReductionInterfaces.h"
+#include "IMeshReductionManagerModule.h"
+#include "JrChildMeshSetup.h"
+#include "JrHierarchicalMerge.h"
+#include "JrMergedMeshCache.h"
 #include "JrSkeletalMeshMergeFunc.h"
+#include "LODUtilities.h"
 #include "SkeletalMeshAttributes.h"
 #include "SkinnedAssetCompiler.h"
+#include "Components/StaticMeshComponent.h"
 #include "Engine/SkeletalMeshSocket.h"
 #include "Engine/SkeletalMesh.h"
 #include "Algo/Accumulate.h"
@@ -19,6 +26,8 @@
 #include "Engine/SCS_Node.h"
 #include "Engine/SkeletalMeshLODSettings.h"
 #include "Engine/SkinnedAssetCommon.h"
+#include "Interfaces/ITargetPlatform.h"
+#include "Interfaces/ITargetPlatformManagerModule.h"
 #include "Modules/ModuleManager.h"
 #include "Rendering/SkeletalMeshModel.h"
 #include "Rendering/SkeletalMeshRenderData.h"
@@ -29,6 +38,11 @@
 #include "Engine/InheritableComponentHandler.h"
 #include "Factories/MaterialInstanceConstantFactoryNew.h"
 #include "Kismet/KismetSystemLibrary.h"
+#include "EdGraphSchema_K2.h"
+#include "K2Node_CallFunction.h"
+#include "K2Node_FunctionEntry.h"
+#include "K2Node_VariableGet.h"
+#include "Kismet2/BlueprintEditorUtils.h"
 #include "Kismet2/KismetEditorUtilities.h"
 #include "MaterialEditor/MaterialEditorInstanceConstant.h"
 #include "Materials/MaterialInstanceConstant.h"
@@ -397,6 +411,74 @@ void GenerateImportedModel(USkeletalMesh* SkeletalMesh)
 #endif
 }
 
+/**
+* Generates the LODs missing on the parts with the engine skeletal mesh reduction.
+* Parts that need new LODs are replaced in the list (and in the per-mesh rules of 'Options') by a transient copy,
+* the source assets are never modified.
+* @return false if no skeletal mesh reduction is available
+*/
+static bool ReduceMissingLODsWithEngine(TArray<USkeletalMesh*>& Meshes, FJrSkeletalMeshMergeOptions& Options, int32 StripTopLODs)
+{
+	IMeshReductionManagerModule& ReductionModule = FModuleManager::Get().LoadModuleChecked<IMeshReductionManagerModule>("MeshReductionInterface");
+	IMeshReduction* SkeletalReduction = ReductionModule.GetSkeletalMeshReductionInterface();
+	if (!SkeletalReduction || !SkeletalReduction->IsSupported())
+	{
+		return false;
+	}
+
+	int32 TargetLODCount = 0;
+	for (const USkeletalMesh* Mesh : Meshes)
+	{
+		TargetLODCount = FMath::Max(TargetLODCount, Mesh->GetLODNum());
+	}
+	if (Options.MaxLODCount > 0)
+	{
+		TargetLODCount = Options.MaxLODCount + StripTopLODs;
+	}
+
+	ITargetPlatform* RunningPlatform = GetTargetPlatformManagerRef().GetRunningTargetPlatform();
+	for (int32 MeshIndex = 0; MeshIndex < Meshes.Num(); MeshIndex++)
+	{
+		const int32 NumLODs = Meshes[MeshIndex]->GetLODNum();
+		if (NumLODs >= TargetLODCount)
+		{
+			continue;
+		}
+
+		// 第一个Mesh已经是拷贝出来的, 其他Mesh拷贝一份再减面
+		USkeletalMesh* ReducedMesh = MeshIndex == 0 ? Meshes[MeshIndex] : DuplicateObject<USkeletalMesh>(Meshes[MeshIndex], GetTransientPackage());
+		const FSkeletalMeshLODInfo* LastLODInfo = ReducedMesh->GetLODInfo(NumLODs - 1);
+		float ScreenSize = LastLODInfo ? LastLODInfo->ScreenSize.Default : 1.f;
+
+		FSkeletalMeshUpdateContext UpdateContext;
+		UpdateContext.SkeletalMesh = ReducedMesh;
+		for (int32 LODIndex = NumLODs; LODIndex < TargetLODCount; LODIndex++)
+		{
+			FSkeletalMeshLODInfo& LODInfo = ReducedMesh->AddLODInfo();
+			ScreenSize *= 0.5f;
+			LODInfo.ScreenSize = ScreenSize;
+			LODInfo.ReductionSettings.BaseLOD = NumLODs - 1;
+			LODInfo.ReductionSettings.TerminationCriterion = SMTC_NumOfTriangles;
+			LODInfo.ReductionSettings.NumOfTrianglesPercentage = Options.GetSynthesizedLODTriangleRatio(LODIndex - NumLODs);
+			FLODUtilities::SimplifySkeletalMeshLOD(UpdateContext, LODIndex, RunningPlatform);
+		}
+
+		// rebuild the render data with the new LODs
+		ReducedMesh->PostEditChange();
+		FSkinnedAssetCompilingManager& Manager = FSkinnedAssetCompilingManager::Get();
+		if (Manager.IsAsyncCompilationAllowed(ReducedMesh))
+		{
+			Manager.FinishCompilation({ReducedMesh});
+		}
+
+		UE_LOG(LogSkeletalMeshMerge, Log, TEXT("Reduced %d missing LOD(s) for %s"), TargetLODCount - NumLODs, *Meshes[MeshIndex]->GetName());
+		Options.RemapSourceMesh(Meshes[MeshIndex], ReducedMesh);
+		Meshes[MeshIndex] = ReducedMesh;
+	}
+
+	return true;
+}
+
 void UJrSkeletalMergingLibrary::SaveMergeSkeletal(FSkeletalMeshMergeParams& SkeletalMeshMergeParams, FSkeletonMergeParams& SkeletonMergeParams, TArray<USCS_Node*> SkeletalNodes)
 {
 	MergeSkeletal(SkeletalMeshMergeParams, SkeletonMergeParams, SkeletalNodes);
@@ -438,8 +520,9 @@ bool UJrSkeletalMergingLibrary::SaveMergeSkeletons(const FSkeletonMergeParams& m
 	return UPackage::SavePackage(Package, ResultMesh, *PackageFileName, args);
 }
 
-bool UJrSkeletalMergingLibrary::SaveMergeMeshes(const FSkeletalMeshMergeParams& mergeParams, TSubclassOf<AActor> ActorClass, const FString& fileName, const FString& AbsolutePath, USkeletalMesh* &ResultMesh)
+bool UJrSkeletalMergingLibrary::SaveMergeMeshes(const FSkeletalMeshMergeParams& mergeParams, const FJrSkeletalMeshMergeOptions& mergeOptions, TSubclassOf<AActor> ActorClass, const FString& fileName, const FString& AbsolutePath, USkeletalMesh* &ResultMesh, FJrMergeReport& MergeReport)
 {
+	MergeReport = FJrMergeReport();
 	const FString AssetPath = FPaths::ProjectContentDir();
 	const FString PackagePath = AbsolutePath + fileName;
 
@@ -458,7 +541,7 @@ bool UJrSkeletalMergingLibrary::SaveMergeMeshes(const FSkeletalMeshMergeParams&
 
 	UPackage* Package = CreatePackage(*FixedPackageName);
 
-	ResultMesh = MergeMeshes(mergeParams);
+	ResultMesh = MergeMeshes(mergeParams, mergeOptions, &MergeReport);
 
 	if (!ResultMesh)
 	{
@@ -475,6 +558,7 @@ bool UJrSkeletalMergingLibrary::SaveMergeMeshes(const FSkeletalMeshMergeParams&
 		ResultMesh->SetSkeleton(mergeParams.MeshesToMerge[0]->GetSkeleton());
 	}
 
+	const double SaveStartTime = FPlatformTime::Seconds();
 	GenerateImportedModel(ResultMesh);
 
 	ResultMesh->Rename(*fileName, Package, REN_DontCreateRedirectors);
@@ -497,7 +581,9 @@ bool UJrSkeletalMergingLibrary::SaveMergeMeshes(const FSkeletalMeshMergeParams&
 	FSavePackageArgs args;
 	args.TopLevelFlags = RF_Public | RF_Standalone;
 	const FString PackageFileName = FPackageName::LongPackageNameToFilename(FixedPackageName, FPackageName::GetAssetPackageExtension());
-	return UPackage::SavePackage(Package, ResultMesh, *PackageFileName, args);
+	const bool bSaved = UPackage::SavePackage(Package, ResultMesh, *PackageFileName, args);
+	MergeReport.AddPhaseTime(TEXT("Save"), SaveStartTime);
+	return bSaved;
 }
 
 void UJrSkeletalMergingLibrary::CreateComponentsByNode(USCS_Node* RootNode, UBlueprint* NewBlueprint)
@@ -532,7 +618,7 @@ void UJrSkeletalMergingLibrary::CreateComponentsByNode(USCS_Node* RootNode, UBlu
 	}
 }
 
-bool UJrSkeletalMergingLibrary::CreateBlueprintAssetAfterMerging(USkeletalMesh* SkelMesh, TArray<USkeletalMesh*> ChildSkelMesh, TSubclassOf<AActor> ActorClass, const FString& fileName, const FString& AbsolutePath)
+bool UJrSkeletalMergingLibrary::CreateBlueprintAssetAfterMerging(USkeletalMesh* SkelMesh, TArray<USkeletalMesh*> ChildSkelMesh, TSubclassOf<AActor> ActorClass, const FString& fileName, const FString& AbsolutePath, bool bSetupChildMeshes)
 {
 	if (!SkelMesh)
 	{
@@ -616,9 +702,145 @@ bool UJrSkeletalMergingLibrary::CreateBlueprintAssetAfterMerging(USkeletalMesh*
 		CreateComponentsByNode(NeedAddNodes[0], NewBlueprint);
 	}
 
+	// 不需要合并的Mesh跟随合并后的Mesh, 不再各自计算动画
+	if (bSetupChildMeshes && SetupChildMeshes(NewBlueprint, SkelMesh, ChildSkelMesh, FixedPackageName) > 0)
+	{
+		FKismetEditorUtilities::CompileBlueprint(NewBlueprint);
+	}
+
 	return UPackage::SavePackage(Package, NewBlueprint, *PackageFileName, args);
 }
 
+int32 UJrSkeletalMergingLibrary::SetupChildMeshes(UBlueprint* Blueprint, USkeletalMesh* SkelMesh, const TArray<USkeletalMesh*>& ChildSkelMesh, const FString& PackageName)
+{
+	USimpleConstructionScript* SCS = Blueprint->SimpleConstructionScript;
+
+	// 合并后的Mesh Node, 以及不需要合并的Mesh Node
+	USCS_Node* LeaderNode = nullptr;
+	TArray<USCS_Node*> ChildNodes;
+	for (USCS_Node* Node : SCS->GetAllNodes())
+	{
+		const USkeletalMeshComponent* SkelMeshComponent = Cast<USkeletalMeshComponent>(Node->ComponentTemplate);
+		if (!SkelMeshComponent)
+		{
+			continue;
+		}
+
+		if (SkelMeshComponent->GetSkeletalMeshAsset() == SkelMesh && !LeaderNode)
+		{
+			LeaderNode = Node;
+		}
+		else if (ChildSkelMesh.Contains(SkelMeshComponent->GetSkeletalMeshAsset()))
+		{
+			ChildNodes.Add(Node);
+		}
+	}
+
+	if (!LeaderNode)
+	{
+		return 0;
+	}
+
+	UEdGraph* ConstructionScript = FBlueprintEditorUtils::FindUserConstructionScript(Blueprint);
+	TArray<UK2Node_FunctionEntry*> EntryNodes;
+	if (ConstructionScript)
+	{
+		ConstructionScript->GetNodesOfClass(EntryNodes);
+	}
+	UEdGraphPin* ThenPin = EntryNodes.Num() > 0 ? EntryNodes[0]->FindPin(UEdGraphSchema_K2::PN_Then) : nullptr;
+	const UEdGraphSchema_K2* Schema = GetDefault<UEdGraphSchema_K2>();
+
+	auto MakeComponentGetter = [ConstructionScript](USCS_Node* Node, int32 PosX, int32 PosY)
+	{
+		FGraphNodeCreator<UK2Node_VariableGet> GetterCreator(*ConstructionScript);
+		UK2Node_VariableGet* Getter = GetterCreator.CreateNode();
+		Getter->VariableReference.SetSelfMember(Node->GetVariableName());
+		Getter->NodePosX = PosX;
+		Getter->NodePosY = PosY;
+		GetterCreator.Finalize();
+		return Getter;
+	};
+
+	int32 NumSetUp = 0;
+	for (USCS_Node* ChildNode : ChildNodes)
+	{
+		USkeletalMeshComponent* ChildComponent = CastChecked<USkeletalMeshComponent>(ChildNode->ComponentTemplate);
+		USkeletalMesh* ChildMesh = ChildComponent->GetSkeletalMeshAsset();
+
+		FName RigidBoneName;
+		EJrChildMeshMode Mode = FJrChildMeshSetup::Classify(ChildMesh, SkelMesh, RigidBoneName);
+
+		// 静态Mesh挂在骨骼上只对和合并后的Mesh重合、没有替换材质的部件成立
+		if (Mode == EJrChildMeshMode::StaticOnBone && (!ChildComponent->GetRelativeTransform().Equals(FTransform::Identity) || ChildComponent->OverrideMaterials.Num() > 0
+			|| ChildNode->GetChildNodes().Num() > 0))
+		{
+			Mode = EJrChildMeshMode::LeaderPose;
+		}
+
+		if (Mode == EJrChildMeshMode::StaticOnBone)
+		{
+			const FString StaticMeshPackageName = FPaths::GetPath(PackageName) / TEXT("SM_") + ChildMesh->GetName();
+			UStaticMesh* StaticMesh = ConvertSkeletalMeshToStaticMesh(ChildMesh, StaticMeshPackageName);
+			if (!StaticMesh)
+			{
+				Mode = EJrChildMeshMode::LeaderPose;
+			}
+			else
+			{
+				UPackage* StaticMeshPackage = StaticMesh->GetPackage();
+				FSavePackageArgs SaveArgs;
+				SaveArgs.TopLevelFlags = RF_Public | RF_Standalone;
+				UPackage::SavePackage(StaticMeshPackage, StaticMesh, *FPackageName::LongPackageNameToFilename(StaticMeshPackage->GetName(), FPackageName::GetAssetPackageExtension()), SaveArgs);
+
+				USCS_Node* StaticNode = SCS->CreateNode(UStaticMeshComponent::StaticClass(), SCS->GenerateNewComponentName(UStaticMeshComponent::StaticClass(), ChildNode->GetVariableName()));
+				UStaticMeshComponent* StaticComponent = CastChecked<UStaticMeshComponent>(StaticNode->ComponentTemplate);
+				StaticComponent->SetStaticMesh(StaticMesh);
+				StaticComponent->SetRelativeTransform(FJrChildMeshSetup::GetRigidMeshRelativeTransform(ChildMesh, RigidBoneName));
+				StaticComponent->SetCollisionEnabled(ChildComponent->GetCollisionEnabled());
+				StaticComponent->SetCastShadow(ChildComponent->CastShadow);
+				StaticNode->AttachToName = RigidBoneName;
+				LeaderNode->AddChildNode(StaticNode);
+				SCS->RemoveNodeAndPromoteChildren(ChildNode);
+
+				UE_LOG(LogSkeletalMeshMerge, Log, TEXT("%s: %s is a static mesh on bone %s."), *Blueprint->GetName(), *ChildMesh->GetName(), *RigidBoneName.ToString());
+				NumSetUp++;
+				continue;
+			}
+		}
+
+		if (Mode == EJrChildMeshMode::Independent || !ThenPin)
+		{
+			UE_LOG(LogSkeletalMeshMerge, Log, TEXT("%s: %s keeps its own animation, its bones are not all in %s."), *Blueprint->GetName(), *ChildMesh->GetName(), *SkelMesh->GetName());
+			continue;
+		}
+
+		// 跟随合并后的Mesh的姿势, 自己不再需要动画蓝图
+		ChildComponent->AnimClass = nullptr;
+		ChildComponent->bUseBoundsFromLeaderPoseComponent = true;
+
+		const int32 PosX = 300 + NumSetUp * 300;
+		FGraphNodeCreator<UK2Node_CallFunction> CallCreator(*ConstructionScript);
+		UK2Node_CallFunction* SetLeaderPose = CallCreator.CreateNode();
+		SetLeaderPose->SetFromFunction(USkinnedMeshComponent::StaticClass()->FindFunctionByName(GET_FUNCTION_NAME_CHECKED(USkinnedMeshComponent, SetLeaderPoseComponent)));
+		SetLeaderPose->NodePosX = PosX;
+		CallCreator.Finalize();
+
+		Schema->TryCreateConnection(ThenPin, SetLeaderPose->GetExecPin());
+		Schema->TryCreateConnection(MakeComponentGetter(ChildNode, PosX - 200, 150)->GetValuePin(), SetLeaderPose->FindPinChecked(UEdGraphSchema_K2::PN_Self));
+		Schema->TryCreateConnection(MakeComponentGetter(LeaderNode, PosX - 200, 250)->GetValuePin(), SetLeaderPose->FindPinChecked(TEXT("NewLeaderBoneComponent")));
+		ThenPin = SetLeaderPose->GetThenPin();
+
+		UE_LOG(LogSkeletalMeshMerge, Log, TEXT("%s: %s follows the pose of %s."), *Blueprint->GetName(), *ChildMesh->GetName(), *SkelMesh->GetName());
+		NumSetUp++;
+	}
+
+	if (NumSetUp > 0)
+	{
+		FBlueprintEditorUtils::MarkBlueprintAsStructurallyModified(Blueprint);
+	}
+	return NumSetUp;
+}
+
 TArray<USCS_Node*> UJrSkeletalMergingLibrary::GetSkeletalNodesByClass(const TSubclassOf<AActor> ActorClass)
 {
 	TArray<USCS_Node*> SkeletalNodes;
@@ -742,31 +964,52 @@ void UJrSkeletalMergingLibrary::BoneNameCheck(TArray<USkeleton*> Skeletons)
 	}
 }
 
-void UJrSkeletalMergingLibrary::ModifySameBoneName(TArray<TObjectPtr<USkeleton>>& Skeletons)
+TArray<FJrBoneNameRemap> UJrSkeletalMergingLibrary::MakeBoneNameRemaps(const TArray<USkeleton*>& Skeletons)
 {
-	TObjectPtr<USkeleton> RootSkeleton = nullptr;
-	for (TObjectPtr<USkeleton>& SourceSkeleton : Skeletons)
+	TArray<FJrBoneNameRemap> Remaps;
+	TArray<const USkeleton*> SkeletonsCache;
+	TSet<FName> UsedBoneNames;
+	for (const USkeleton* SourceSkeleton : Skeletons)
 	{
-		if (RootSkeleton)
+		if (!SourceSkeleton || SkeletonsCache.Contains(SourceSkeleton))
 		{
-			TArray<FMeshBoneInfo> CurrentBoneInfo = SourceSkeleton->GetReferenceSkeleton().GetRawRefBoneInfo();
-			auto LastBoneInfo = SourceSkeleton->GetReferenceSkeleton().GetRawRefBoneInfo();
-			for (auto& BoneInfo : CurrentBoneInfo)
+			continue;
+		}
+
+		// 与之前骨架同名的骨骼改名为 骨骼名_骨架名, 与 BoneNameCheck 的规则相同, 但不修改资产
+		FJrBoneNameRemap Remap;
+		Remap.Skeleton = const_cast<USkeleton*>(SourceSkeleton);
+		TArray<FName> MergedBoneNames;
+		for (const FMeshBoneInfo& BoneInfo : SourceSkeleton->GetReferenceSkeleton().GetRawRefBoneInfo())
+		{
+			FName MergedBoneName = BoneInfo.Name;
+			if (UsedBoneNames.Contains(BoneInfo.Name))
 			{
-				auto Index = LastBoneInfo.Find(BoneInfo);
-				if (Index != INDEX_NONE)
-				{
-					// 找到同名骨骼
-					BoneInfo.Name = FName(FString(BoneInfo.Name.ToString()).Append("_" + SourceSkeleton->GetName()));
-					BoneInfo.ExportName = BoneInfo.Name.ToString();
-				}
+				MergedBoneName = FName(BoneInfo.Name.ToString() + TEXT("_") + SourceSkeleton->GetName());
+				Remap.BoneNames.Add(BoneInfo.Name, MergedBoneName);
 			}
+			MergedBoneNames.Add(MergedBoneName);
 		}
-		else
+
+		UsedBoneNames.Append(MergedBoneNames);
+		SkeletonsCache.Add(SourceSkeleton);
+		if (Remap.BoneNames.Num() > 0)
 		{
-			RootSkeleton = SourceSkeleton;
+			Remaps.Add(MoveTemp(Remap));
 		}
 	}
+
+	return Remaps;
+}
+
+TArray<FJrBoneNameRemap> UJrSkeletalMergingLibrary::ModifySameBoneName(const TArray<TObjectPtr<USkeleton>>& Skeletons)
+{
+	TArray<USkeleton*> SkeletonList;
+	for (const TObjectPtr<USkeleton>& Skeleton : Skeletons)
+	{
+		SkeletonList.Add(Skeleton);
+	}
+	return MakeBoneNameRemaps(SkeletonList);
 }
 
 void UJrSkeletalMergingLibrary::MergeSkeletal(FSkeletalMeshMergeParams& SkeletalMeshMergeParams, FSkeletonMergeParams& SkeletonMergeParams, TArray<USCS_Node*> SkeletalNodes)
@@ -783,25 +1026,16 @@ void UJrSkeletalMergingLibrary::MergeSkeletal(FSkeletalMeshMergeParams& Skeletal
 		UE_LOG(LogSkeletalMeshMerge, Warning, TEXT("Must provide multiple valid Skeletal Meshes in order to perform a merge."));
 		return;
 	}
+}
 
-	TArray<TObjectPtr<USkeleton>> Skelesons;
-	for (auto Skeleton : SkeletonsToMergeCopy)
+USkeleton* UJrSkeletalMergingLibrary::MergeSkeletons(const FSkeletonMergeParams& Params, TArray<USCS_Node*> SkeletalNodes, const TArray<FJrBoneNameRemap>* BoneNameRemaps)
+{
+	FJrSkeletalMeshMergeOptions RemapOptions;
+	if (BoneNameRemaps)
 	{
-		USkeleton* CopyMesh = DuplicateObject<USkeleton>(Skeleton, nullptr);
-		Skeleton = CopyMesh;
+		RemapOptions.BoneNameRemaps = *BoneNameRemaps;
 	}
 
-	ModifySameBoneName(SkeletonsToMergeCopy);
-	// USkeleton* Skeleton = MergeSkeletons(SkeletonMergeParams, SkeletalNodes);
-	// if (SkeletalMeshMergeParams.bSkeletonBefore)
-	// {
-	// 	SkeletalMeshMergeParams.Skeleton = Skeleton;	
-	// }
-	// MergeMeshes(SkeletalMeshMergeParams);
-}
-
-USkeleton* UJrSkeletalMergingLibrary::MergeSkeletons(const FSkeletonMergeParams& Params, TArray<USCS_Node*> SkeletalNodes)
-{
 	// List of unique skeletons generated from input parameters
 	TArray<TObjectPtr<USkeleton>> ToMergeSkeletons;
 	for ( TObjectPtr<USkeleton> SkeletonPtr : Params.SkeletonsToMerge)
@@ -842,6 +1076,8 @@ USkeleton* UJrSkeletalMergingLibrary::MergeSkeletons(const FSkeletonMergeParams&
 	TMap<uint32, TObjectPtr<USkeletalMeshSocket>> HashToSockets;
 	// Combined from and to-bone name hash
 	TMap<uint32, const FVirtualBone*> HashToVirtualBones;
+	// Virtual bones with renamed bones
+	TIndirectArray<FVirtualBone> RemappedVirtualBones;
 
 	TMap<FName, const FCurveMetaData*> UniqueCurveNames;
 	TMap<FName, TSet<FName>> GroupToSlotNames;
@@ -864,7 +1100,7 @@ USkeleton* UJrSkeletalMergingLibrary::MergeSkeletons(const FSkeletonMergeParams&
 			const FMeshBoneInfo& Bone = Bones[BoneIndex];
 
 			// Retrieve parent bone name and respective hash, root-bone is assumed to have a parent hash of 0
-			FName ParentName = Bone.ParentIndex != INDEX_NONE ? Bones[Bone.ParentIndex].Name : NAME_None;
+			FName ParentName = Bone.ParentIndex != INDEX_NONE ? RemapOptions.RemapBoneName(Skeleton, Bones[Bone.ParentIndex].Name) : NAME_None;
 			ParentName = FName(ParentName.ToString() / FName("1").ToString());
 			uint32 ParentHash = Bone.ParentIndex != INDEX_NONE ? GetTypeHash(ParentName) : 0;
 
@@ -909,7 +1145,7 @@ USkeleton* UJrSkeletalMergingLibrary::MergeSkeletons(const FSkeletonMergeParams&
 			}
 			
 			// FName Bone_Name(Bone.Name);
-			FName Bone_Name(Bone.Name.ToString() / "1");
+			FName Bone_Name(RemapOptions.RemapBoneName(Skeleton, Bone.Name).ToString() / "1");
 			
 			// Look-up the path-hash from root to the parent bone
 			const uint32* ParentPath = BoneNamesToPathHash.Find(ParentName);
@@ -992,8 +1228,16 @@ USkeleton* UJrSkeletalMergingLibrary::MergeSkeletons(const FSkeletonMergeParams&
 		{
 			for (const TObjectPtr<USkeletalMeshSocket>& Socket : Skeleton->Sockets)
 			{
-				const uint32 Hash = HashCombine(GetTypeHash(Socket->SocketName), GetTypeHash(Socket->BoneName));
-				HashToSockets.Add(Hash, Socket);
+				TObjectPtr<USkeletalMeshSocket> MergeSocket = Socket;
+				const FName BoneName = RemapOptions.RemapBoneName(Skeleton, Socket->BoneName);
+				if (BoneName != Socket->BoneName)
+				{
+					MergeSocket = DuplicateObject<USkeletalMeshSocket>(Socket, GetTransientPackage());
+					MergeSocket->BoneName = BoneName;
+				}
+
+				const uint32 Hash = HashCombine(GetTypeHash(MergeSocket->SocketName), GetTypeHash(MergeSocket->BoneName));
+				HashToSockets.Add(Hash, MergeSocket);
 			}
 		}
 
@@ -1002,8 +1246,19 @@ USkeleton* UJrSkeletalMergingLibrary::MergeSkeletons(const FSkeletonMergeParams&
 			const TArray<FVirtualBone>& VirtualBones = Skeleton->GetVirtualBones();		
 	        for (const FVirtualBone& VB : VirtualBones)
 	        {
-	            const uint32 Hash = HashCombine(GetTypeHash(VB.SourceBoneName), GetTypeHash(VB.TargetBoneName));
-	            HashToVirtualBones.Add(Hash, &VB);
+	            const FVirtualBone* MergeVB = &VB;
+	            const FName SourceBoneName = RemapOptions.RemapBoneName(Skeleton, VB.SourceBoneName);
+	            const FName TargetBoneName = RemapOptions.RemapBoneName(Skeleton, VB.TargetBoneName);
+	            if (SourceBoneName != VB.SourceBoneName || TargetBoneName != VB.TargetBoneName)
+	            {
+	                FVirtualBone* RemappedVB = new FVirtualBone(SourceBoneName, TargetBoneName);
+	                RemappedVB->VirtualBoneName = VB.VirtualBoneName;
+	                RemappedVirtualBones.Add(RemappedVB);
+	                MergeVB = RemappedVB;
+	            }
+
+	            const uint32 Hash = HashCombine(GetTypeHash(MergeVB->SourceBoneName), GetTypeHash(MergeVB->TargetBoneName));
+	            HashToVirtualBones.Add(Hash, MergeVB);
 	        }
 		}		
 
@@ -1089,8 +1344,9 @@ USkeleton* UJrSkeletalMergingLibrary::MergeSkeletons(const FSkeletonMergeParams&
 	return GeneratedSkeleton;
 }
 
-USkeletalMesh* UJrSkeletalMergingLibrary::MergeMeshes(const FSkeletalMeshMergeParams& Params)
+USkeletalMesh* UJrSkeletalMergingLibrary::MergeMeshes(const FSkeletalMeshMergeParams& Params, const FJrSkeletalMeshMergeOptions& Options, FJrMergeReport* OutReport)
 {
+	const double StartTime = FPlatformTime::Seconds();
 	TArray<USkeletalMesh*> MeshesToMergeCopy = Params.MeshesToMerge;
 
 	MeshesToMergeCopy.RemoveAll([](USkeletalMesh* InMesh)
@@ -1104,7 +1360,39 @@ USkeletalMesh* UJrSkeletalMergingLibrary::MergeMeshes(const FSkeletalMeshMergePa
 		return nullptr;
 	}
 
-	EMeshBufferAccess BufferAccess = Params.bNeedsCpuAccess ?
+	// 缓存命中时直接加载缓存文件, 跳过合并
+	FString CacheFilename;
+	if (Options.bUseMergeCache)
+	{
+		CacheFilename = FJrMergedMeshCache::GetCacheFilename(FJrMergedMeshCache::MakeKey(Params, Options));
+		const EJrCPUAccessStream CPUAccessStreams = Params.bNeedsCpuAccess && Options.CPUAccessStreams == 0 ?
+			EJrCPUAccessStream::Positions | EJrCPUAccessStream::TangentsAndUVs | EJrCPUAccessStream::SkinWeights | EJrCPUAccessStream::Colors :
+			(EJrCPUAccessStream)Options.CPUAccessStreams;
+		if (USkeletalMesh* CachedMesh = FJrMergedMeshCache::Load(CacheFilename, nullptr, CPUAccessStreams))
+		{
+			if (Params.Skeleton)
+			{
+				CachedMesh->SetSkeleton(Params.Skeleton);
+			}
+
+			if (OutReport)
+			{
+				*OutReport = FJrMergeReport();
+				OutReport->bSuccess = true;
+				OutReport->NumInputMeshes = MeshesToMergeCopy.Num();
+				OutReport->BonesAfter = CachedMesh->GetRefSkeleton().GetRawBoneNum();
+				OutReport->CacheHits = 1;
+				OutReport->AddPhaseTime(TEXT("CacheLoad"), StartTime);
+			}
+			return CachedMesh;
+		}
+	}
+
+	// 原始的Mesh, 下面会替换成拷贝
+	const TArray<USkeletalMesh*> SourceMeshes = MeshesToMergeCopy;
+
+	// 指定了CPUAccessStreams时只保留这些Buffer的CPU数据, 写缓存在上传GPU之前进行, 不需要额外保留
+	EMeshBufferAccess BufferAccess = (Params.bNeedsCpuAccess && Options.CPUAccessStreams == 0) ?
 										EMeshBufferAccess::ForceCPUAndGPU :
 										EMeshBufferAccess::Default;
 	
@@ -1113,8 +1401,21 @@ USkeletalMesh* UJrSkeletalMergingLibrary::MergeMeshes(const FSkeletalMeshMergePa
 
 	// 拷贝一个新的Mesh替换掉第一个Mesh
 	USkeletalMesh* CopyMesh = DuplicateObject<USkeletalMesh>(MeshesToMergeCopy[0], nullptr);
+
+	// 按Mesh指定的规则要指向拷贝出来的Mesh
+	FJrSkeletalMeshMergeOptions MergeOptions = Options;
+	MergeOptions.RemapSourceMesh(MeshesToMergeCopy[0], CopyMesh);
 	MeshesToMergeCopy[0] = CopyMesh;
 
+	// 用引擎减面生成缺失的LOD, 没有减面模块时由Merger自己生成 (已经有足够LOD的Mesh会被Merger跳过)
+	if (MergeOptions.bSynthesizeMissingLODs && MergeOptions.bPreferEngineReduction)
+	{
+		if (!ReduceMissingLODsWithEngine(MeshesToMergeCopy, MergeOptions, Params.StripTopLODS))
+		{
+			UE_LOG(LogSkeletalMeshMerge, Log, TEXT("No skeletal mesh reduction available, missing LODs are synthesized by the merger."));
+		}
+	}
+
 	if (Params.Skeleton && Params.bSkeletonBefore)
 	{
 		USkeleton* NewSkeleton = Params.Skeleton;
@@ -1158,11 +1459,17 @@ USkeletalMesh* UJrSkeletalMergingLibrary::MergeMeshes(const FSkeletalMeshMergePa
 
 			MergedSkeletons.AddUnique(Skeleton);
 
+			// 新骨架里的骨骼是改名后的名字 (BoneNameRemaps), 查找和添加都要用改名后的名字
 			TArray<FMeshBoneInfo> BoneInfoArr = Mesh->GetRefSkeleton().GetRawRefBoneInfo();
 			for (int BoneInfoIndex = 0; BoneInfoIndex < BoneInfoArr.Num(); BoneInfoIndex++)
 			{
 				FMeshBoneInfo BoneInfo = BoneInfoArr[BoneInfoIndex];
-				int32 BoneIdxOnNewSkeleton = NewRefSkeleton.FindRawBoneIndex(BoneInfo.Name);
+				const FName MergedBoneName = MergeOptions.RemapBoneName(Skeleton, BoneInfo.Name);
+				int32 BoneIdxOnNewSkeleton = NewRefSkeleton.FindRawBoneIndex(MergedBoneName);
+				if (BoneIdxOnNewSkeleton == INDEX_NONE || RootSkelMesh->GetRefSkeleton().FindRawBoneIndex(MergedBoneName) != INDEX_NONE)
+				{
+					continue;
+				}
 				FTransform BonePose = NewRefSkeleton.GetRawRefBonePose()[BoneIdxOnNewSkeleton];
 
 				if (BoneInfoIndex == 0)
@@ -1174,8 +1481,12 @@ USkeletalMesh* UJrSkeletalMergingLibrary::MergeMeshes(const FSkeletalMeshMergePa
 				else
 				{
 					// 不同骨架合并的时候， 将非Root骨骼的ParentIndex设置为Root骨骼合并后的Index
-					BoneInfo.ParentIndex = RootSkelMesh->GetRefSkeleton().FindRawBoneIndex(BoneInfoArr[BoneInfo.ParentIndex].Name);
+					BoneInfo.ParentIndex = RootSkelMesh->GetRefSkeleton().FindRawBoneIndex(MergeOptions.RemapBoneName(Skeleton, BoneInfoArr[BoneInfo.ParentIndex].Name));
 				}
+				BoneInfo.Name = MergedBoneName;
+#if WITH_EDITORONLY_DATA
+				BoneInfo.ExportName = MergedBoneName.ToString();
+#endif
 
 				// 以第一个Mesh为基础， 将其他不同骨架的Mesh骨骼信息添加到第一个Mesh
 				Modifier.Add(BoneInfo, BonePose);
@@ -1189,12 +1500,97 @@ USkeletalMesh* UJrSkeletalMergingLibrary::MergeMeshes(const FSkeletalMeshMergePa
 
 	FSkelMeshMergeUVTransformMapping Mapping;
 	Mapping.UVTransformsPerMesh = Params.UVTransformsPerMesh;
-	FJrSkeletalMeshMerge Merger(BaseMesh, MeshesToMergeCopy, Params.MeshSectionMappings, Params.StripTopLODS, BufferAccess, &Mapping);
-	if (!Merger.DoMerge())
+	const double PreparationTime = FPlatformTime::Seconds();
+
+	// 分组并行合并成中间Mesh, 最后只合并中间Mesh (LOD裁剪/UV变换/LOD生成已经在分组里做过)
+	TArray<USkeletalMesh*> FinalMeshes = MeshesToMergeCopy;
+	const TArray<FSkelMeshMergeSectionMapping> NoSectionMappings;
+	const TArray<FSkelMeshMergeSectionMapping>* SectionMappings = &Params.MeshSectionMappings;
+	int32 StripTopLODs = Params.StripTopLODS;
+	FJrHierarchicalMergeResult Subgroups;
+	const bool bHierarchical = FJrHierarchicalMerge::CanMergeHierarchically(Params, MergeOptions, MeshesToMergeCopy.Num());
+	if (bHierarchical)
+	{
+		if (!FJrHierarchicalMerge::MergeSubgroups(Params, SourceMeshes, MeshesToMergeCopy, MergeOptions, BaseMesh->GetSkeleton(), Subgroups))
+		{
+			UE_LOG(LogSkeletalMeshMerge, Warning, TEXT("Merge failed!"));
+			return nullptr;
+		}
+
+		FinalMeshes.Reset();
+		for (const TStrongObjectPtr<USkeletalMesh>& Intermediate : Subgroups.Meshes)
+		{
+			FinalMeshes.Add(Intermediate.Get());
+		}
+		MergeOptions = Subgroups.FinalOptions;
+		Mapping.UVTransformsPerMesh.Reset();
+		SectionMappings = &NoSectionMappings;
+		StripTopLODs = 0;
+	}
+	const double SubgroupTime = FPlatformTime::Seconds();
+
+	FJrSkeletalMeshMerge Merger(BaseMesh, FinalMeshes, *SectionMappings, StripTopLODs, BufferAccess, &Mapping, &MergeOptions);
+	// 写缓存时延后InitResources, 缓存文件从上传前的CPU数据写出
+	Merger.SetBuildRenderResources(CacheFilename.IsEmpty());
+	const bool bMerged = Merger.DoMerge();
+	if (OutReport)
+	{
+		// 拷贝/减面/骨架处理的时间记为Preparation, 放在Merger的阶段前面
+		*OutReport = Merger.GetReport();
+		FJrMergePhaseTiming Preparation;
+		Preparation.Phase = TEXT("Preparation");
+		Preparation.Milliseconds = (float)((PreparationTime - StartTime) * 1000.0);
+		OutReport->PhaseTimings.Insert(Preparation, 0);
+
+		if (bHierarchical)
+		{
+			// Merger只看到了中间Mesh, 输入统计改回原始的Mesh
+			FJrMergePhaseTiming SubgroupMerge;
+			SubgroupMerge.Phase = TEXT("SubgroupMerge");
+			SubgroupMerge.Milliseconds = (float)((SubgroupTime - PreparationTime) * 1000.0);
+			OutReport->PhaseTimings.Insert(SubgroupMerge, 1);
+			OutReport->NumInputMeshes = MeshesToMergeCopy.Num();
+			OutReport->BonesBefore = 0;
+			for (const USkeletalMesh* Mesh : MeshesToMergeCopy)
+			{
+				OutReport->BonesBefore += Mesh->GetRefSkeleton().GetRawBoneNum();
+			}
+			OutReport->CacheHits += Subgroups.CacheHits;
+			OutReport->IntermediateMerges = Subgroups.NumMerges;
+		}
+	}
+	if (!bMerged)
 	{
 		UE_LOG(LogSkeletalMeshMerge, Warning, TEXT("Merge failed!"));
 		return nullptr;
 	}
+
+	if (Options.bRecordVertexProvenance)
+	{
+		UJrMergeProvenanceUserData* Provenance = NewObject<UJrMergeProvenanceUserData>(BaseMesh);
+		for (USkeletalMesh* SourceMesh : SourceMeshes)
+		{
+			Provenance->SourceMeshes.Add(SourceMesh);
+		}
+		Provenance->SourceLODIndex = Params.StripTopLODS;
+		for (const FIntPoint& MergedSource : Merger.GetVertexProvenance())
+		{
+			// 分组合并时Merger记录的是中间Mesh的顶点, 再查一次中间Mesh的来源
+			const FIntPoint VertexSource = bHierarchical ? Subgroups.VertexProvenance[MergedSource.X][MergedSource.Y] : MergedSource;
+			Provenance->VertexPartIndices.Add(VertexSource.X);
+			Provenance->VertexSourceIndices.Add(VertexSource.Y);
+		}
+		BaseMesh->AddAssetUserData(Provenance);
+	}
+
+	for (const FJrLODMaskingStats& MaskingStats : Merger.GetMaskingStats())
+	{
+		if (MaskingStats.RemovedTriangles > 0)
+		{
+			UE_LOG(LogSkeletalMeshMerge, Log, TEXT("LOD %d: hidden-surface removal removed %d triangles and %d vertices"),
+				MaskingStats.LODIndex, MaskingStats.RemovedTriangles, MaskingStats.RemovedVertices);
+		}
+	}
 	
 	// 获取骨骼网格体的 LOD0 顶点数据
 	const FSkeletalMeshLODRenderData& LODData = BaseMesh->GetResourceForRendering()->LODRenderData[0];
@@ -1252,11 +1648,130 @@ USkeletalMesh* UJrSkeletalMergingLibrary::MergeMeshes(const FSkeletalMeshMergePa
 		UE_LOG(LogSkeletalMeshMerge, Warning, TEXT("SkelMeshSocketCount: %d | SkelSocketCount: %d | Combined: %d"), SkelMeshSockets.Num(), SkelSockets.Num(), Total);
 		UE_LOG(LogSkeletalMeshMerge, Warning, TEXT("SkelMeshSocketCount: %d | SkelSocketCount: %d | Combined: %d"), UniqueSkelMeshSockets.Num(), UniqueSkelSockets.Num(), UniqueTotal);
 		UE_LOG(LogSkeletalMeshMerge, Warning, TEXT("Found Duplicates: %s"), *((Total != UniqueTotal) ? FString("True") : FString("False")));
+
+		if (OutReport)
+		{
+			OutReport->DuplicateSockets = Total - UniqueTotal;
+		}
+	}
+
+	if (!CacheFilename.IsEmpty())
+	{
+		if (!FJrMergedMeshCache::Save(BaseMesh, CacheFilename))
+		{
+			UE_LOG(LogSkeletalMeshMerge, Warning, TEXT("Failed to write the merge cache file %s"), *CacheFilename);
+		}
+
+		// 上传后只保留CPUAccessStreams的CPU数据
+		const double InitResourcesTime = FPlatformTime::Seconds();
+		BaseMesh->InitResources();
+		if (OutReport)
+		{
+			OutReport->AddPhaseTime(TEXT("InitResources"), InitResourcesTime);
+		}
 	}
 
 	return BaseMesh;
 }
 
+FJrMergeReport UJrSkeletalMergingLibrary::PlanMerge(const FSkeletalMeshMergeParams& Params, const FJrSkeletalMeshMergeOptions& Options)
+{
+	FJrMergeReport Plan;
+	Plan.bDryRun = true;
+
+	TArray<USkeletalMesh*> MeshesToMergeCopy = Params.MeshesToMerge;
+	MeshesToMergeCopy.RemoveAll([](USkeletalMesh* InMesh)
+	{
+		return InMesh == nullptr;
+	});
+
+	if (MeshesToMergeCopy.Num() <= 1)
+	{
+		UE_LOG(LogSkeletalMeshMerge, Warning, TEXT("Must provide multiple valid Skeletal Meshes in order to perform a merge."));
+		return Plan;
+	}
+
+	// 只用来提供骨架, 不会生成任何数据
+	USkeletalMesh* BaseMesh = NewObject<USkeletalMesh>(GetTransientPackage());
+	if (Params.Skeleton)
+	{
+		BaseMesh->SetSkeleton(Params.Skeleton);
+	}
+
+	FSkelMeshMergeUVTransformMapping Mapping;
+	Mapping.UVTransformsPerMesh = Params.UVTransformsPerMesh;
+	FJrSkeletalMeshMerge Merger(BaseMesh, MeshesToMergeCopy, Params.MeshSectionMappings, Params.StripTopLODS, EMeshBufferAccess::Default, &Mapping, &Options);
+	Merger.PlanMerge(Plan);
+	return Plan;
+}
+
+FJrMergePartitionResult UJrSkeletalMergingLibrary::MergeMeshesWithinBudget(const FSkeletalMeshMergeParams& Params, const FJrSkeletalMeshMergeOptions& Options, const FJrMergeBudget& Budget)
+{
+	FJrMergePartitionResult Result = FJrMergePartitioner::Partition(Params, Options, Budget);
+	for (FJrMergePartition& Partition : Result.Partitions)
+	{
+		// 只有一个Mesh的分区直接使用原Mesh
+		if (Partition.SourceIndices.Num() == 1)
+		{
+			Partition.Mesh = Params.MeshesToMerge[Partition.SourceIndices[0]];
+			continue;
+		}
+
+		FSkeletalMeshMergeParams PartitionParams = Params;
+		PartitionParams.MeshesToMerge.Reset();
+		PartitionParams.MeshSectionMappings.Reset();
+		PartitionParams.UVTransformsPerMesh.Reset();
+		for (const int32 MeshIdx : Partition.SourceIndices)
+		{
+			PartitionParams.MeshesToMerge.Add(Params.MeshesToMerge[MeshIdx]);
+			if (Params.MeshSectionMappings.Num() == Params.MeshesToMerge.Num())
+			{
+				PartitionParams.MeshSectionMappings.Add(Params.MeshSectionMappings[MeshIdx]);
+			}
+			if (Params.UVTransformsPerMesh.IsValidIndex(MeshIdx))
+			{
+				PartitionParams.UVTransformsPerMesh.Add(Params.UVTransformsPerMesh[MeshIdx]);
+			}
+		}
+
+		Partition.Mesh = MergeMeshes(PartitionParams, Options);
+		if (!Partition.Mesh)
+		{
+			UE_LOG(LogSkeletalMeshMerge, Warning, TEXT("Merge partition starting at source %d failed."), Partition.SourceIndices[0]);
+			Result.bWithinBudget = false;
+		}
+	}
+	return Result;
+}
+
+FJrMergeBenchmarkReport UJrSkeletalMergingLibrary::RunMergeBenchmark(const FJrMergeBenchmarkSettings& Settings)
+{
+	return FJrMergeBenchmark::Run(Settings);
+}
+
+int32 UJrSkeletalMergingLibrary::CookPartsForMaster(const TArray<USkeletalMesh*>& Parts, USkeletalMesh* MasterMesh)
+{
+	int32 NumCooked = 0;
+	for (USkeletalMesh* Part : Parts)
+	{
+		if (FJrPartCooker::CookPart(Part, MasterMesh))
+		{
+			NumCooked++;
+		}
+	}
+	return NumCooked;
+}
+
+FJrMergeValidationReport UJrSkeletalMergingLibrary::ValidateMergedMesh(USkeletalMesh* MergedMesh, const TArray<FTransform>& PartTransforms, const TArray<UAnimSequence*>& Animations, int32 NumFramesPerAnimation)
+{
+	return FJrMergeValidator::Validate(MergedMesh, PartTransforms, Animations, NumFramesPerAnimation);
+}
+
+FJrCrowdBuildResult UJrSkeletalMergingLibrary::BuildInstancedCrowd(AActor* Owner, const TArray<FJrCrowdInstance>& Instances, const FJrCrowdSettings& Settings)
+{
+	return FJrCrowdBuilder::Build(Owner, Instances, Settings);
+}
+
 TArray<USkeletalMeshComponent*> UJrSkeletalMergingLibrary::GetSkeletalMeshByClass(const TSubclassOf<AActor> ActorClass)
 {
 	TArray<USkeletalMeshComponent*> SkelMeshes;
@@ -5,12 +5,18 @@
 =============================================================================*/
 
 #include "JrSkeletalMeshMergeFunc.h"
+#include "JrPartCooker.h"
+#include "Async/ParallelFor.h"
 #include "Animation/Skeleton.h"
 #include "Engine/SkeletalMesh.h"
 #include "Engine/SkeletalMeshSocket.h"
 #include "Engine/SkinnedAssetCommon.h"
+#include "Engine/Texture2D.h"
 #include "EngineLogs.h"
+#include "Hash/CityHash.h"
+#include "Math/Float16.h"
 #include "Rendering/SkeletalMeshRenderData.h"
+#include "Templates/IntegralConstant.h"
 
 // #include UE_INLINE_GENERATED_CPP_BY_NAME(JrSkeletalMeshMergeFunc)
 
@@ -23,13 +29,15 @@
 * @param InMergeMesh - destination mesh to merge to
 * @param InSrcMeshList - array of source meshes to merge
 * @param InForceSectionMapping - optional array to map sections from the source meshes to merged section entries
+* @param InMergeOptions - optional extra merge settings
 */
 FJrSkeletalMeshMerge::FJrSkeletalMeshMerge(USkeletalMesh* InMergeMesh, 
 									   const TArray<USkeletalMesh*>& InSrcMeshList, 
 									   const TArray<FSkelMeshMergeSectionMapping>& InForceSectionMapping,
 									   int32 InStripTopLODs,
                                        EMeshBufferAccess InMeshBufferAccess,
-									   const FSkelMeshMergeUVTransformMapping* InSectionUVTransforms)
+									   const FSkelMeshMergeUVTransformMapping* InSectionUVTransforms,
+									   const FJrSkeletalMeshMergeOptions* InMergeOptions)
 :	MergeMesh(InMergeMesh)
 ,	SrcMeshList(InSrcMeshList)
 ,	StripTopLODs(InStripTopLODs)
@@ -38,6 +46,11 @@ FJrSkeletalMeshMerge::FJrSkeletalMeshMerge(USkeletalMesh* InMergeMesh,
 ,	SectionUVTransforms(InSectionUVTransforms)
 {
 	check(MergeMesh);
+
+	if (InMergeOptions)
+	{
+		MergeOptions = *InMergeOptions;
+	}
 }
 
 
@@ -111,19 +124,34 @@ bool FJrSkeletalMeshMerge::DoMerge(TArray<FJrRefPoseOverride>* RefPoseOverrides
 
 void FJrSkeletalMeshMerge::MergeSkeleton(const TArray<FJrRefPoseOverride>* RefPoseOverrides /* = nullptr */)
 {
+	const double StartTime = FPlatformTime::Seconds();
+	Report = FJrMergeReport();
+
 	// Release the rendering resources.
 
-	MergeMesh->ReleaseResources();
-	MergeMesh->ReleaseResourcesFence.Wait();
+	if (bBuildRenderResources)
+	{
+		MergeMesh->ReleaseResources();
+		MergeMesh->ReleaseResourcesFence.Wait();
+	}
 
 	// Build the reference skeleton & sockets.
 
 	BuildReferenceSkeleton(SrcMeshList, NewRefSkeleton, MergeMesh->GetSkeleton());
+	bRemappedBonesResolved = CheckRemappedBones(NewRefSkeleton);
+
+	if (MergeOptions.bPruneUnusedBones)
+	{
+		PruneUnusedBones(NewRefSkeleton);
+	}
 
 	// Assign new referencer skeleton.
 	MergeMesh->SetRefSkeleton(NewRefSkeleton);
 
-	BuildSockets(SrcMeshList);
+	if (bBuildSockets)
+	{
+		BuildSockets(SrcMeshList);
+	}
 
 	// Override the reference bone poses & sockets, if specified.
 
@@ -134,15 +162,16 @@ void FJrSkeletalMeshMerge::MergeSkeleton(const TArray<FJrRefPoseOverride>* RefPo
 	}
 
 	// Rebuild inverse ref pose matrices here as some access patterns 
-	// may need to access these matrices before FinalizeMesh is called
-	// (which would *normally* rebuild the inv ref matrices).
-	MergeMesh->GetRefBasesInvMatrix().Empty();
-	MergeMesh->CalculateInvRefMatrices();
+	// may need to access these matrices before FinalizeMesh is called.
+	UpdateInvRefMatrices();
+
+	Report.AddPhaseTime(TEXT("Skeleton"), StartTime);
 }
 
 bool FJrSkeletalMeshMerge::FinalizeMesh()
 {
 	bool Result = true;
+	double PhaseStartTime = FPlatformTime::Seconds();
 
 	// Find the common maximum number of LODs available in the list of source meshes.
 
@@ -154,46 +183,58 @@ bool FJrSkeletalMeshMerge::FinalizeMesh()
 		return false;
 	}
 
-	ReleaseResources(MaxNumLODs);
-
-	// Create a mapping from each input mesh bone to bones in the merged mesh.
+	// a renamed bone missing from the merged skeleton would skin its vertices to another bone
+	if (!bRemappedBonesResolved)
+	{
+		return false;
+	}
 
-	SrcMeshInfo.Empty();
-	SrcMeshInfo.AddZeroed(SrcMeshList.Num());
+	ReleaseResources(MaxNumLODs);
 
-	for (int32 MeshIdx = 0; MeshIdx < SrcMeshList.Num(); MeshIdx++)
+	for (const USkeletalMesh* SrcMesh : SrcMeshList)
 	{
-		USkeletalMesh* SrcMesh = SrcMeshList[MeshIdx];
-		if (SrcMesh)
+		if (SrcMesh && SrcMesh->GetHasVertexColors())
 		{
-			if (SrcMesh->GetHasVertexColors())
-			{
-				MergeMesh->SetHasVertexColors(true);
+			MergeMesh->SetHasVertexColors(true);
 #if WITH_EDITORONLY_DATA
-				MergeMesh->SetVertexColorGuid(FGuid::NewGuid());
+			MergeMesh->SetVertexColorGuid(FGuid::NewGuid());
 #endif
-			}
-
-			FMergeMeshInfo& MeshInfo = SrcMeshInfo[MeshIdx];
-			MeshInfo.SrcToDestRefSkeletonMap.AddUninitialized(SrcMesh->GetRefSkeleton().GetRawBoneNum());
+			break;
+		}
+	}
 
-			for (int32 i = 0; i < SrcMesh->GetRefSkeleton().GetRawBoneNum(); i++)
-			{
-				FName SrcBoneName = SrcMesh->GetRefSkeleton().GetBoneName(i);
-				int32 DestBoneIndex = NewRefSkeleton.FindBoneIndex(SrcBoneName);
+	// Create a mapping from each input mesh bone to bones in the merged mesh.
+	BuildSourceBoneMaps();
 
-				if (DestBoneIndex == INDEX_NONE)
-				{
-					// Missing bones shouldn't be possible, but can happen with invalid meshes;
-					// map any bone we are missing to the 'root'.
+	// Generate the LODs that low-LOD parts are missing.
+	if (MergeOptions.bSynthesizeMissingLODs)
+	{
+		SynthesizeMissingLODs(MaxNumLODs);
+	}
 
-					DestBoneIndex = 0;
-				}
+	// Find the LODs small parts drop out at.
+	CalculatePartCulling(MaxNumLODs);
 
-				MeshInfo.SrcToDestRefSkeletonMap[i] = DestBoneIndex;
-			}
+	VertexProvenance.Reset();
+	PreviousLODVertexLayout.Reset();
+	Report.LODs.Reset(MaxNumLODs);
+	Report.NumInputMeshes = 0;
+	Report.BonesBefore = 0;
+	for (const USkeletalMesh* SrcMesh : SrcMeshList)
+	{
+		if (SrcMesh)
+		{
+			Report.NumInputMeshes++;
+			Report.BonesBefore += SrcMesh->GetRefSkeleton().GetRawBoneNum();
 		}
 	}
+	Report.BonesAfter = NewRefSkeleton.GetRawBoneNum();
+
+	MaskingStats.Reset(MaxNumLODs);
+	for (int32 LODIdx = 0; LODIdx < MaxNumLODs; LODIdx++)
+	{
+		MaskingStats.AddDefaulted_GetRef().LODIndex = LODIdx;
+	}
 
 	// If things are going ok so far...
 	if (Result)
@@ -215,17 +256,22 @@ bool FJrSkeletalMeshMerge::FinalizeMesh()
 
 			for (int32 LODIdx = 0; LODIdx < MaxNumLODs; LODIdx++)
 			{
-				if (SrcResource->LODRenderData.IsValidIndex(LODIdx))
+				// sources with fewer LODs (synthesized LODs) reuse the vertex format of their last LOD
+				const int32 SourceLODIdx = FMath::Min(LODIdx + StripTopLODs, SrcResource->LODRenderData.Num() - 1);
+				if (SrcResource->LODRenderData.IsValidIndex(SourceLODIdx))
 				{
 					uint32& NumUVSets = PerLODNumUVSets[LODIdx];
-					NumUVSets = FMath::Max(NumUVSets, SrcResource->LODRenderData[LODIdx].GetNumTexCoords());
+					NumUVSets = FMath::Max(NumUVSets, SrcResource->LODRenderData[SourceLODIdx].GetNumTexCoords());
 
-					PerLODMaxBoneInfluences[LODIdx] = FMath::Max(PerLODMaxBoneInfluences[LODIdx], SrcResource->LODRenderData[LODIdx].GetVertexBufferMaxBoneInfluences());
-					PerLODUse16BitBoneIndex[LODIdx] |= SrcResource->LODRenderData[LODIdx].DoesVertexBufferUse16BitBoneIndex();
+					PerLODMaxBoneInfluences[LODIdx] = FMath::Max(PerLODMaxBoneInfluences[LODIdx], SrcResource->LODRenderData[SourceLODIdx].GetVertexBufferMaxBoneInfluences());
+					PerLODUse16BitBoneIndex[LODIdx] |= SrcResource->LODRenderData[SourceLODIdx].DoesVertexBufferUse16BitBoneIndex();
 				}
 			}
 		}
 
+		Report.AddPhaseTime(TEXT("Setup"), PhaseStartTime);
+		PhaseStartTime = FPlatformTime::Seconds();
+
 		// process each LOD for the new merged mesh
 		MergeMesh->AllocateResourceForRendering();
 		for (int32 LODIdx = 0; LODIdx < MaxNumLODs; LODIdx++)
@@ -241,6 +287,9 @@ bool FJrSkeletalMeshMerge::FinalizeMesh()
 				GENERATE_LOD_MODEL(TGPUSkinVertexFloat32Uvs, PerLODNumUVSets[LODIdx]);
 			}
 		}
+		Report.AddPhaseTime(TEXT("LODGeneration"), PhaseStartTime);
+		PhaseStartTime = FPlatformTime::Seconds();
+
 		// update the merge skel mesh entries
 		if (!ProcessMergeMesh())
 		{
@@ -255,12 +304,224 @@ bool FJrSkeletalMeshMerge::FinalizeMesh()
 		}
 
 		// Reinitialize the mesh's render resources.
-		MergeMesh->InitResources();
+		if (bBuildRenderResources)
+		{
+			MergeMesh->InitResources();
+		}
+
+		Report.AddPhaseTime(TEXT("InitResources"), PhaseStartTime);
+	}
+
+	for (FJrLODMergeStats& LODStats : Report.LODs)
+	{
+		if (MaskingStats.IsValidIndex(LODStats.LODIndex))
+		{
+			LODStats.MaskedTriangles = MaskingStats[LODStats.LODIndex].RemovedTriangles;
+			LODStats.MaskedVertices = MaskingStats[LODStats.LODIndex].RemovedVertices;
+		}
 	}
+	Report.bSuccess = Result;
+
+	// the masking data is only needed while generating the LODs
+	MaskImages.Empty();
+	MaskOccluders.Empty();
+	SourceLODVertexHashes.Empty();
 
 	return Result;
 }
 
+bool FJrSkeletalMeshMerge::PlanMerge(FJrMergeReport& OutPlan)
+{
+	const double StartTime = FPlatformTime::Seconds();
+	Report = FJrMergeReport();
+	Report.bDryRun = true;
+
+	const int32 MaxNumLODs = CalculateLodCount(SrcMeshList);
+	if (MaxNumLODs == -1)
+	{
+		UE_LOG(LogSkeletalMesh, Warning, TEXT("FJrSkeletalMeshMerge: Invalid source mesh list"));
+		OutPlan = Report;
+		return false;
+	}
+
+	// same skeleton as MergeSkeleton, but kept local to the merger
+	BuildReferenceSkeleton(SrcMeshList, NewRefSkeleton, MergeMesh->GetSkeleton());
+	if (!CheckRemappedBones(NewRefSkeleton))
+	{
+		OutPlan = Report;
+		return false;
+	}
+	if (MergeOptions.bPruneUnusedBones)
+	{
+		PruneUnusedBones(NewRefSkeleton, true);
+	}
+
+	BuildSourceBoneMaps();
+
+	// the synthesized LOD screen sizes drive the part culling, their indices are not needed
+	if (MergeOptions.bSynthesizeMissingLODs)
+	{
+		SynthesizeMissingLODs(MaxNumLODs, false);
+	}
+	CalculatePartCulling(MaxNumLODs);
+
+	if (MergeOptions.PartMaskRules.Num() > 0)
+	{
+		UE_LOG(LogSkeletalMesh, Log, TEXT("FJrSkeletalMeshMerge: the merge plan doesn't evaluate the part mask rules, masked triangles are counted as kept."));
+	}
+
+	bool bHasVertexColors = false;
+	for (const USkeletalMesh* SrcMesh : SrcMeshList)
+	{
+		if (SrcMesh)
+		{
+			bHasVertexColors |= SrcMesh->GetHasVertexColors();
+			Report.NumInputMeshes++;
+			Report.BonesBefore += SrcMesh->GetRefSkeleton().GetRawBoneNum();
+		}
+	}
+	Report.BonesAfter = NewRefSkeleton.GetRawBoneNum();
+	Report.AddPhaseTime(TEXT("Skeleton"), StartTime);
+
+	const double SectionStartTime = FPlatformTime::Seconds();
+	for (int32 LODIdx = 0; LODIdx < MaxNumLODs; LODIdx++)
+	{
+		const int32 SourceLODIdx = LODIdx + StripTopLODs;
+
+		TArray<FNewSectionInfo> NewSectionArray;
+		GenerateNewSectionArray(NewSectionArray, SourceLODIdx);
+
+		FJrLODMergeStats& LODStats = Report.LODs.AddDefaulted_GetRef();
+		LODStats.LODIndex = LODIdx;
+		LODStats.InputSections = CountInputSections(SourceLODIdx);
+		LODStats.OutputSections = NewSectionArray.Num();
+		LODStats.DrawCallsSaved = LODStats.InputSections - LODStats.OutputSections;
+
+		TArray<FBoneIndexType> ActiveBones;
+		TArray<FBoneIndexType> RequiredBones;
+		uint32 NumUVs = 0;
+		bool bUse16BitBoneIndex = false;
+		bool bUseFullPrecisionUVs = false;
+		for (const FNewSectionInfo& NewSectionInfo : NewSectionArray)
+		{
+			for (const FBoneIndexType BoneIndex : NewSectionInfo.MergedBoneMap)
+			{
+				ActiveBones.AddUnique(BoneIndex);
+			}
+
+			for (const FMergeSectionInfo& MergeSectionInfo : NewSectionInfo.MergeSections)
+			{
+				const FSkeletalMeshRenderData* SrcResource = MergeSectionInfo.SkelMesh->GetResourceForRendering();
+				const int32 NumAuthoredLODs = SrcResource->LODRenderData.Num();
+				const FSkeletalMeshLODRenderData& SrcLODData = SrcResource->LODRenderData[FMath::Min(SourceLODIdx, NumAuthoredLODs - 1)];
+				const FSkeletalMeshLODInfo* SrcLODInfo = MergeSectionInfo.SkelMesh->GetLODInfo(FMath::Min(SourceLODIdx, NumAuthoredLODs - 1));
+
+				// LODs past the authored ones would be synthesized with the configured triangle ratio
+				const float TriangleRatio = (MergeOptions.bSynthesizeMissingLODs && SourceLODIdx >= NumAuthoredLODs) ?
+					MergeOptions.GetSynthesizedLODTriangleRatio(SourceLODIdx - NumAuthoredLODs) : 1.f;
+				LODStats.Triangles += FMath::Max(1, FMath::RoundToInt(MergeSectionInfo.Section->NumTriangles * TriangleRatio));
+				LODStats.Vertices += FMath::Max(1, FMath::RoundToInt(MergeSectionInfo.Section->NumVertices * TriangleRatio));
+
+				LODStats.MaxBoneInfluences = FMath::Max<int32>(LODStats.MaxBoneInfluences, SrcLODData.GetVertexBufferMaxBoneInfluences());
+				NumUVs = FMath::Max(NumUVs, SrcLODData.GetNumTexCoords());
+				bUse16BitBoneIndex |= SrcLODData.DoesVertexBufferUse16BitBoneIndex();
+				bUseFullPrecisionUVs |= SrcLODInfo && SrcLODInfo->BuildSettings.bUseFullPrecisionUVs;
+
+				for (const FBoneIndexType SrcBoneIndex : SrcLODData.RequiredBones)
+				{
+					const int32 MergeBoneIndex = NewRefSkeleton.FindBoneIndex(GetSourceBoneName(MergeSectionInfo.SkelMesh, SrcBoneIndex));
+					if (MergeBoneIndex != INDEX_NONE)
+					{
+						RequiredBones.AddUnique(MergeBoneIndex);
+					}
+				}
+			}
+		}
+
+		NewRefSkeleton.EnsureParentsExistAndSort(ActiveBones);
+		LODStats.ActiveBones = ActiveBones.Num();
+		LODStats.RequiredBones = RequiredBones.Num();
+
+		// position, packed tangents, UVs, skin weights (bone index + 16 bit weight per influence), colors and indices
+		const int64 VertexStride = sizeof(FVector3f) + 2 * sizeof(FPackedNormal)
+			+ NumUVs * (bUseFullPrecisionUVs ? sizeof(FVector2f) : sizeof(FVector2DHalf))
+			+ LODStats.MaxBoneInfluences * ((bUse16BitBoneIndex ? sizeof(uint16) : sizeof(uint8)) + sizeof(uint16))
+			+ (bHasVertexColors ? sizeof(FColor) : 0);
+		LODStats.b32BitIndices = LODStats.Vertices > MAX_uint16 + 1;
+		const int64 IndexSize = LODStats.b32BitIndices ? sizeof(uint32) : sizeof(uint16);
+		LODStats.BufferBytes = VertexStride * LODStats.Vertices + IndexSize * LODStats.Triangles * 3;
+	}
+	Report.AddPhaseTime(TEXT("Sections"), SectionStartTime);
+
+	Report.bSuccess = true;
+	OutPlan = Report;
+	return true;
+}
+
+void FJrSkeletalMeshMerge::BuildSourceBoneMaps()
+{
+	SrcMeshInfo.Empty();
+	SrcMeshInfo.AddZeroed(SrcMeshList.Num());
+
+	// parts cooked against the merged skeleton already have their bone indices
+	const uint64 MergedSkeletonHash = FJrPartCooker::HashSkeleton(NewRefSkeleton);
+
+	for (int32 MeshIdx = 0; MeshIdx < SrcMeshList.Num(); MeshIdx++)
+	{
+		USkeletalMesh* SrcMesh = SrcMeshList[MeshIdx];
+		if (SrcMesh)
+		{
+			FMergeMeshInfo& MeshInfo = SrcMeshInfo[MeshIdx];
+			MeshInfo.CookedPart = FJrPartCooker::FindCookedData(SrcMesh, MergedSkeletonHash);
+			if (MeshInfo.CookedPart)
+			{
+				MeshInfo.SrcToDestRefSkeletonMap = MeshInfo.CookedPart->PartToMasterBone;
+				continue;
+			}
+
+			MeshInfo.SrcToDestRefSkeletonMap.AddUninitialized(SrcMesh->GetRefSkeleton().GetRawBoneNum());
+
+			for (int32 i = 0; i < SrcMesh->GetRefSkeleton().GetRawBoneNum(); i++)
+			{
+				FName SrcBoneName = GetSourceBoneName(SrcMesh, i);
+				int32 DestBoneIndex = NewRefSkeleton.FindBoneIndex(SrcBoneName);
+
+				// Bones pruned from the merged skeleton map to their nearest kept ancestor.
+				for (int32 SrcAncestorIndex = i; DestBoneIndex == INDEX_NONE && SrcAncestorIndex > 0; )
+				{
+					SrcAncestorIndex = SrcMesh->GetRefSkeleton().GetParentIndex(SrcAncestorIndex);
+					DestBoneIndex = NewRefSkeleton.FindBoneIndex(GetSourceBoneName(SrcMesh, SrcAncestorIndex));
+				}
+
+				if (DestBoneIndex == INDEX_NONE)
+				{
+					// Missing bones shouldn't be possible, but can happen with invalid meshes;
+					// map any bone we are missing to the 'root'.
+
+					DestBoneIndex = 0;
+				}
+
+				MeshInfo.SrcToDestRefSkeletonMap[i] = DestBoneIndex;
+			}
+		}
+	}
+}
+
+int32 FJrSkeletalMeshMerge::CountInputSections(int32 LODIdx) const
+{
+	int32 NumSections = 0;
+	for (const USkeletalMesh* SrcMesh : SrcMeshList)
+	{
+		if (SrcMesh)
+		{
+			// every part draws its own sections as a separate component, culled parts included
+			const FSkeletalMeshRenderData* SrcResource = SrcMesh->GetResourceForRendering();
+			NumSections += SrcResource->LODRenderData[FMath::Min(LODIdx, SrcResource->LODRenderData.Num() - 1)].RenderSections.Num();
+		}
+	}
+	return NumSections;
+}
+
 /**
 * Merge a bonemap with an existing bonemap and keep track of remapping
 * (a bonemap is a list of indices of bones in the USkeletalMesh::RefSkeleton array)
@@ -311,6 +572,17 @@ void FJrSkeletalMeshMerge::GenerateNewSectionArray( TArray<FNewSectionInfo>& New
 			FSkeletalMeshLODRenderData& SrcLODData = SrcResource->LODRenderData[SourceLODIdx];
 			FSkeletalMeshLODInfo& SrcLODInfo = *(SrcMesh->GetLODInfo(SourceLODIdx));
 
+			// use the reduced indices if this LOD was synthesized for the source
+			const TArray<FSynthesizedLOD>& SynthesizedLODs = SrcMeshInfo[MeshIdx].SynthesizedLODs;
+			const int32 SynthesizedLODIdx = LODIdx - SrcResource->LODRenderData.Num();
+			const FSynthesizedLOD* SynthesizedLOD = SynthesizedLODs.IsValidIndex(SynthesizedLODIdx) ? &SynthesizedLODs[SynthesizedLODIdx] : nullptr;
+
+			// skip the parts culled from this LOD, their bones are then not added to the LOD either
+			if (LODIdx - StripTopLODs >= SrcMeshInfo[MeshIdx].CullLODIdx)
+			{
+				continue;
+			}
+
 			// iterate over each section of this LOD
 			for( int32 SectionIdx=0; SectionIdx < SrcLODData.RenderSections.Num(); SectionIdx++ )
 			{
@@ -378,6 +650,12 @@ void FJrSkeletalMeshMerge::GenerateNewSectionArray( TArray<FNewSectionInfo>& New
 							// so that the bone matrix indices can be updated for the vertices
 							MergeSectionInfo.BoneMapToMergedBoneMap = TempBoneMapToMergedBoneMap;
 
+							if (SynthesizedLOD)
+							{
+								MergeSectionInfo.OverrideIndices = &SynthesizedLOD->SectionIndices[SectionIdx];
+								MergeSectionInfo.OverrideScreenSize = SynthesizedLOD->ScreenSize;
+							}
+
 							// use the updated bonemap for this new section
 							NewSectionInfo.MergedBoneMap = TempMergedBoneMap;
 
@@ -409,6 +687,13 @@ void FJrSkeletalMeshMerge::GenerateNewSectionArray( TArray<FNewSectionInfo>& New
 						SrcMesh,
 						&SrcLODData.RenderSections[SectionIdx],
 						SrcUVTransform);
+
+					if (SynthesizedLOD)
+					{
+						MergeSectionInfo.OverrideIndices = &SynthesizedLOD->SectionIndices[SectionIdx];
+						MergeSectionInfo.OverrideScreenSize = SynthesizedLOD->ScreenSize;
+					}
+
 					// since merged bonemap == chunk.bonemap then remapping is just pass-through
 					MergeSectionInfo.BoneMapToMergedBoneMap.Empty( DestChunkBoneMap.Num() );
 					for( int32 i=0; i < DestChunkBoneMap.Num(); i++ )
@@ -421,54 +706,243 @@ void FJrSkeletalMeshMerge::GenerateNewSectionArray( TArray<FNewSectionInfo>& New
 	}
 }
 
-template<typename VertexDataType>
-void FJrSkeletalMeshMerge::CopyVertexFromSource(VertexDataType& DestVert, const FSkeletalMeshLODRenderData& SrcLODData, int32 SourceVertIdx, const FMergeSectionInfo& MergeSectionInfo)
+/** Where the merged positions and tangents of a section come from. */
+enum class EJrVertexRebase : uint8
+{
+	/** The source vertices, as they are. */
+	None,
+	/** The source vertices transformed by RebaseMatrix. */
+	Transform,
+	/** The vertices of a cooked part, already in the merged root space. */
+	Cooked,
+};
+
+/** Per-section constants of the vertex copy, computed once before the section vertices are copied. */
+struct FJrVertexCopyParams
+{
+	/** Source root to merged root bone space, for the parts that are not the first mesh. */
+	FMatrix44f RebaseMatrix = FMatrix44f::Identity;
+	/** Rebased vertices of the source LOD, for EJrVertexRebase::Cooked. */
+	const FJrCookedPartLOD* CookedLOD = nullptr;
+	/** Section UV transforms as 2D affine maps (X axis, Y axis, origin), identity past the given transforms. */
+	FVector2f UVTransforms[MAX_TEXCOORDS][3];
+	uint32 NumSourceUVs = 0;
+	EJrVertexRebase Rebase = EJrVertexRebase::None;
+	bool bUVTransform = false;
+};
+
+void FJrSkeletalMeshMerge::MakeVertexCopyParams(const FSkeletalMeshLODRenderData& SrcLODData, int32 SourceLODIdx, const FMergeSectionInfo& MergeSectionInfo, FJrVertexCopyParams& OutParams)
 {
-	DestVert.Position = SrcLODData.StaticVertexBuffers.PositionVertexBuffer.VertexPosition(SourceVertIdx);
-	DestVert.TangentX = SrcLODData.StaticVertexBuffers.StaticMeshVertexBuffer.VertexTangentX(SourceVertIdx);
-	DestVert.TangentZ = SrcLODData.StaticVertexBuffers.StaticMeshVertexBuffer.VertexTangentZ(SourceVertIdx);
+	OutParams.NumSourceUVs = SrcLODData.StaticVertexBuffers.StaticMeshVertexBuffer.GetNumTexCoords();
 
-	if (MergeSectionInfo.SkelMesh != SrcMeshList[0])
+	OutParams.Rebase = MergeSectionInfo.SkelMesh != SrcMeshList[0] ? EJrVertexRebase::Transform : EJrVertexRebase::None;
+	if (OutParams.Rebase == EJrVertexRebase::Transform)
 	{
-		const FReferenceSkeleton RefSkeleton = MergeMesh->GetRefSkeleton();
-		const FName RootBoneName = MergeSectionInfo.SkelMesh->GetRefSkeleton().GetBoneName(0);
-		const int32 RootBoneIndex = RefSkeleton.FindBoneIndex(RootBoneName);
-	
-		// Mesh原本的Root矩阵
-		const FMatrix44f NativeRootM = MergeSectionInfo.SkelMesh->GetRefBasesInvMatrix()[0];
-	
-		// 合并后的骨骼Root矩阵
-		const FMatrix44f MergeRootM = MergeMesh->GetRefBasesInvMatrix()[RootBoneIndex];
-		
-	
-		DestVert.Position = NativeRootM.TransformPosition(DestVert.Position);
-		DestVert.Position = MergeRootM.InverseTransformPosition(DestVert.Position);
-	
-		DestVert.TangentX = NativeRootM.TransformVector(DestVert.TangentX.ToFVector4f());
-		DestVert.TangentX = MergeRootM.InverseTransformVector(DestVert.TangentX.ToFVector4f());
-	
-		DestVert.TangentZ = NativeRootM.TransformVector(DestVert.TangentZ.ToFVector4f());
-		DestVert.TangentZ = MergeRootM.InverseTransformVector(DestVert.TangentZ.ToFVector4f());
+		OutParams.CookedLOD = FindCookedLOD(MergeSectionInfo.SkelMesh, SourceLODIdx);
+		if (OutParams.CookedLOD)
+		{
+			OutParams.Rebase = OutParams.CookedLOD->bInMasterSpace ? EJrVertexRebase::None : EJrVertexRebase::Cooked;
+		}
+	}
+	if (OutParams.Rebase == EJrVertexRebase::Transform)
+	{
+		OutParams.RebaseMatrix = GetSourceRebaseMatrix(MergeSectionInfo.SkelMesh);
+	}
+
+	OutParams.bUVTransform = MergeSectionInfo.UVTransforms.Num() > 0;
+	for (int32 UVIndex = 0; UVIndex < MAX_TEXCOORDS; UVIndex++)
+	{
+		// (U, V, 1) transformed as a position
+		const FMatrix44f M = MergeSectionInfo.UVTransforms.IsValidIndex(UVIndex) ? FMatrix44f(MergeSectionInfo.UVTransforms[UVIndex].ToMatrixWithScale()) : FMatrix44f::Identity;
+		OutParams.UVTransforms[UVIndex][0] = FVector2f(M.M[0][0], M.M[0][1]);
+		OutParams.UVTransforms[UVIndex][1] = FVector2f(M.M[1][0], M.M[1][1]);
+		OutParams.UVTransforms[UVIndex][2] = FVector2f(M.M[2][0] + M.M[3][0], M.M[2][1] + M.M[3][1]);
+	}
+}
+
+FMatrix44f FJrSkeletalMeshMerge::GetSourceRebaseMatrix(const USkeletalMesh* SkelMesh) const
+{
+	if (SkelMesh == SrcMeshList[0])
+	{
+		return FMatrix44f::Identity;
+	}
+
+	const FName RootBoneName = GetSourceBoneName(SkelMesh, 0);
+	const int32 RootBoneIndex = MergeMesh->GetRefSkeleton().FindBoneIndex(RootBoneName);
+
+	// Mesh原本的Root矩阵, 再转到合并后的骨骼Root空间
+	const FMatrix44f NativeRootM = SkelMesh->GetRefBasesInvMatrix()[0];
+	const FMatrix44f MergeRootM = MergeMesh->GetRefBasesInvMatrix()[RootBoneIndex];
+	return NativeRootM * MergeRootM.Inverse();
+}
+
+/**
+* Vertex copy of a whole section, specialized on the vertex format so the loop has no per-vertex branch.
+* @param NumSourceUVs - UV channels read from the source, the remaining channels of the vertex format are zeroed
+* @param Rebase - source of the positions and tangents, see EJrVertexRebase
+* @param bUVTransform - apply the section UV transforms
+*/
+template<typename VertexDataType, uint32 NumSourceUVs, EJrVertexRebase Rebase, bool bUVTransform>
+static void CopyVerticesKernel(VertexDataType* RESTRICT DestVerts, const FSkeletalMeshLODRenderData& SrcLODData, TArrayView<const uint32> SourceVertices, const FJrVertexCopyParams& Params)
+{
+	const FPositionVertexBuffer& PositionVertexBuffer = SrcLODData.StaticVertexBuffers.PositionVertexBuffer;
+	const FStaticMeshVertexBuffer& StaticMeshVertexBuffer = SrcLODData.StaticVertexBuffers.StaticMeshVertexBuffer;
+
+	for (int32 Idx = 0; Idx < SourceVertices.Num(); Idx++)
+	{
+		const uint32 SrcIdx = SourceVertices[Idx];
+		VertexDataType& DestVert = DestVerts[Idx];
+
+		if constexpr (Rebase == EJrVertexRebase::Transform)
+		{
+			const FVector4f TangentZ = StaticMeshVertexBuffer.VertexTangentZ(SrcIdx);
+			DestVert.Position = Params.RebaseMatrix.TransformPosition(PositionVertexBuffer.VertexPosition(SrcIdx));
+			DestVert.TangentX = FVector3f(Params.RebaseMatrix.TransformVector(FVector3f(StaticMeshVertexBuffer.VertexTangentX(SrcIdx))));
+			// keep the binormal sign in W
+			DestVert.TangentZ = FVector4f(FVector3f(Params.RebaseMatrix.TransformVector(FVector3f(TangentZ))), TangentZ.W);
+		}
+		else if constexpr (Rebase == EJrVertexRebase::Cooked)
+		{
+			DestVert.Position = Params.CookedLOD->Positions[SrcIdx];
+			DestVert.TangentX = Params.CookedLOD->TangentsX[SrcIdx];
+			DestVert.TangentZ = Params.CookedLOD->TangentsZ[SrcIdx];
+		}
+		else
+		{
+			DestVert.Position = PositionVertexBuffer.VertexPosition(SrcIdx);
+			DestVert.TangentX = StaticMeshVertexBuffer.VertexTangentX(SrcIdx);
+			DestVert.TangentZ = StaticMeshVertexBuffer.VertexTangentZ(SrcIdx);
+		}
+
+		for (uint32 UVIndex = 0; UVIndex < NumSourceUVs; UVIndex++)
+		{
+			const FVector2f UV = FVector2f(StaticMeshVertexBuffer.GetVertexUV_Typed<VertexDataType::StaticMeshVertexUVType>(SrcIdx, UVIndex));
+			if constexpr (bUVTransform)
+			{
+				const FVector2f* Transform = Params.UVTransforms[UVIndex];
+				DestVert.UVs[UVIndex] = Transform[0] * UV.X + Transform[1] * UV.Y + Transform[2];
+			}
+			else
+			{
+				DestVert.UVs[UVIndex] = UV;
+			}
+		}
+
+		// now just fill up zero value if we didn't reach till end
+		for (uint32 UVIndex = NumSourceUVs; UVIndex < VertexDataType::NumTexCoords; UVIndex++)
+		{
+			DestVert.UVs[UVIndex] = FVector2f::ZeroVector;
+		}
+	}
+}
+
+/** Vertices of a source section that are already in the merged space (first part, no UV transform, no index replacement). */
+struct FJrBulkVertexRange
+{
+	const FSkeletalMeshLODRenderData* SrcLODData = nullptr;
+	uint32 SrcVertex = 0;
+	uint32 DestVertex = 0;
+	uint32 NumVertices = 0;
+};
+
+/**
+* Copies the position, tangent and UV streams of a bulk vertex range into the merged LOD buffers.
+* The streams are copied with one memcpy each when the source and merged formats match, converted per vertex otherwise.
+*/
+static void CopyVertexStreams(const FJrBulkVertexRange& Range, FStaticMeshVertexBuffers& Dest, uint32 NumTexCoords, bool bUseBackwardsCompatibleF16TruncUVs)
+{
+	const FStaticMeshVertexBuffers& Src = Range.SrcLODData->StaticVertexBuffers;
+	FMemory::Memcpy(&Dest.PositionVertexBuffer.VertexPosition(Range.DestVertex), &Src.PositionVertexBuffer.VertexPosition(Range.SrcVertex), Range.NumVertices * sizeof(FVector3f));
+
+	const FStaticMeshVertexBuffer& SrcVertexBuffer = Src.StaticMeshVertexBuffer;
+	FStaticMeshVertexBuffer& DestVertexBuffer = Dest.StaticMeshVertexBuffer;
+	const uint32 NumSrcVertices = SrcVertexBuffer.GetNumVertices();
+
+	const bool bSameTangents = SrcVertexBuffer.GetUseHighPrecisionTangentBasis() == DestVertexBuffer.GetUseHighPrecisionTangentBasis();
+	if (bSameTangents)
+	{
+		const SIZE_T Stride = SrcVertexBuffer.GetTangentSize() / NumSrcVertices;
+		FMemory::Memcpy(static_cast<uint8*>(DestVertexBuffer.GetTangentData()) + Range.DestVertex * Stride,
+			static_cast<const uint8*>(SrcVertexBuffer.GetTangentData()) + Range.SrcVertex * Stride, Range.NumVertices * Stride);
+	}
+
+	const bool bSameUVs = SrcVertexBuffer.GetUseFullPrecisionUVs() == DestVertexBuffer.GetUseFullPrecisionUVs() && SrcVertexBuffer.GetNumTexCoords() == NumTexCoords;
+	if (bSameUVs)
+	{
+		const SIZE_T Stride = SrcVertexBuffer.GetTexCoordSize() / NumSrcVertices;
+		FMemory::Memcpy(static_cast<uint8*>(DestVertexBuffer.GetTexCoordData()) + Range.DestVertex * Stride,
+			static_cast<const uint8*>(SrcVertexBuffer.GetTexCoordData()) + Range.SrcVertex * Stride, Range.NumVertices * Stride);
+	}
+
+	if (bSameTangents && bSameUVs)
+	{
+		return;
 	}
 
-	// Copy all UVs that are available
-	uint32 LODNumTexCoords = SrcLODData.StaticVertexBuffers.StaticMeshVertexBuffer.GetNumTexCoords();
-	const uint32 ValidLoopCount = FMath::Min(VertexDataType::NumTexCoords, LODNumTexCoords);
-	for (uint32 UVIndex = 0; UVIndex < ValidLoopCount; ++UVIndex)
+	for (uint32 Idx = 0; Idx < Range.NumVertices; Idx++)
 	{
-		FVector2D UVs = FVector2D(SrcLODData.StaticVertexBuffers.StaticMeshVertexBuffer.GetVertexUV_Typed<VertexDataType::StaticMeshVertexUVType>(SourceVertIdx, UVIndex));
-		if (UVIndex < (uint32)MergeSectionInfo.UVTransforms.Num())
+		const uint32 SrcIdx = Range.SrcVertex + Idx;
+		const uint32 DestIdx = Range.DestVertex + Idx;
+		if (!bSameTangents)
 		{
-			FVector Transformed = MergeSectionInfo.UVTransforms[UVIndex].TransformPosition(FVector(UVs, 1.f));
-			UVs = FVector2D(Transformed.X, Transformed.Y);
+			DestVertexBuffer.SetVertexTangents(DestIdx, SrcVertexBuffer.VertexTangentX(SrcIdx), SrcVertexBuffer.VertexTangentY(SrcIdx), FVector3f(SrcVertexBuffer.VertexTangentZ(SrcIdx)));
+		}
+		if (!bSameUVs)
+		{
+			for (uint32 UVIndex = 0; UVIndex < NumTexCoords; UVIndex++)
+			{
+				const FVector2f UV = UVIndex < SrcVertexBuffer.GetNumTexCoords() ? SrcVertexBuffer.GetVertexUV(SrcIdx, UVIndex) : FVector2f::ZeroVector;
+				DestVertexBuffer.SetVertexUV(DestIdx, UVIndex, UV, bUseBackwardsCompatibleF16TruncUVs);
+			}
 		}
-		DestVert.UVs[UVIndex] = FVector2f(UVs);	// LWC_TODO: Precision loss
 	}
-	
-	// now just fill up zero value if we didn't reach till end
-	for (uint32 UVIndex = ValidLoopCount; UVIndex < VertexDataType::NumTexCoords; ++UVIndex)
+}
+
+/** Picks the CopyVerticesKernel specialization matching the section. */
+template<typename VertexDataType>
+static void CopyVerticesFromSource(VertexDataType* DestVerts, const FSkeletalMeshLODRenderData& SrcLODData, TArrayView<const uint32> SourceVertices, const FJrVertexCopyParams& Params)
+{
+	auto CopyWithUVs = [&](auto NumSourceUVsConstant)
+	{
+		constexpr uint32 NumSourceUVs = decltype(NumSourceUVsConstant)::Value;
+		switch (Params.Rebase)
+		{
+		case EJrVertexRebase::Transform:
+			Params.bUVTransform ?
+				CopyVerticesKernel<VertexDataType, NumSourceUVs, EJrVertexRebase::Transform, true>(DestVerts, SrcLODData, SourceVertices, Params) :
+				CopyVerticesKernel<VertexDataType, NumSourceUVs, EJrVertexRebase::Transform, false>(DestVerts, SrcLODData, SourceVertices, Params);
+			break;
+		case EJrVertexRebase::Cooked:
+			Params.bUVTransform ?
+				CopyVerticesKernel<VertexDataType, NumSourceUVs, EJrVertexRebase::Cooked, true>(DestVerts, SrcLODData, SourceVertices, Params) :
+				CopyVerticesKernel<VertexDataType, NumSourceUVs, EJrVertexRebase::Cooked, false>(DestVerts, SrcLODData, SourceVertices, Params);
+			break;
+		default:
+			Params.bUVTransform ?
+				CopyVerticesKernel<VertexDataType, NumSourceUVs, EJrVertexRebase::None, true>(DestVerts, SrcLODData, SourceVertices, Params) :
+				CopyVerticesKernel<VertexDataType, NumSourceUVs, EJrVertexRebase::None, false>(DestVerts, SrcLODData, SourceVertices, Params);
+			break;
+		}
+	};
+
+	// the vertex format has room for the UVs of every source, only fewer UVs than the format need their own kernel
+	switch (FMath::Min<uint32>(Params.NumSourceUVs, VertexDataType::NumTexCoords))
 	{
-		DestVert.UVs[UVIndex] = FVector2f::ZeroVector;
+	case 0:
+		CopyWithUVs(TIntegralConstant<uint32, 0>());
+		break;
+	case 1:
+		CopyWithUVs(TIntegralConstant<uint32, FMath::Min<uint32>(1, VertexDataType::NumTexCoords)>());
+		break;
+	case 2:
+		CopyWithUVs(TIntegralConstant<uint32, FMath::Min<uint32>(2, VertexDataType::NumTexCoords)>());
+		break;
+	case 3:
+		CopyWithUVs(TIntegralConstant<uint32, FMath::Min<uint32>(3, VertexDataType::NumTexCoords)>());
+		break;
+	default:
+		CopyWithUVs(TIntegralConstant<uint32, VertexDataType::NumTexCoords>());
+		break;
 	}
 }
 
@@ -493,7 +967,19 @@ void FJrSkeletalMeshMerge::GenerateLODModel( int32 LODIdx )
 	TArray<FNewSectionInfo> NewSectionArray;
 	GenerateNewSectionArray( NewSectionArray, LODIdx );
 
+	// parts sharing their vertices between consecutive LODs (index-only LODs, parts clamped to their last LOD):
+	// when every part does, the merged vertices are the ones of the previous merged LOD and are copied from it.
+	// This only skips the per-vertex rebuild: engine LODs own their buffers, each LOD keeps its own copy.
+	TArray<uint64> VertexLayout = GetLODVertexLayout(LODIdx, NewSectionArray);
+	const int32 MergedLODIdx = LODIdx - StripTopLODs;
+	const bool bShareVertices = MergedLODIdx > 0 && VertexLayout.Num() > 0 && VertexLayout == PreviousLODVertexLayout;
+	const FSkeletalMeshLODRenderData* SharedLODData = bShareVertices ? &MergeResource->LODRenderData[MergedLODIdx - 1] : nullptr;
+	PreviousLODVertexLayout = MoveTemp(VertexLayout);
+
 	uint32 MaxIndex = 0;
+	int32 NumMergedVertices = 0;
+	// sections whose vertices are not in MergedVertexBuffer but copied stream by stream
+	TArray<FJrBulkVertexRange> BulkVertexRanges;
 
 	// merged vertex buffer
 	TArray< VertexDataType > MergedVertexBuffer;
@@ -509,6 +995,8 @@ void FJrSkeletalMeshMerge::GenerateLODModel( int32 LODIdx )
 
 	uint32 SourceMaxBoneInfluences = 0;
 	bool bSourceUse16BitBoneIndex = false;
+	uint32 SourceMinBoneInfluences = MAX_uint32;
+	bool bSourceVariableBonesPerVertex = false;
 
 	for( int32 CreateIdx=0; CreateIdx < NewSectionArray.Num(); CreateIdx++ )
 	{
@@ -532,7 +1020,7 @@ void FJrSkeletalMeshMerge::GenerateLODModel( int32 LODIdx )
 		Section.NumVertices = 0;
 
 		// keep track of the current base vertex for this section in the merged vertex buffer
-		Section.BaseVertexIndex = MergedVertexBuffer.Num();
+		Section.BaseVertexIndex = NumMergedVertices;
 
 		// find existing material index
 		check(MergeMesh->GetMaterials().Num() == MaterialIds.Num());
@@ -591,10 +1079,18 @@ void FJrSkeletalMeshMerge::GenerateLODModel( int32 LODIdx )
 			const FSkeletalMeshLODInfo& SrcLODInfo = *(MergeSectionInfo.SkelMesh->GetLODInfo(SourceLODIdx));
 
 			// keep track of the lowest LOD displayfactor and hysteresis
-			MergeLODInfo.ScreenSize.Default = FMath::Min<float>(MergeLODInfo.ScreenSize.Default, SrcLODInfo.ScreenSize.Default);
+			// (synthesized LODs carry their own screen size since the source has no LOD info for them)
+			const bool bHasOverrideScreenSize = MergeSectionInfo.OverrideScreenSize >= 0.f;
+			const float SrcScreenSize = bHasOverrideScreenSize ? MergeSectionInfo.OverrideScreenSize : SrcLODInfo.ScreenSize.Default;
+			MergeLODInfo.ScreenSize.Default = FMath::Min<float>(MergeLODInfo.ScreenSize.Default, SrcScreenSize);
 #if WITH_EDITORONLY_DATA
 			for(const TPair<FName, float>& PerPlatform : SrcLODInfo.ScreenSize.PerPlatform)
 			{
+				if (bHasOverrideScreenSize)
+				{
+					break;
+				}
+
 				float* Value = MergeLODInfo.ScreenSize.PerPlatform.Find(PerPlatform.Key);
 				if(Value)
 				{
@@ -618,7 +1114,7 @@ void FJrSkeletalMeshMerge::GenerateLODModel( int32 LODIdx )
 			// add required bones from this source model entry to the merge model entry
 			for( int32 Idx=0; Idx < SrcLODData.RequiredBones.Num(); Idx++ )
 			{
-				FName SrcLODBoneName = MergeSectionInfo.SkelMesh->GetRefSkeleton().GetBoneName(SrcLODData.RequiredBones[Idx] );
+				FName SrcLODBoneName = GetSourceBoneName(MergeSectionInfo.SkelMesh, SrcLODData.RequiredBones[Idx]);
 				int32 MergeBoneIndex = NewRefSkeleton.FindBoneIndex(SrcLODBoneName);
 				
 				if (MergeBoneIndex != INDEX_NONE)
@@ -627,9 +1123,6 @@ void FJrSkeletalMeshMerge::GenerateLODModel( int32 LODIdx )
 				}
 			}
 
-			// update vert total
-			Section.NumVertices += MergeSectionInfo.Section->NumVertices;
-
 			// update total number of vertices 
 			const int32 NumTotalVertices = MergeSectionInfo.Section->NumVertices;
 
@@ -639,14 +1132,64 @@ void FJrSkeletalMeshMerge::GenerateLODModel( int32 LODIdx )
 				SrcLODData.StaticVertexBuffers.PositionVertexBuffer.GetNumVertices()
 				);
 
-			const int32 MaxColorIdx = SrcLODData.StaticVertexBuffers.ColorVertexBuffer.GetNumVertices();
+			// indices replacing the source section ones: reduced indices of a synthesized LOD
+			// and / or the triangles left by the part mask rules
+			const TArray<uint32>* SectionIndices = MergeSectionInfo.OverrideIndices;
+			TArray<uint32> MaskedIndices;
+			if (MergeOptions.PartMaskRules.Num() > 0)
+			{
+				TArray<uint32> SourceIndices;
+				if (!SectionIndices)
+				{
+					const FRawStaticIndexBuffer16or32Interface* SrcIndexBuffer = SrcLODData.MultiSizeIndexContainer.GetIndexBuffer();
+					const int32 MaxIndexIdx = FMath::Min<int32>(MergeSectionInfo.Section->BaseIndex + MergeSectionInfo.Section->NumTriangles * 3, SrcIndexBuffer->Num());
+					SourceIndices.Reserve(MaxIndexIdx - MergeSectionInfo.Section->BaseIndex);
+					for (int32 IndexIdx = MergeSectionInfo.Section->BaseIndex; IndexIdx < MaxIndexIdx; IndexIdx++)
+					{
+						SourceIndices.Add(SrcIndexBuffer->Get(IndexIdx));
+					}
+				}
+
+				if (MaskCoveredTriangles(MergeSectionInfo, LODIdx, SectionIndices ? *SectionIndices : SourceIndices, MaskedIndices))
+				{
+					SectionIndices = &MaskedIndices;
+				}
+			}
+
+			// a replaced index list only references part of the section vertices,
+			// map the referenced ones to their compacted offset and skip the others
+			TArray<int32> SrcToCompactedVertex;
+			int32 NumCompactedVertices = 0;
+			if (SectionIndices)
+			{
+				SrcToCompactedVertex.Init(INDEX_NONE, NumTotalVertices);
+				for (const uint32 SrcIndex : *SectionIndices)
+				{
+					checkSlow(SrcIndex >= MergeSectionInfo.Section->BaseVertexIndex);
+					SrcToCompactedVertex[SrcIndex - MergeSectionInfo.Section->BaseVertexIndex] = 0;
+				}
+				for (int32& CompactedVertex : SrcToCompactedVertex)
+				{
+					if (CompactedVertex != INDEX_NONE)
+					{
+						CompactedVertex = NumCompactedVertices++;
+					}
+				}
+			}
+
+			// update vert total
+			Section.NumVertices += SectionIndices ? NumCompactedVertices : MergeSectionInfo.Section->NumVertices;
+
+			const int32 MaxColorIdx = SrcLODData.StaticVertexBuffers.ColorVertexBuffer.GetNumVertices();
 
 			// update max number of influences
 			const uint32 MaxBoneInfluences = SrcLODData.GetSkinWeightVertexBuffer()->GetMaxBoneInfluences();
 			const bool bUse16BitBoneIndex = SrcLODData.GetSkinWeightVertexBuffer()->Use16BitBoneIndex();
 
 			SourceMaxBoneInfluences = FMath::Max(SourceMaxBoneInfluences, MaxBoneInfluences);
+			SourceMinBoneInfluences = FMath::Min(SourceMinBoneInfluences, MaxBoneInfluences);
 			bSourceUse16BitBoneIndex |= bUse16BitBoneIndex;
+			bSourceVariableBonesPerVertex |= SrcLODData.GetSkinWeightVertexBuffer()->GetVariableBonesPerVertex();
 
 			// update RenderSection number of max influences
 			Section.MaxBoneInfluences = MaxBoneInfluences;
@@ -660,72 +1203,140 @@ void FJrSkeletalMeshMerge::GenerateLODModel( int32 LODIdx )
 
 			// keep track of the current base vertex index before adding any new vertices
 			// this will be needed to remap the index buffer values to the new range
-			const int32 CurrentBaseVertexIndex = MergedVertexBuffer.Num();
+			const int32 CurrentBaseVertexIndex = NumMergedVertices;
+
+			// record where the LOD 0 vertices come from, for the merge validator
+			const bool bRecordProvenance = MergeOptions.bRecordVertexProvenance && LODIdx == StripTopLODs;
+			const int32 SrcMeshIdx = bRecordProvenance ? SrcMeshList.IndexOfByKey(MergeSectionInfo.SkelMesh) : INDEX_NONE;
 			
-			for( int32 VertIdx=MergeSectionInfo.Section->BaseVertexIndex; VertIdx < MaxVertIdx; VertIdx++ )
+			// source vertices copied for this section: all of them, or the ones the replaced indices reference
+			TArray<uint32> SourceVertices;
+			SourceVertices.Reserve(MaxVertIdx - MergeSectionInfo.Section->BaseVertexIndex);
+			for (int32 VertIdx = MergeSectionInfo.Section->BaseVertexIndex; VertIdx < MaxVertIdx; VertIdx++)
 			{
-				// add the new vertex
-				VertexDataType& DestVert = MergedVertexBuffer[MergedVertexBuffer.AddUninitialized()];
-				FSkinWeightInfo& DestWeight = MergedSkinWeightBuffer[MergedSkinWeightBuffer.AddUninitialized()];
-
-				CopyVertexFromSource<VertexDataType>(DestVert, SrcLODData, VertIdx, MergeSectionInfo);
+				if (SrcToCompactedVertex.Num() == 0 || SrcToCompactedVertex[VertIdx - MergeSectionInfo.Section->BaseVertexIndex] != INDEX_NONE)
+				{
+					SourceVertices.Add(VertIdx);
+				}
+			}
 
-				DestWeight = SrcLODData.GetSkinWeightVertexBuffer()->GetVertexSkinWeights(VertIdx);
+			NumMergedVertices += SourceVertices.Num();
+			if (!bShareVertices)
+			{
+				// add the new vertices, the copy kernel is picked once for the whole section
+				FJrVertexCopyParams CopyParams;
+				MakeVertexCopyParams(SrcLODData, SourceLODIdx, MergeSectionInfo, CopyParams);
+				const int32 FirstDestVertex = MergedVertexBuffer.AddUninitialized(SourceVertices.Num());
+				if (!SectionIndices && CopyParams.Rebase == EJrVertexRebase::None && !CopyParams.bUVTransform)
+				{
+					// the part is already in the merged space: its streams are copied as they are once the LOD buffers exist
+					FJrBulkVertexRange& BulkRange = BulkVertexRanges.AddDefaulted_GetRef();
+					BulkRange.SrcLODData = &SrcLODData;
+					BulkRange.SrcVertex = MergeSectionInfo.Section->BaseVertexIndex;
+					BulkRange.DestVertex = FirstDestVertex;
+					BulkRange.NumVertices = SourceVertices.Num();
+				}
+				else
+				{
+					CopyVerticesFromSource(MergedVertexBuffer.GetData() + FirstDestVertex, SrcLODData, SourceVertices, CopyParams);
+				}
 
-				// if the mesh uses vertex colors, copy the source color if possible or default to white
-				if( MergeMesh->GetHasVertexColors() )
+				if (bRecordProvenance)
 				{
-					if( VertIdx < MaxColorIdx )
+					for (const uint32 SrcVertex : SourceVertices)
 					{
-						const FColor& SrcColor = SrcLODData.StaticVertexBuffers.ColorVertexBuffer.VertexColor(VertIdx);
-						MergedColorBuffer.Add(SrcColor);
+						VertexProvenance.Add(FIntPoint(SrcMeshIdx, SrcVertex));
 					}
-					else
+				}
+
+				// copy the skin weights and remap the bone index used by each vertex to match the mergedbonemap
+				// (nothing to remap when the section bone map is the start of the merged one)
+				const FSkinWeightVertexBuffer& SrcSkinWeights = *SrcLODData.GetSkinWeightVertexBuffer();
+				const int32 FirstDestWeight = MergedSkinWeightBuffer.AddUninitialized(SourceVertices.Num());
+				bool bIdentityBoneMap = true;
+				for (int32 BoneIdx = 0; BoneIdx < MergeSectionInfo.BoneMapToMergedBoneMap.Num() && bIdentityBoneMap; BoneIdx++)
+				{
+					bIdentityBoneMap = MergeSectionInfo.BoneMapToMergedBoneMap[BoneIdx] == BoneIdx;
+				}
+				const uint32 NumRemappedInfluences = bIdentityBoneMap ? 0 : MaxBoneInfluences;
+				for (int32 Idx = 0; Idx < SourceVertices.Num(); Idx++)
+				{
+					FSkinWeightInfo& DestWeight = MergedSkinWeightBuffer[FirstDestWeight + Idx];
+					DestWeight = SrcSkinWeights.GetVertexSkinWeights(SourceVertices[Idx]);
+					for (uint32 Influence = 0; Influence < NumRemappedInfluences; Influence++)
 					{
-						const FColor ColorWhite(255, 255, 255);
-						MergedColorBuffer.Add(ColorWhite);
+						if (DestWeight.InfluenceWeights[Influence] > 0)
+						{
+							checkSlow(MergeSectionInfo.BoneMapToMergedBoneMap.IsValidIndex(DestWeight.InfluenceBones[Influence]));
+							DestWeight.InfluenceBones[Influence] = (FBoneIndexType)MergeSectionInfo.BoneMapToMergedBoneMap[DestWeight.InfluenceBones[Influence]];
+						}
 					}
 				}
 
-				// remap the bone index used by this vertex to match the mergedbonemap 
-				for( uint32 Idx=0; Idx < MAX_TOTAL_INFLUENCES; Idx++ )
+				// if the mesh uses vertex colors, copy the source color if possible or default to white
+				if (MergeMesh->GetHasVertexColors())
 				{
-					if (DestWeight.InfluenceWeights[Idx] > 0)
+					if (!SectionIndices && MaxVertIdx <= MaxColorIdx)
+					{
+						MergedColorBuffer.Append(&SrcLODData.StaticVertexBuffers.ColorVertexBuffer.VertexColor(MergeSectionInfo.Section->BaseVertexIndex), SourceVertices.Num());
+					}
+					else
 					{
-						checkSlow(MergeSectionInfo.BoneMapToMergedBoneMap.IsValidIndex(DestWeight.InfluenceBones[Idx]));
-						DestWeight.InfluenceBones[Idx] = (FBoneIndexType)MergeSectionInfo.BoneMapToMergedBoneMap[DestWeight.InfluenceBones[Idx]];
+						for (const uint32 SrcVertex : SourceVertices)
+						{
+							MergedColorBuffer.Add((int32)SrcVertex < MaxColorIdx ? SrcLODData.StaticVertexBuffers.ColorVertexBuffer.VertexColor(SrcVertex) : FColor::White);
+						}
 					}
 				}
 			}
 
-			// update total number of triangles
-			Section.NumTriangles += MergeSectionInfo.Section->NumTriangles;
-
-			// add the indices from the original source mesh to the merged index buffer					
-			const int32 MaxIndexIdx = FMath::Min<int32>( 
-				MergeSectionInfo.Section->BaseIndex + MergeSectionInfo.Section->NumTriangles * 3, 
-				SrcLODData.MultiSizeIndexContainer.GetIndexBuffer()->Num()
-				);
-            for (int32 IndexIdx = MergeSectionInfo.Section->BaseIndex; IndexIdx < MaxIndexIdx; IndexIdx++)
-            {
-                uint32 SrcIndex = SrcLODData.MultiSizeIndexContainer.GetIndexBuffer()->Get(IndexIdx);
+			if (SectionIndices)
+			{
+				// update total number of triangles
+				Section.NumTriangles += SectionIndices->Num() / 3;
 
-                // add offset to each index to match the new entries in the merged vertex buffer
-                checkSlow(SrcIndex >= MergeSectionInfo.Section->BaseVertexIndex);
-                uint32 DstIndex = SrcIndex - MergeSectionInfo.Section->BaseVertexIndex + CurrentBaseVertexIndex;
-                checkSlow(DstIndex < (uint32)MergedVertexBuffer.Num());
+				// add the replaced indices, remapped to the compacted vertices
+				for (const uint32 SrcIndex : *SectionIndices)
+				{
+					const uint32 DstIndex = SrcToCompactedVertex[SrcIndex - MergeSectionInfo.Section->BaseVertexIndex] + CurrentBaseVertexIndex;
+					checkSlow(DstIndex < (uint32)NumMergedVertices);
 
-                // add the new index to the merged vertex buffer
-                MergedIndexBuffer.Add(DstIndex);
-                if (MaxIndex < DstIndex)
+					MergedIndexBuffer.Add(DstIndex);
+					MaxIndex = FMath::Max(MaxIndex, DstIndex);
+				}
+			}
+			else
+			{
+				// update total number of triangles
+				Section.NumTriangles += MergeSectionInfo.Section->NumTriangles;
+
+				// add the indices from the original source mesh to the merged index buffer					
+				const int32 MaxIndexIdx = FMath::Min<int32>( 
+					MergeSectionInfo.Section->BaseIndex + MergeSectionInfo.Section->NumTriangles * 3, 
+					SrcLODData.MultiSizeIndexContainer.GetIndexBuffer()->Num()
+					);
+                for (int32 IndexIdx = MergeSectionInfo.Section->BaseIndex; IndexIdx < MaxIndexIdx; IndexIdx++)
                 {
-                    MaxIndex = DstIndex;
-                }
+                    uint32 SrcIndex = SrcLODData.MultiSizeIndexContainer.GetIndexBuffer()->Get(IndexIdx);
 
-            }
+                    // add offset to each index to match the new entries in the merged vertex buffer
+                    checkSlow(SrcIndex >= MergeSectionInfo.Section->BaseVertexIndex);
+                    uint32 DstIndex = SrcIndex - MergeSectionInfo.Section->BaseVertexIndex + CurrentBaseVertexIndex;
+                    checkSlow(DstIndex < (uint32)NumMergedVertices);
+
+                    // add the new index to the merged vertex buffer
+                    MergedIndexBuffer.Add(DstIndex);
+                    if (MaxIndex < DstIndex)
+                    {
+                        MaxIndex = DstIndex;
+                    }
+
+                }
+			}
 
             {
-                if (MergeSectionInfo.Section->DuplicatedVerticesBuffer.bHasOverlappingVertices)
+                // the overlapping vertex data of the source references vertices dropped by a replaced index list, don't carry it over
+                if (MergeSectionInfo.Section->DuplicatedVerticesBuffer.bHasOverlappingVertices && !SectionIndices)
                 {
                     if (Section.DuplicatedVerticesBuffer.bHasOverlappingVertices)
                     {
@@ -773,122 +1384,1336 @@ void FJrSkeletalMeshMerge::GenerateLODModel( int32 LODIdx )
 		}
 	}
 
-    const bool bNeedsCPUAccess = (MeshBufferAccess == EMeshBufferAccess::ForceCPUAndGPU) ||
-                                    MergeResource->RequiresCPUSkinning(GMaxRHIFeatureLevel);
+    const bool bNeedsCPUAccess = (MeshBufferAccess == EMeshBufferAccess::ForceCPUAndGPU) ||
+                                    MergeResource->RequiresCPUSkinning(GMaxRHIFeatureLevel);
+	const bool bPositionsCPUAccess = bNeedsCPUAccess || EnumHasAnyFlags((EJrCPUAccessStream)MergeOptions.CPUAccessStreams, EJrCPUAccessStream::Positions);
+	const bool bTangentsCPUAccess = bNeedsCPUAccess || EnumHasAnyFlags((EJrCPUAccessStream)MergeOptions.CPUAccessStreams, EJrCPUAccessStream::TangentsAndUVs);
+	const bool bSkinWeightsCPUAccess = bNeedsCPUAccess || EnumHasAnyFlags((EJrCPUAccessStream)MergeOptions.CPUAccessStreams, EJrCPUAccessStream::SkinWeights);
+	const bool bColorsCPUAccess = bNeedsCPUAccess || EnumHasAnyFlags((EJrCPUAccessStream)MergeOptions.CPUAccessStreams, EJrCPUAccessStream::Colors);
+
+	ReduceLODBones(LODIdx - StripTopLODs, MergeLODData, MergedSkinWeightBuffer);
+
+	// sort required bone array in strictly increasing order
+	MergeLODData.RequiredBones.Sort();
+	MergeMesh->GetRefSkeleton().EnsureParentsExistAndSort(MergeLODData.ActiveBoneIndices);
+	
+	bool bVariableBonesPerVertex = false;
+	if (SharedLODData)
+	{
+		// same vertices as the previous merged LOD, copied buffer by buffer, only the sections and indices are built for this LOD
+		MergeLODData.StaticVertexBuffers.PositionVertexBuffer.Init(SharedLODData->StaticVertexBuffers.PositionVertexBuffer, bPositionsCPUAccess);
+		MergeLODData.StaticVertexBuffers.StaticMeshVertexBuffer.Init(SharedLODData->StaticVertexBuffers.StaticMeshVertexBuffer, bTangentsCPUAccess);
+		MergeLODData.SkinWeightVertexBuffer = SharedLODData->SkinWeightVertexBuffer;
+		MergeLODData.SkinWeightVertexBuffer.SetNeedsCPUAccess(bSkinWeightsCPUAccess);
+		if (MergeMesh->GetHasVertexColors())
+		{
+			MergeLODData.StaticVertexBuffers.ColorVertexBuffer.Init(SharedLODData->StaticVertexBuffers.ColorVertexBuffer, bColorsCPUAccess);
+		}
+		bVariableBonesPerVertex = SharedLODData->SkinWeightVertexBuffer.GetVariableBonesPerVertex();
+	}
+	else
+	{
+		// copy the new vertices and indices to the vertex buffer for the new model
+		MergeLODData.StaticVertexBuffers.StaticMeshVertexBuffer.SetUseFullPrecisionUVs(MergeLODInfo.BuildSettings.bUseFullPrecisionUVs);
+
+		MergeLODData.StaticVertexBuffers.PositionVertexBuffer.Init(MergedVertexBuffer.Num(), bPositionsCPUAccess);
+		MergeLODData.StaticVertexBuffers.StaticMeshVertexBuffer.Init(MergedVertexBuffer.Num(), TotalNumUVs, bTangentsCPUAccess);
+
+		bool bUseBackwardsCompatibleF16TruncUVs = MergeLODInfo.BuildSettings.bUseBackwardsCompatibleF16TruncUVs;
+
+		int32 NextVertex = 0;
+		auto CopyMergedVertices = [&](int32 EndVertex)
+		{
+			for (int i = NextVertex; i < EndVertex; i++)
+			{
+				MergeLODData.StaticVertexBuffers.PositionVertexBuffer.VertexPosition(i) = MergedVertexBuffer[i].Position;
+				MergeLODData.StaticVertexBuffers.StaticMeshVertexBuffer.SetVertexTangents(i, MergedVertexBuffer[i].TangentX.ToFVector3f(), MergedVertexBuffer[i].GetTangentY(), MergedVertexBuffer[i].TangentZ.ToFVector3f());
+				for (uint32 j = 0; j < TotalNumUVs; j++)
+				{
+					MergeLODData.StaticVertexBuffers.StaticMeshVertexBuffer.SetVertexUV(i, j, MergedVertexBuffer[i].UVs[j], bUseBackwardsCompatibleF16TruncUVs);
+				}
+			}
+		};
+		for (const FJrBulkVertexRange& BulkRange : BulkVertexRanges)
+		{
+			CopyMergedVertices(BulkRange.DestVertex);
+			CopyVertexStreams(BulkRange, MergeLODData.StaticVertexBuffers, TotalNumUVs, bUseBackwardsCompatibleF16TruncUVs);
+			NextVertex = BulkRange.DestVertex + BulkRange.NumVertices;
+		}
+		CopyMergedVertices(MergedVertexBuffer.Num());
+
+		// parts with fewer influences than the largest one (e.g. a body merged with a face rig) only store their own influences
+		switch (MergeOptions.BoneInfluenceMode)
+		{
+		case EJrBoneInfluenceMode::Variable:
+			// the variable layout is only read through the unlimited bone influences vertex factory
+			bVariableBonesPerVertex = FGPUBaseSkinVertexFactory::GetUnlimitedBoneInfluences();
+			UE_CLOG(!bVariableBonesPerVertex, LogSkeletalMesh, Warning, TEXT("LOD %d: variable bone influences need unlimited bone influences (r.GPUSkin.UnlimitedBoneInfluences), using fixed influences"), MergedLODIdx);
+			break;
+		case EJrBoneInfluenceMode::Auto:
+			bVariableBonesPerVertex = (bSourceVariableBonesPerVertex || SourceMinBoneInfluences < SourceMaxBoneInfluences) &&
+				FGPUBaseSkinVertexFactory::UseUnlimitedBoneInfluences(SourceMaxBoneInfluences);
+			break;
+		default:
+			break;
+		}
+
+		if (bVariableBonesPerVertex)
+		{
+			// the variable layout stores the leading non-zero influences of each vertex, move them to the front
+			for (FSkinWeightInfo& Weights : MergedSkinWeightBuffer)
+			{
+				int32 NumInfluences = 0;
+				for (int32 Influence = 0; Influence < MAX_TOTAL_INFLUENCES; Influence++)
+				{
+					if (Weights.InfluenceWeights[Influence] > 0)
+					{
+						Weights.InfluenceBones[NumInfluences] = Weights.InfluenceBones[Influence];
+						Weights.InfluenceWeights[NumInfluences] = Weights.InfluenceWeights[Influence];
+						NumInfluences++;
+					}
+				}
+				for (int32 Influence = NumInfluences; Influence < MAX_TOTAL_INFLUENCES; Influence++)
+				{
+					Weights.InfluenceBones[Influence] = 0;
+					Weights.InfluenceWeights[Influence] = 0;
+				}
+			}
+		}
+
+		MergeLODData.SkinWeightVertexBuffer.SetVariableBonesPerVertex(bVariableBonesPerVertex);
+		MergeLODData.SkinWeightVertexBuffer.SetMaxBoneInfluences(SourceMaxBoneInfluences);
+		MergeLODData.SkinWeightVertexBuffer.SetUse16BitBoneIndex(bSourceUse16BitBoneIndex);
+		MergeLODData.SkinWeightVertexBuffer.SetNeedsCPUAccess(bSkinWeightsCPUAccess);
+
+		// copy vertex resource arrays
+		MergeLODData.SkinWeightVertexBuffer = MergedSkinWeightBuffer;
+
+		if( MergeMesh->GetHasVertexColors() )
+		{
+			MergeLODData.StaticVertexBuffers.ColorVertexBuffer.InitFromColorArray(MergedColorBuffer.GetData(), MergedColorBuffer.Num(), sizeof(FColor), bColorsCPUAccess);
+		}
+	}
+
+	// The skeletal mesh proxy draws every section from vertex 0 (absolute indices, no per section base vertex),
+	// so the LOD vertex range decides the width: 16 bit as long as the last vertex is indexable.
+	const bool bUse32BitIndices = MaxIndex > MAX_uint16;
+	const uint8 DataTypeSize = bUse32BitIndices ? sizeof(uint32) : sizeof(uint16);
+	MergeLODData.MultiSizeIndexContainer.RebuildIndexBuffer(DataTypeSize, MergedIndexBuffer);
+	if (bUse32BitIndices)
+	{
+		UE_LOG(LogSkeletalMesh, Log, TEXT("FJrSkeletalMeshMerge: merged LOD %d has %d vertices and uses 32 bit indices, see UJrSkeletalMergingLibrary::MergeMeshesWithinBudget to stay within 16 bit."),
+			LODIdx - StripTopLODs, NumMergedVertices);
+	}
+
+	// the source densities don't account for the UV transforms, and streaming uses the densities of LOD 0 only
+	if (MergeOptions.bRecomputeUVDensities && LODIdx == StripTopLODs)
+	{
+		ComputeUVDensities(MergeLODData, MergedIndexBuffer);
+	}
+
+	FJrLODMergeStats& LODStats = Report.LODs.AddDefaulted_GetRef();
+	LODStats.LODIndex = LODIdx - StripTopLODs;
+	LODStats.InputSections = CountInputSections(LODIdx);
+	LODStats.OutputSections = MergeLODData.RenderSections.Num();
+	LODStats.DrawCallsSaved = LODStats.InputSections - LODStats.OutputSections;
+	LODStats.Vertices = NumMergedVertices;
+	LODStats.Triangles = MergedIndexBuffer.Num() / 3;
+	LODStats.ActiveBones = MergeLODData.ActiveBoneIndices.Num();
+	LODStats.RequiredBones = MergeLODData.RequiredBones.Num();
+	LODStats.MaxBoneInfluences = SourceMaxBoneInfluences;
+	LODStats.bVariableBoneInfluences = bVariableBonesPerVertex;
+	LODStats.VerticesSharedWithLOD = bShareVertices ? MergedLODIdx - 1 : INDEX_NONE;
+	LODStats.b32BitIndices = bUse32BitIndices;
+	for (const FJrBulkVertexRange& BulkRange : BulkVertexRanges)
+	{
+		LODStats.BulkCopiedVertices += BulkRange.NumVertices;
+	}
+	if (MergeOptions.bMeasurePositionErrors)
+	{
+		MeasurePositionErrors(MergeLODData, LODStats);
+	}
+	LODStats.BufferBytes = MergeLODData.GetResourceSizeBytes();
+
+	const FStaticMeshVertexBuffers& StaticVertexBuffers = MergeLODData.StaticVertexBuffers;
+	LODStats.CPUAccessBytes = (int64)MergeLODData.MultiSizeIndexContainer.GetIndexBuffer()->GetResourceDataSize()
+		+ (bPositionsCPUAccess ? (int64)StaticVertexBuffers.PositionVertexBuffer.GetNumVertices() * StaticVertexBuffers.PositionVertexBuffer.GetStride() : 0)
+		+ (bTangentsCPUAccess ? (int64)StaticVertexBuffers.StaticMeshVertexBuffer.GetResourceSize() : 0)
+		+ (bSkinWeightsCPUAccess ? (int64)MergeLODData.SkinWeightVertexBuffer.GetVertexDataSize() : 0)
+		+ (bColorsCPUAccess ? (int64)StaticVertexBuffers.ColorVertexBuffer.GetNumVertices() * StaticVertexBuffers.ColorVertexBuffer.GetStride() : 0);
+}
+
+uint64 FJrSkeletalMeshMerge::GetSourceLODVertexHash(const USkeletalMesh* SkelMesh, int32 SourceLODIdx)
+{
+	const TPair<const USkeletalMesh*, int32> Key(SkelMesh, SourceLODIdx);
+	if (const uint64* Hash = SourceLODVertexHashes.Find(Key))
+	{
+		return *Hash;
+	}
+
+	const uint64 Hash = FJrPartCooker::HashLODVertices(SkelMesh->GetResourceForRendering()->LODRenderData[SourceLODIdx]);
+	SourceLODVertexHashes.Add(Key, Hash);
+	return Hash;
+}
+
+const FJrCookedPartLOD* FJrSkeletalMeshMerge::FindCookedLOD(const USkeletalMesh* SkelMesh, int32 SourceLODIdx)
+{
+	const int32 MeshIdx = SrcMeshList.IndexOfByKey(SkelMesh);
+	const UJrCookedPartUserData* CookedPart = SrcMeshInfo.IsValidIndex(MeshIdx) ? SrcMeshInfo[MeshIdx].CookedPart : nullptr;
+	if (!CookedPart || !CookedPart->LODs.IsValidIndex(SourceLODIdx))
+	{
+		return nullptr;
+	}
+
+	// a LOD reimported or rebuilt since the part was cooked is merged the regular way, checked without reading its vertices
+	const FJrCookedPartLOD& CookedLOD = CookedPart->LODs[SourceLODIdx];
+	return CookedLOD.LODKey != 0 && CookedLOD.LODKey == FJrPartCooker::MakeLODKey(SkelMesh, SourceLODIdx) ? &CookedLOD : nullptr;
+}
+
+TArray<uint64> FJrSkeletalMeshMerge::GetLODVertexLayout(int32 LODIdx, const TArray<FNewSectionInfo>& NewSectionInfos)
+{
+	TArray<uint64> Layout;
+
+	// masking and bone reduction rewrite the vertices per LOD
+	const int32 MergedLODIdx = LODIdx - StripTopLODs;
+	if (MergeOptions.PartMaskRules.Num() > 0 ||
+		MergeOptions.LODBoneReductions.ContainsByPredicate([MergedLODIdx](const FJrLODBoneReduction& Reduction) { return Reduction.LODIndex <= MergedLODIdx; }))
+	{
+		return Layout;
+	}
+
+	for (const FNewSectionInfo& NewSectionInfo : NewSectionInfos)
+	{
+		Layout.Add(MAX_uint64);
+		for (const FMergeSectionInfo& MergeSectionInfo : NewSectionInfo.MergeSections)
+		{
+			// synthesized LODs only reference part of their base LOD vertices
+			if (MergeSectionInfo.OverrideIndices)
+			{
+				return TArray<uint64>();
+			}
+
+			const int32 SourceLODIdx = FMath::Min(LODIdx, MergeSectionInfo.SkelMesh->GetResourceForRendering()->LODRenderData.Num() - 1);
+			const uint64 VertexHash = GetSourceLODVertexHash(MergeSectionInfo.SkelMesh, SourceLODIdx);
+			if (VertexHash == 0)
+			{
+				return TArray<uint64>();
+			}
+
+			const TArray<FBoneIndexType>& BoneMap = MergeSectionInfo.Section->BoneMap;
+			Layout.Add((uint64)(UPTRINT)MergeSectionInfo.SkelMesh);
+			Layout.Add(VertexHash);
+			Layout.Add(((uint64)MergeSectionInfo.Section->BaseVertexIndex << 32) | MergeSectionInfo.Section->NumVertices);
+			Layout.Add(CityHash64(reinterpret_cast<const char*>(BoneMap.GetData()), BoneMap.Num() * sizeof(FBoneIndexType)));
+		}
+	}
+	return Layout;
+}
+
+void FJrSkeletalMeshMerge::ComputeUVDensities(const FSkeletalMeshLODRenderData& LODData, const TArray<uint32>& Indices)
+{
+	struct FTriangleDensity
+	{
+		float Density;
+		float Weight;
+	};
+
+	const FPositionVertexBuffer& PositionBuffer = LODData.StaticVertexBuffers.PositionVertexBuffer;
+	const FStaticMeshVertexBuffer& VertexBuffer = LODData.StaticVertexBuffers.StaticMeshVertexBuffer;
+	const int32 NumUVs = FMath::Min<int32>(VertexBuffer.GetNumTexCoords(), MAX_TEXCOORDS);
+	if (NumUVs == 0 || PositionBuffer.GetNumVertices() == 0)
+	{
+		return;
+	}
+
+	// [Section * NumUVs + UV channel] triangle densities
+	const int32 NumSections = LODData.RenderSections.Num();
+	TArray<TArray<FTriangleDensity>> SectionDensities;
+	SectionDensities.SetNum(NumSections * NumUVs);
+	ParallelFor(NumSections, [&](int32 SectionIdx)
+	{
+		const FSkelMeshRenderSection& Section = LODData.RenderSections[SectionIdx];
+		const int32 NumTriangles = FMath::Min<int32>(Section.NumTriangles, (Indices.Num() - (int32)Section.BaseIndex) / 3);
+		for (int32 UVIdx = 0; UVIdx < NumUVs; UVIdx++)
+		{
+			SectionDensities[SectionIdx * NumUVs + UVIdx].Reserve(NumTriangles);
+		}
+
+		for (int32 TriIdx = 0; TriIdx < NumTriangles; TriIdx++)
+		{
+			const uint32 I0 = Indices[Section.BaseIndex + TriIdx * 3];
+			const uint32 I1 = Indices[Section.BaseIndex + TriIdx * 3 + 1];
+			const uint32 I2 = Indices[Section.BaseIndex + TriIdx * 3 + 2];
+			const FVector3f& P0 = PositionBuffer.VertexPosition(I0);
+			const float Area = ((PositionBuffer.VertexPosition(I1) - P0) ^ (PositionBuffer.VertexPosition(I2) - P0)).Size() * 0.5f;
+			if (Area <= UE_SMALL_NUMBER)
+			{
+				continue;
+			}
+
+			for (int32 UVIdx = 0; UVIdx < NumUVs; UVIdx++)
+			{
+				const FVector2f UV0 = VertexBuffer.GetVertexUV(I0, UVIdx);
+				const FVector2f UV1 = VertexBuffer.GetVertexUV(I1, UVIdx) - UV0;
+				const FVector2f UV2 = VertexBuffer.GetVertexUV(I2, UVIdx) - UV0;
+				const float UVArea = FMath::Abs(UV1 ^ UV2) * 0.5f;
+				if (UVArea > UE_SMALL_NUMBER)
+				{
+					SectionDensities[SectionIdx * NumUVs + UVIdx].Add({ FMath::Sqrt(Area / UVArea), FMath::Sqrt(Area) });
+				}
+			}
+		}
+	});
+
+	TArray<FSkeletalMaterial>& Materials = MergeMesh->GetMaterials();
+	TArray<FTriangleDensity> MaterialDensities;
+	for (int32 MaterialIdx = 0; MaterialIdx < Materials.Num(); MaterialIdx++)
+	{
+		// materials only drawn by later LODs keep the source densities
+		if (!LODData.RenderSections.ContainsByPredicate([MaterialIdx](const FSkelMeshRenderSection& Section) { return Section.MaterialIndex == MaterialIdx; }))
+		{
+			continue;
+		}
+
+		FMeshUVChannelInfo& UVChannelData = Materials[MaterialIdx].UVChannelData;
+		for (int32 UVIdx = 0; UVIdx < MAX_TEXCOORDS; UVIdx++)
+		{
+			MaterialDensities.Reset();
+			for (int32 SectionIdx = 0; SectionIdx < NumSections && UVIdx < NumUVs; SectionIdx++)
+			{
+				if (LODData.RenderSections[SectionIdx].MaterialIndex == MaterialIdx)
+				{
+					MaterialDensities.Append(SectionDensities[SectionIdx * NumUVs + UVIdx]);
+				}
+			}
+
+			// like the engine, drop the 10% lowest and highest densities (seams, degenerate UVs)
+			MaterialDensities.Sort([](const FTriangleDensity& A, const FTriangleDensity& B) { return A.Density < B.Density; });
+			const int32 Threshold = FMath::FloorToInt(MaterialDensities.Num() * 0.1f);
+			float WeightedDensity = 0.f;
+			float Weight = 0.f;
+			for (int32 Idx = Threshold; Idx < MaterialDensities.Num() - Threshold; Idx++)
+			{
+				WeightedDensity += MaterialDensities[Idx].Density * MaterialDensities[Idx].Weight;
+				Weight += MaterialDensities[Idx].Weight;
+			}
+			UVChannelData.LocalUVDensities[UVIdx] = Weight > UE_SMALL_NUMBER ? WeightedDensity / Weight : 0.f;
+		}
+		UVChannelData.bInitialized = true;
+		UVChannelData.bOverrideDensities = false;
+	}
+}
+
+void FJrSkeletalMeshMerge::MeasurePositionErrors(const FSkeletalMeshLODRenderData& LODData, FJrLODMergeStats& LODStats) const
+{
+	const FPositionVertexBuffer& PositionBuffer = LODData.StaticVertexBuffers.PositionVertexBuffer;
+	const uint32 NumVertices = PositionBuffer.GetNumVertices();
+	if (NumVertices == 0)
+	{
+		return;
+	}
+
+	FBox3f Bounds(ForceInit);
+	for (uint32 VertIdx = 0; VertIdx < NumVertices; VertIdx++)
+	{
+		Bounds += PositionBuffer.VertexPosition(VertIdx);
+	}
+
+	// Quantized16: 65535 steps over the bounds, Half: half floats around the bounds center
+	const FVector3f QuantizeScale = (Bounds.Max - Bounds.Min) / 65535.f;
+	const FVector3f QuantizeInvScale(
+		QuantizeScale.X > 0.f ? 1.f / QuantizeScale.X : 0.f,
+		QuantizeScale.Y > 0.f ? 1.f / QuantizeScale.Y : 0.f,
+		QuantizeScale.Z > 0.f ? 1.f / QuantizeScale.Z : 0.f);
+	const FVector3f HalfOffset = Bounds.GetCenter();
+
+	// both return the decoded position, only the round trip error matters
+	auto Quantize = [&](const FVector3f& Position)
+	{
+		const FVector3f Steps = (Position - Bounds.Min) * QuantizeInvScale;
+		FVector3f Decoded;
+		for (int32 Axis = 0; Axis < 3; Axis++)
+		{
+			Decoded[Axis] = (float)FMath::Clamp(FMath::RoundToInt(Steps[Axis]), 0, (int32)MAX_uint16);
+		}
+		return Bounds.Min + Decoded * QuantizeScale;
+	};
+	auto ToHalf = [&](const FVector3f& Position)
+	{
+		const FVector3f Local = Position - HalfOffset;
+		FVector3f Decoded;
+		for (int32 Axis = 0; Axis < 3; Axis++)
+		{
+			Decoded[Axis] = FFloat16(Local[Axis]).GetFloat();
+		}
+		return HalfOffset + Decoded;
+	};
+
+	// errors of both formats, so the report tells which precision a LOD could afford
+	float HalfError = 0.f;
+	float QuantizedError = 0.f;
+	for (uint32 VertIdx = 0; VertIdx < NumVertices; VertIdx++)
+	{
+		const FVector3f& Position = PositionBuffer.VertexPosition(VertIdx);
+		HalfError = FMath::Max(HalfError, FVector3f::Dist(ToHalf(Position), Position));
+		QuantizedError = FMath::Max(QuantizedError, FVector3f::Dist(Quantize(Position), Position));
+	}
+	LODStats.HalfPositionError = HalfError;
+	LODStats.Quantized16PositionError = QuantizedError;
+}
+
+/**
+* Removes the bones of a merged LOD asked by LODBoneReductions, then the least weighted skinning bones down to MaxBoneCount
+*/
+void FJrSkeletalMeshMerge::ReduceLODBones(int32 MergedLODIdx, FSkeletalMeshLODRenderData& LODData, TArray<FSkinWeightInfo>& SkinWeights) const
+{
+	const FReferenceSkeleton& RefSkeleton = MergeMesh->GetRefSkeleton();
+	const int32 NumBones = RefSkeleton.GetRawBoneNum();
+
+	// the reductions of the previous LODs still apply
+	TBitArray<> RemovedBones(false, NumBones);
+	int32 MaxBoneCount = 0;
+	for (const FJrLODBoneReduction& Reduction : MergeOptions.LODBoneReductions)
+	{
+		if (Reduction.LODIndex > MergedLODIdx)
+		{
+			continue;
+		}
+
+		for (const FName& BoneName : Reduction.BonesToRemove)
+		{
+			const int32 BoneIndex = RefSkeleton.FindRawBoneIndex(BoneName);
+			if (BoneIndex > 0)
+			{
+				RemovedBones[BoneIndex] = true;
+			}
+		}
+
+		if (Reduction.MaxBoneCount > 0)
+		{
+			MaxBoneCount = MaxBoneCount > 0 ? FMath::Min(MaxBoneCount, Reduction.MaxBoneCount) : Reduction.MaxBoneCount;
+		}
+	}
+
+	if (MaxBoneCount > 0)
+	{
+		// total weight of each skinning bone that is not removed yet
+		TArray<double> BoneInfluences;
+		BoneInfluences.SetNumZeroed(NumBones);
+		for (const FSkelMeshRenderSection& Section : LODData.RenderSections)
+		{
+			for (uint32 VertIdx = Section.BaseVertexIndex; VertIdx < Section.BaseVertexIndex + Section.NumVertices; VertIdx++)
+			{
+				const FSkinWeightInfo& Weights = SkinWeights[VertIdx];
+				for (int32 Influence = 0; Influence < MAX_TOTAL_INFLUENCES; Influence++)
+				{
+					if (Weights.InfluenceWeights[Influence] > 0)
+					{
+						BoneInfluences[Section.BoneMap[Weights.InfluenceBones[Influence]]] += Weights.InfluenceWeights[Influence];
+					}
+				}
+			}
+		}
+
+		// the weights of a removed bone go to its nearest kept ancestor, which becomes a skinning bone if it had no weight:
+		// the skinning bones are counted again after each removal pass until they fit
+		TArray<double> KeptInfluences;
+		TArray<int32> SkinningBones;
+		while (true)
+		{
+			KeptInfluences.Reset();
+			KeptInfluences.SetNumZeroed(NumBones);
+			TArray<int32> KeptAncestors;
+			KeptAncestors.SetNumUninitialized(NumBones);
+			for (int32 BoneIndex = 0; BoneIndex < NumBones; BoneIndex++)
+			{
+				KeptAncestors[BoneIndex] = RemovedBones[BoneIndex] ? KeptAncestors[RefSkeleton.GetRawParentIndex(BoneIndex)] : BoneIndex;
+				KeptInfluences[KeptAncestors[BoneIndex]] += BoneInfluences[BoneIndex];
+			}
+
+			SkinningBones.Reset();
+			for (int32 BoneIndex = 1; BoneIndex < NumBones; BoneIndex++)
+			{
+				if (KeptInfluences[BoneIndex] > 0.0)
+				{
+					SkinningBones.Add(BoneIndex);
+				}
+			}
+
+			const int32 NumSkinningBones = SkinningBones.Num() + (KeptInfluences[0] > 0.0 ? 1 : 0);
+			if (NumSkinningBones <= MaxBoneCount || SkinningBones.Num() == 0)
+			{
+				break;
+			}
+
+			SkinningBones.Sort([&KeptInfluences](int32 A, int32 B) { return KeptInfluences[A] < KeptInfluences[B]; });
+			for (int32 Idx = 0; Idx < NumSkinningBones - MaxBoneCount && Idx < SkinningBones.Num(); Idx++)
+			{
+				RemovedBones[SkinningBones[Idx]] = true;
+			}
+		}
+	}
+
+	if (RemovedBones.CountSetBits() == 0)
+	{
+		return;
+	}
+
+	// nearest kept ancestor of every bone
+	TArray<FBoneIndexType> KeptBones;
+	KeptBones.SetNumUninitialized(NumBones);
+	for (int32 BoneIndex = 0; BoneIndex < NumBones; BoneIndex++)
+	{
+		// parents come before their children, so the parent entry is already resolved
+		KeptBones[BoneIndex] = RemovedBones[BoneIndex] ? KeptBones[RefSkeleton.GetRawParentIndex(BoneIndex)] : (FBoneIndexType)BoneIndex;
+	}
+
+	LODData.ActiveBoneIndices.Reset();
+	for (FSkelMeshRenderSection& Section : LODData.RenderSections)
+	{
+		TArray<FBoneIndexType> NewBoneMap;
+		for (uint32 VertIdx = Section.BaseVertexIndex; VertIdx < Section.BaseVertexIndex + Section.NumVertices; VertIdx++)
+		{
+			FSkinWeightInfo& Weights = SkinWeights[VertIdx];
+
+			// move the weights to the kept bones, merging the influences that end on the same bone
+			int32 NewBones[MAX_TOTAL_INFLUENCES];
+			int32 NewWeights[MAX_TOTAL_INFLUENCES];
+			int32 NumInfluences = 0;
+			for (int32 Influence = 0; Influence < MAX_TOTAL_INFLUENCES; Influence++)
+			{
+				if (Weights.InfluenceWeights[Influence] == 0)
+				{
+					continue;
+				}
+
+				const int32 BoneIndex = KeptBones[Section.BoneMap[Weights.InfluenceBones[Influence]]];
+				int32 Slot = 0;
+				while (Slot < NumInfluences && NewBones[Slot] != BoneIndex)
+				{
+					Slot++;
+				}
+				if (Slot == NumInfluences)
+				{
+					NewBones[NumInfluences] = BoneIndex;
+					NewWeights[NumInfluences++] = 0;
+				}
+				NewWeights[Slot] += Weights.InfluenceWeights[Influence];
+			}
+
+			// keep the influences sorted by decreasing weight like the source buffers
+			for (int32 Slot = 1; Slot < NumInfluences; Slot++)
+			{
+				for (int32 Other = Slot; Other > 0 && NewWeights[Other] > NewWeights[Other - 1]; Other--)
+				{
+					Swap(NewWeights[Other], NewWeights[Other - 1]);
+					Swap(NewBones[Other], NewBones[Other - 1]);
+				}
+			}
+
+			for (int32 Influence = 0; Influence < MAX_TOTAL_INFLUENCES; Influence++)
+			{
+				const bool bUsed = Influence < NumInfluences;
+				Weights.InfluenceBones[Influence] = bUsed ? (FBoneIndexType)NewBoneMap.AddUnique((FBoneIndexType)NewBones[Influence]) : 0;
+				Weights.InfluenceWeights[Influence] = bUsed ? (uint16)NewWeights[Influence] : 0;
+			}
+		}
+
+		// a section whose vertices were all culled keeps a valid bone map
+		if (NewBoneMap.Num() == 0)
+		{
+			NewBoneMap.Add(0);
+		}
+
+		Section.BoneMap = MoveTemp(NewBoneMap);
+		for (const FBoneIndexType BoneIndex : Section.BoneMap)
+		{
+			LODData.ActiveBoneIndices.AddUnique(BoneIndex);
+		}
+	}
+
+	LODData.RequiredBones.RemoveAll([&RemovedBones](FBoneIndexType BoneIndex) { return RemovedBones[BoneIndex]; });
+	// removed bones that still have kept children stay required for the component space transforms
+	RefSkeleton.EnsureParentsExistAndSort(LODData.RequiredBones);
+
+	UE_LOG(LogSkeletalMesh, Log, TEXT("SkeletalMeshMerge: removed %d bones from LOD %d"), RemovedBones.CountSetBits(), MergedLODIdx);
+}
+
+/**
+* (Re)initialize and merge skeletal mesh info from the list of source meshes to the merge mesh
+* @return true if succeeded
+*/
+bool FJrSkeletalMeshMerge::ProcessMergeMesh()
+{
+	bool Result=true;
+	
+	// copy settings and bone info from src meshes
+	bool bNeedsInit=true;
+	
+PRAGMA_DISABLE_DEPRECATION_WARNINGS
+	MergeMesh->GetSkelMirrorTable().Empty();
+
+	for( int32 MeshIdx=0; MeshIdx < SrcMeshList.Num(); MeshIdx++ )
+	{
+		USkeletalMesh* SrcMesh = SrcMeshList[MeshIdx];
+		if( SrcMesh )
+		{
+			if( bNeedsInit )
+			{
+				// initialize the merged mesh with the first src mesh entry used
+				MergeMesh->SetImportedBounds(SrcMesh->GetImportedBounds());
+
+				MergeMesh->SetSkelMirrorAxis(SrcMesh->GetSkelMirrorAxis());
+				MergeMesh->SetSkelMirrorFlipAxis(SrcMesh->GetSkelMirrorFlipAxis());
+
+				// only initialize once
+				bNeedsInit = false;
+			}
+			else
+			{
+				// add bounds
+				MergeMesh->SetImportedBounds(MergeMesh->GetImportedBounds() + SrcMesh->GetImportedBounds());
+			}
+		}
+	}
+PRAGMA_ENABLE_DEPRECATION_WARNINGS
+	// Rebuild inverse ref pose matrices, only if the skeleton changed since MergeSkeleton.
+	UpdateInvRefMatrices();
+
+	return Result;
+}
+
+void FJrSkeletalMeshMerge::UpdateInvRefMatrices()
+{
+	const FReferenceSkeleton& RefSkeleton = MergeMesh->GetRefSkeleton();
+	const TArray<FTransform>& RefBonePose = RefSkeleton.GetRawRefBonePose();
+
+	uint64 Hash = CityHash64(reinterpret_cast<const char*>(RefBonePose.GetData()), RefBonePose.Num() * sizeof(FTransform));
+	for (int32 BoneIndex = 0; BoneIndex < RefSkeleton.GetRawBoneNum(); BoneIndex++)
+	{
+		const int32 ParentIndex = RefSkeleton.GetRawParentIndex(BoneIndex);
+		Hash = CityHash64WithSeed(reinterpret_cast<const char*>(&ParentIndex), sizeof(ParentIndex), Hash);
+	}
+	Hash = FMath::Max<uint64>(Hash, 1);
+
+	if (Hash == InvRefMatricesSkeletonHash && MergeMesh->GetRefBasesInvMatrix().Num() == RefSkeleton.GetRawBoneNum())
+	{
+		return;
+	}
+
+	// the engine function also rebuilds the mesh cached component space ref pose, so it is kept over a custom pass
+	MergeMesh->GetRefBasesInvMatrix().Empty();
+	MergeMesh->CalculateInvRefMatrices();
+	InvRefMatricesSkeletonHash = Hash;
+}
+
+int32 FJrSkeletalMeshMerge::CalculateLodCount(const TArray<USkeletalMesh*>& SourceMeshList) const
+{
+	int32 LodCount = INT_MAX;
+	int32 MaxSourceLodCount = 0;
+
+	for (int32 i = 0, MeshCount = SourceMeshList.Num(); i < MeshCount; ++i)
+	{
+		USkeletalMesh* SourceMesh = SourceMeshList[i];
+
+		if (SourceMesh)
+		{
+			LodCount = FMath::Min<int32>(LodCount, SourceMesh->GetLODNum());
+			MaxSourceLodCount = FMath::Max<int32>(MaxSourceLodCount, SourceMesh->GetLODNum());
+		}
+	}
+
+	if (LodCount == INT_MAX)
+	{
+		return -1;
+	}
+
+	// Missing LODs are synthesized, so keep the requested (or the largest) LOD count instead of the smallest one.
+	if (MergeOptions.bSynthesizeMissingLODs)
+	{
+		LodCount = MergeOptions.MaxLODCount > 0 ? MergeOptions.MaxLODCount + StripTopLODs : MaxSourceLodCount;
+	}
+
+	// Decrease the number of LODs we are going to make based on StripTopLODs.
+	// But, make sure there is at least one.
+
+	LodCount -= StripTopLODs;
+	LodCount = FMath::Max(LodCount, 1);
+	
+	return LodCount;
+}
+
+/**
+* Reduces the triangles of a render section with greedy shortest-edge collapses.
+* Vertices sharing a position are collapsed as one so UV / normal seams don't tear, and no vertex is created:
+* the reduced indices only reference vertices of the source section, so their skin weights stay valid.
+*
+* @param LODData - source LOD render data
+* @param Section - source section to reduce
+* @param TargetNumTriangles - number of triangles to reduce to
+* @param OutIndices - [out] reduced index list (source vertex indices)
+*/
+static void ReduceSectionByEdgeCollapse(const FSkeletalMeshLODRenderData& LODData, const FSkelMeshRenderSection& Section, int32 TargetNumTriangles, TArray<uint32>& OutIndices)
+{
+	const FRawStaticIndexBuffer16or32Interface* IndexBuffer = LODData.MultiSizeIndexContainer.GetIndexBuffer();
+	const FPositionVertexBuffer& PositionBuffer = LODData.StaticVertexBuffers.PositionVertexBuffer;
+	const FStaticMeshVertexBuffer& StaticMeshBuffer = LODData.StaticVertexBuffers.StaticMeshVertexBuffer;
+	const int32 NumTriangles = FMath::Min<int32>(Section.NumTriangles, (IndexBuffer->Num() - (int32)Section.BaseIndex) / 3);
+	const int32 NumVertices = FMath::Min<int32>(Section.NumVertices, PositionBuffer.GetNumVertices() - Section.BaseVertexIndex);
+
+	OutIndices.Reset(NumTriangles * 3);
+	if (TargetNumTriangles >= NumTriangles || NumVertices <= 0)
+	{
+		for (int32 Idx = 0; Idx < NumTriangles * 3; ++Idx)
+		{
+			OutIndices.Add(IndexBuffer->Get(Section.BaseIndex + Idx));
+		}
+		return;
+	}
+
+	// group the section vertices by position
+	TArray<int32> VertexToGroup;
+	TArray<FVector3f> GroupPositions;
+	TArray<TArray<int32>> GroupVertices;
+	{
+		TMap<FVector3f, int32> PositionToGroup;
+		PositionToGroup.Reserve(NumVertices);
+		VertexToGroup.SetNumUninitialized(NumVertices);
+		for (int32 VertIdx = 0; VertIdx < NumVertices; ++VertIdx)
+		{
+			const FVector3f& Position = PositionBuffer.VertexPosition(Section.BaseVertexIndex + VertIdx);
+			int32 GroupIdx;
+			if (const int32* FoundGroup = PositionToGroup.Find(Position))
+			{
+				GroupIdx = *FoundGroup;
+			}
+			else
+			{
+				GroupIdx = GroupPositions.Add(Position);
+				GroupVertices.AddDefaulted();
+				PositionToGroup.Add(Position, GroupIdx);
+			}
+			VertexToGroup[VertIdx] = GroupIdx;
+			GroupVertices[GroupIdx].Add(VertIdx);
+		}
+	}
+	const int32 NumGroups = GroupPositions.Num();
+
+	// triangle corners (section-relative vertex indices) and group adjacency
+	TArray<int32> TriangleCorners;
+	TArray<bool> TriangleAlive;
+	TArray<TArray<int32>> GroupTriangles;
+	TArray<TSet<int32>> GroupNeighbors;
+	TriangleCorners.SetNumUninitialized(NumTriangles * 3);
+	TriangleAlive.Init(false, NumTriangles);
+	GroupTriangles.SetNum(NumGroups);
+	GroupNeighbors.SetNum(NumGroups);
+
+	int32 NumAliveTriangles = 0;
+	for (int32 TriIdx = 0; TriIdx < NumTriangles; ++TriIdx)
+	{
+		int32 Groups[3];
+		bool bValid = true;
+		for (int32 Corner = 0; Corner < 3; ++Corner)
+		{
+			const int32 VertIdx = (int32)IndexBuffer->Get(Section.BaseIndex + TriIdx * 3 + Corner) - (int32)Section.BaseVertexIndex;
+			bValid &= VertIdx >= 0 && VertIdx < NumVertices;
+			TriangleCorners[TriIdx * 3 + Corner] = VertIdx;
+			Groups[Corner] = bValid ? VertexToGroup[VertIdx] : INDEX_NONE;
+		}
+		if (!bValid || Groups[0] == Groups[1] || Groups[1] == Groups[2] || Groups[0] == Groups[2])
+		{
+			continue;
+		}
+
+		TriangleAlive[TriIdx] = true;
+		++NumAliveTriangles;
+		for (int32 Corner = 0; Corner < 3; ++Corner)
+		{
+			GroupTriangles[Groups[Corner]].Add(TriIdx);
+			GroupNeighbors[Groups[Corner]].Add(Groups[(Corner + 1) % 3]);
+			GroupNeighbors[Groups[Corner]].Add(Groups[(Corner + 2) % 3]);
+		}
+	}
+
+	// collapse candidates, invalidated by the group versions when either end changed
+	struct FCollapseCandidate
+	{
+		float Cost;
+		int32 FromGroup;
+		int32 ToGroup;
+		int32 FromVersion;
+		int32 ToVersion;
+	};
+	auto CandidatePredicate = [](const FCollapseCandidate& A, const FCollapseCandidate& B) { return A.Cost < B.Cost; };
+
+	TArray<int32> GroupAlias;
+	TArray<int32> GroupVersion;
+	GroupAlias.SetNumUninitialized(NumGroups);
+	GroupVersion.SetNumZeroed(NumGroups);
+	for (int32 GroupIdx = 0; GroupIdx < NumGroups; ++GroupIdx)
+	{
+		GroupAlias[GroupIdx] = GroupIdx;
+	}
+
+	TArray<FCollapseCandidate> Candidates;
+	auto PushCandidate = [&](int32 GroupA, int32 GroupB)
+	{
+		// collapse the group with fewer triangles into the other one
+		const bool bAIntoB = GroupTriangles[GroupA].Num() <= GroupTriangles[GroupB].Num();
+		const int32 FromGroup = bAIntoB ? GroupA : GroupB;
+		const int32 ToGroup = bAIntoB ? GroupB : GroupA;
+		Candidates.HeapPush({ FVector3f::DistSquared(GroupPositions[GroupA], GroupPositions[GroupB]), FromGroup, ToGroup, GroupVersion[FromGroup], GroupVersion[ToGroup] }, CandidatePredicate);
+	};
+	for (int32 GroupIdx = 0; GroupIdx < NumGroups; ++GroupIdx)
+	{
+		for (const int32 NeighborIdx : GroupNeighbors[GroupIdx])
+		{
+			if (GroupIdx < NeighborIdx)
+			{
+				PushCandidate(GroupIdx, NeighborIdx);
+			}
+		}
+	}
+
+	// vertices of collapsed groups are aliased to the vertex of the surviving group with the closest UV
+	TArray<int32> VertexAlias;
+	VertexAlias.SetNumUninitialized(NumVertices);
+	for (int32 VertIdx = 0; VertIdx < NumVertices; ++VertIdx)
+	{
+		VertexAlias[VertIdx] = VertIdx;
+	}
+	const bool bHasUVs = StaticMeshBuffer.GetNumTexCoords() > 0;
+
+	while (NumAliveTriangles > TargetNumTriangles && Candidates.Num() > 0)
+	{
+		FCollapseCandidate Candidate;
+		Candidates.HeapPop(Candidate, CandidatePredicate);
+
+		const int32 FromGroup = Candidate.FromGroup;
+		const int32 ToGroup = Candidate.ToGroup;
+		if (GroupAlias[FromGroup] != FromGroup || GroupAlias[ToGroup] != ToGroup ||
+			GroupVersion[FromGroup] != Candidate.FromVersion || GroupVersion[ToGroup] != Candidate.ToVersion)
+		{
+			continue;
+		}
+
+		for (const int32 TriIdx : GroupTriangles[FromGroup])
+		{
+			if (!TriangleAlive[TriIdx])
+			{
+				continue;
+			}
+
+			bool bDegenerate = false;
+			for (int32 Corner = 0; Corner < 3; ++Corner)
+			{
+				int32 CornerGroup = VertexToGroup[TriangleCorners[TriIdx * 3 + Corner]];
+				while (GroupAlias[CornerGroup] != CornerGroup)
+				{
+					CornerGroup = GroupAlias[CornerGroup];
+				}
+				bDegenerate |= CornerGroup == ToGroup;
+			}
+
+			if (bDegenerate)
+			{
+				TriangleAlive[TriIdx] = false;
+				--NumAliveTriangles;
+			}
+			else
+			{
+				GroupTriangles[ToGroup].Add(TriIdx);
+			}
+		}
+
+		for (const int32 FromVertIdx : GroupVertices[FromGroup])
+		{
+			int32 BestVertIdx = GroupVertices[ToGroup][0];
+			if (bHasUVs)
+			{
+				const FVector2f FromUV = StaticMeshBuffer.GetVertexUV(Section.BaseVertexIndex + FromVertIdx, 0);
+				float BestDistSq = MAX_flt;
+				for (const int32 ToVertIdx : GroupVertices[ToGroup])
+				{
+					const float DistSq = FVector2f::DistSquared(FromUV, StaticMeshBuffer.GetVertexUV(Section.BaseVertexIndex + ToVertIdx, 0));
+					if (DistSq < BestDistSq)
+					{
+						BestDistSq = DistSq;
+						BestVertIdx = ToVertIdx;
+					}
+				}
+			}
+			VertexAlias[FromVertIdx] = BestVertIdx;
+		}
+
+		for (const int32 NeighborIdx : GroupNeighbors[FromGroup])
+		{
+			if (NeighborIdx != ToGroup)
+			{
+				GroupNeighbors[NeighborIdx].Remove(FromGroup);
+				GroupNeighbors[NeighborIdx].Add(ToGroup);
+				GroupNeighbors[ToGroup].Add(NeighborIdx);
+			}
+		}
+		GroupNeighbors[ToGroup].Remove(FromGroup);
+		GroupNeighbors[FromGroup].Empty();
+		GroupTriangles[FromGroup].Empty();
+		GroupAlias[FromGroup] = ToGroup;
+		++GroupVersion[ToGroup];
+
+		for (const int32 NeighborIdx : GroupNeighbors[ToGroup])
+		{
+			PushCandidate(ToGroup, NeighborIdx);
+		}
+	}
+
+	for (int32 TriIdx = 0; TriIdx < NumTriangles; ++TriIdx)
+	{
+		if (!TriangleAlive[TriIdx])
+		{
+			continue;
+		}
+
+		for (int32 Corner = 0; Corner < 3; ++Corner)
+		{
+			int32 VertIdx = TriangleCorners[TriIdx * 3 + Corner];
+			while (VertexAlias[VertIdx] != VertIdx)
+			{
+				VertIdx = VertexAlias[VertIdx];
+			}
+			OutIndices.Add(Section.BaseVertexIndex + VertIdx);
+		}
+	}
+}
+
+void FJrSkeletalMeshMerge::CalculatePartCulling(int32 NumMergedLODs)
+{
+	for (FMergeMeshInfo& MeshInfo : SrcMeshInfo)
+	{
+		MeshInfo.CullLODIdx = MAX_int32;
+	}
+
+	for (const FJrPartLODCullRule& Rule : MergeOptions.PartCullRules)
+	{
+		const int32 MeshIdx = SrcMeshList.Find(Rule.Mesh.Get());
+		if (MeshIdx != INDEX_NONE && Rule.DropAtLOD > 0)
+		{
+			SrcMeshInfo[MeshIdx].CullLODIdx = Rule.DropAtLOD;
+		}
+	}
+
+	if (MergeOptions.MinPartScreenSize > 0.f)
+	{
+		// screen size of a source LOD, synthesized LODs carry their own
+		auto GetSourceScreenSize = [this](int32 MeshIdx, int32 SourceLODIdx)
+		{
+			const USkeletalMesh* SrcMesh = SrcMeshList[MeshIdx];
+			const int32 NumAuthoredLODs = SrcMesh->GetLODNum();
+			const TArray<FSynthesizedLOD>& SynthesizedLODs = SrcMeshInfo[MeshIdx].SynthesizedLODs;
+			if (SourceLODIdx >= NumAuthoredLODs && SynthesizedLODs.IsValidIndex(SourceLODIdx - NumAuthoredLODs))
+			{
+				return SynthesizedLODs[SourceLODIdx - NumAuthoredLODs].ScreenSize;
+			}
+			const FSkeletalMeshLODInfo* LODInfo = SrcMesh->GetLODInfo(FMath::Min(SourceLODIdx, NumAuthoredLODs - 1));
+			return LODInfo ? LODInfo->ScreenSize.Default : 1.f;
+		};
+
+		FBoxSphereBounds MergedBounds(ForceInitToZero);
+		bool bHasBounds = false;
+		for (const USkeletalMesh* SrcMesh : SrcMeshList)
+		{
+			if (SrcMesh)
+			{
+				MergedBounds = bHasBounds ? MergedBounds + SrcMesh->GetBounds() : SrcMesh->GetBounds();
+				bHasBounds = true;
+			}
+		}
+
+		// LOD 0 always keeps every part
+		for (int32 LODIdx = 1; LODIdx < NumMergedLODs && MergedBounds.SphereRadius > 0.f; LODIdx++)
+		{
+			// same as the merged LOD screen size, the smallest one of the sources
+			float LODScreenSize = UE_MAX_FLT;
+			for (int32 MeshIdx = 0; MeshIdx < SrcMeshList.Num(); MeshIdx++)
+			{
+				if (SrcMeshList[MeshIdx])
+				{
+					LODScreenSize = FMath::Min(LODScreenSize, GetSourceScreenSize(MeshIdx, LODIdx + StripTopLODs));
+				}
+			}
+
+			for (int32 MeshIdx = 0; MeshIdx < SrcMeshList.Num(); MeshIdx++)
+			{
+				FMergeMeshInfo& MeshInfo = SrcMeshInfo[MeshIdx];
+				if (SrcMeshList[MeshIdx] && MeshInfo.CullLODIdx > LODIdx)
+				{
+					const float PartScreenSize = LODScreenSize * SrcMeshList[MeshIdx]->GetBounds().SphereRadius / MergedBounds.SphereRadius;
+					if (PartScreenSize < MergeOptions.MinPartScreenSize)
+					{
+						MeshInfo.CullLODIdx = LODIdx;
+					}
+				}
+			}
+		}
+	}
+
+	// a LOD needs at least one part, keep the largest one of the parts culled from it
+	for (int32 LODIdx = 0; LODIdx < NumMergedLODs; LODIdx++)
+	{
+		int32 LargestCulledMeshIdx = INDEX_NONE;
+		bool bHasVisiblePart = false;
+		for (int32 MeshIdx = 0; MeshIdx < SrcMeshList.Num() && !bHasVisiblePart; MeshIdx++)
+		{
+			if (!SrcMeshList[MeshIdx])
+			{
+				continue;
+			}
+
+			bHasVisiblePart = SrcMeshInfo[MeshIdx].CullLODIdx > LODIdx;
+			if (LargestCulledMeshIdx == INDEX_NONE || SrcMeshList[MeshIdx]->GetBounds().SphereRadius > SrcMeshList[LargestCulledMeshIdx]->GetBounds().SphereRadius)
+			{
+				LargestCulledMeshIdx = MeshIdx;
+			}
+		}
+
+		if (!bHasVisiblePart && LargestCulledMeshIdx != INDEX_NONE)
+		{
+			SrcMeshInfo[LargestCulledMeshIdx].CullLODIdx = MAX_int32;
+		}
+	}
+
+	for (int32 MeshIdx = 0; MeshIdx < SrcMeshList.Num(); MeshIdx++)
+	{
+		if (SrcMeshList[MeshIdx] && SrcMeshInfo[MeshIdx].CullLODIdx < NumMergedLODs)
+		{
+			UE_LOG(LogSkeletalMesh, Log, TEXT("SkeletalMeshMerge: %s is culled from LOD %d"), *SrcMeshList[MeshIdx]->GetName(), SrcMeshInfo[MeshIdx].CullLODIdx);
+		}
+	}
+}
 
-	// sort required bone array in strictly increasing order
-	MergeLODData.RequiredBones.Sort();
-	MergeMesh->GetRefSkeleton().EnsureParentsExistAndSort(MergeLODData.ActiveBoneIndices);
-	
-	// copy the new vertices and indices to the vertex buffer for the new model
-	MergeLODData.StaticVertexBuffers.StaticMeshVertexBuffer.SetUseFullPrecisionUVs(MergeLODInfo.BuildSettings.bUseFullPrecisionUVs);
+void FJrSkeletalMeshMerge::SynthesizeMissingLODs(int32 NumMergedLODs, bool bReduceIndices)
+{
+	// source LOD indices are offset by the stripped top LODs
+	const int32 NumSourceLODsNeeded = NumMergedLODs + StripTopLODs;
 
-	MergeLODData.StaticVertexBuffers.PositionVertexBuffer.Init(MergedVertexBuffer.Num(), bNeedsCPUAccess);
-	MergeLODData.StaticVertexBuffers.StaticMeshVertexBuffer.Init(MergedVertexBuffer.Num(), TotalNumUVs, bNeedsCPUAccess);
+	for (int32 MeshIdx = 0; MeshIdx < SrcMeshList.Num(); MeshIdx++)
+	{
+		USkeletalMesh* SrcMesh = SrcMeshList[MeshIdx];
+		FMergeMeshInfo& MeshInfo = SrcMeshInfo[MeshIdx];
+		MeshInfo.SynthesizedLODs.Empty();
+
+		FSkeletalMeshRenderData* SrcResource = SrcMesh ? SrcMesh->GetResourceForRendering() : nullptr;
+		if (!SrcResource || SrcResource->LODRenderData.Num() == 0 || SrcResource->LODRenderData.Num() >= NumSourceLODsNeeded)
+		{
+			continue;
+		}
 
-	bool bUseBackwardsCompatibleF16TruncUVs = MergeLODInfo.BuildSettings.bUseBackwardsCompatibleF16TruncUVs;
+		// every missing LOD is reduced from the last authored one
+		const int32 BaseLODIdx = SrcResource->LODRenderData.Num() - 1;
+		const FSkeletalMeshLODRenderData& BaseLODData = SrcResource->LODRenderData[BaseLODIdx];
+		const FSkeletalMeshLODInfo* BaseLODInfo = SrcMesh->GetLODInfo(BaseLODIdx);
+		float ScreenSize = BaseLODInfo ? BaseLODInfo->ScreenSize.Default : 1.f;
 
-	for (int i = 0; i < MergedVertexBuffer.Num(); i++)
-	{
-		MergeLODData.StaticVertexBuffers.PositionVertexBuffer.VertexPosition(i) = MergedVertexBuffer[i].Position;
-		MergeLODData.StaticVertexBuffers.StaticMeshVertexBuffer.SetVertexTangents(i, MergedVertexBuffer[i].TangentX.ToFVector3f(), MergedVertexBuffer[i].GetTangentY(), MergedVertexBuffer[i].TangentZ.ToFVector3f());
-		for (uint32 j = 0; j < TotalNumUVs; j++)
+		for (int32 Step = 0; Step < NumSourceLODsNeeded - SrcResource->LODRenderData.Num(); ++Step)
 		{
-			MergeLODData.StaticVertexBuffers.StaticMeshVertexBuffer.SetVertexUV(i, j, MergedVertexBuffer[i].UVs[j], bUseBackwardsCompatibleF16TruncUVs);
+			FSynthesizedLOD& SynthesizedLOD = MeshInfo.SynthesizedLODs.AddDefaulted_GetRef();
+			SynthesizedLOD.BaseLODIdx = BaseLODIdx;
+			ScreenSize *= 0.5f;
+			SynthesizedLOD.ScreenSize = ScreenSize;
+
+			const float TriangleRatio = MergeOptions.GetSynthesizedLODTriangleRatio(Step);
+			SynthesizedLOD.SectionIndices.SetNum(BaseLODData.RenderSections.Num());
+			for (int32 SectionIdx = 0; SectionIdx < BaseLODData.RenderSections.Num() && bReduceIndices; SectionIdx++)
+			{
+				const FSkelMeshRenderSection& Section = BaseLODData.RenderSections[SectionIdx];
+				const int32 TargetNumTriangles = FMath::Max(1, FMath::RoundToInt(Section.NumTriangles * TriangleRatio));
+				ReduceSectionByEdgeCollapse(BaseLODData, Section, TargetNumTriangles, SynthesizedLOD.SectionIndices[SectionIdx]);
+			}
 		}
-	}
 
-	MergeLODData.SkinWeightVertexBuffer.SetMaxBoneInfluences(SourceMaxBoneInfluences);
-	MergeLODData.SkinWeightVertexBuffer.SetUse16BitBoneIndex(bSourceUse16BitBoneIndex);
-	MergeLODData.SkinWeightVertexBuffer.SetNeedsCPUAccess(bNeedsCPUAccess);
+		UE_CLOG(bReduceIndices, LogSkeletalMesh, Log, TEXT("SkeletalMeshMerge: synthesized %d LOD(s) for %s from LOD %d"),
+			MeshInfo.SynthesizedLODs.Num(), *SrcMesh->GetName(), BaseLODIdx);
+	}
+}
 
-	// copy vertex resource arrays
-	MergeLODData.SkinWeightVertexBuffer = MergedSkinWeightBuffer;
+struct FJrSkeletalMeshMerge::FMaskImage
+{
+	int32 SizeX = 0;
+	int32 SizeY = 0;
+	/** Mask value (red channel) of each texel. */
+	TArray<uint8> Texels;
 
-	if( MergeMesh->GetHasVertexColors() )
+	FMaskImage(const UTexture2D* Texture)
 	{
-		MergeLODData.StaticVertexBuffers.ColorVertexBuffer.InitFromColorArray(MergedColorBuffer);
+#if WITH_EDITORONLY_DATA
+		// the source art is read since the platform data can be compressed
+		FTextureSource& Source = const_cast<UTexture2D*>(Texture)->Source;
+		TArray64<uint8> MipData;
+		if (!Source.IsValid() || !Source.GetMipData(MipData, 0))
+		{
+			UE_LOG(LogSkeletalMesh, Warning, TEXT("SkeletalMeshMerge: mask texture %s has no source data"), *Texture->GetName());
+			return;
+		}
+
+		int32 BytesPerPixel = 0;
+		int32 RedOffset = 0;
+		switch (Source.GetFormat())
+		{
+		case TSF_G8:		BytesPerPixel = 1; RedOffset = 0; break;
+		case TSF_BGRA8:		BytesPerPixel = 4; RedOffset = 2; break;
+		case TSF_G16:		BytesPerPixel = 2; RedOffset = 1; break;
+		case TSF_RGBA16:	BytesPerPixel = 8; RedOffset = 1; break;
+		default:
+			UE_LOG(LogSkeletalMesh, Warning, TEXT("SkeletalMeshMerge: unsupported source format for mask texture %s"), *Texture->GetName());
+			return;
+		}
+
+		SizeX = Source.GetSizeX();
+		SizeY = Source.GetSizeY();
+		Texels.SetNumUninitialized(SizeX * SizeY);
+		for (int32 TexelIdx = 0; TexelIdx < Texels.Num(); TexelIdx++)
+		{
+			// 16 bit formats are little endian, the high byte is enough here
+			Texels[TexelIdx] = MipData[(int64)TexelIdx * BytesPerPixel + RedOffset];
+		}
+#endif
 	}
 
-	
-	const uint8 DataTypeSize = (MaxIndex < MAX_uint16) ? sizeof(uint16) : sizeof(uint32);
-	MergeLODData.MultiSizeIndexContainer.RebuildIndexBuffer(DataTypeSize, MergedIndexBuffer);
-}
+	bool IsMasked(const FVector2f& UV) const
+	{
+		if (Texels.Num() == 0)
+		{
+			return false;
+		}
 
-/**
-* (Re)initialize and merge skeletal mesh info from the list of source meshes to the merge mesh
-* @return true if succeeded
-*/
-bool FJrSkeletalMeshMerge::ProcessMergeMesh()
-{
-	bool Result=true;
-	
-	// copy settings and bone info from src meshes
-	bool bNeedsInit=true;
-	
-PRAGMA_DISABLE_DEPRECATION_WARNINGS
-	MergeMesh->GetSkelMirrorTable().Empty();
+		const int32 X = FMath::Clamp(FMath::FloorToInt(FMath::Frac(UV.X) * SizeX), 0, SizeX - 1);
+		const int32 Y = FMath::Clamp(FMath::FloorToInt(FMath::Frac(UV.Y) * SizeY), 0, SizeY - 1);
+		return Texels[Y * SizeX + X] > 127;
+	}
+};
 
-	for( int32 MeshIdx=0; MeshIdx < SrcMeshList.Num(); MeshIdx++ )
+struct FJrSkeletalMeshMerge::FMaskOccluder
+{
+	/** Triangle corners, three per triangle. */
+	TArray<FVector3f> Corners;
+	FBox3f Bounds;
+	float CellSize = 1.f;
+	FIntVector NumCells;
+	/** Triangles overlapping each cell. */
+	TArray<TArray<int32>> Cells;
+
+	/** @param RebaseMatrix - covering part root space to merged root space, the triangles are stored in the merged space */
+	FMaskOccluder(const FSkeletalMeshLODRenderData& LODData, const FMatrix44f& RebaseMatrix)
+		: Bounds(ForceInit)
 	{
-		USkeletalMesh* SrcMesh = SrcMeshList[MeshIdx];
-		if( SrcMesh )
+		const FRawStaticIndexBuffer16or32Interface* IndexBuffer = LODData.MultiSizeIndexContainer.GetIndexBuffer();
+		const FPositionVertexBuffer& PositionBuffer = LODData.StaticVertexBuffers.PositionVertexBuffer;
+		for (const FSkelMeshRenderSection& Section : LODData.RenderSections)
 		{
-			if( bNeedsInit )
+			const int32 MaxIndexIdx = FMath::Min<int32>(Section.BaseIndex + Section.NumTriangles * 3, IndexBuffer->Num());
+			for (int32 IndexIdx = Section.BaseIndex; IndexIdx < MaxIndexIdx; IndexIdx++)
 			{
-				// initialize the merged mesh with the first src mesh entry used
-				MergeMesh->SetImportedBounds(SrcMesh->GetImportedBounds());
+				const FVector3f Position = RebaseMatrix.TransformPosition(PositionBuffer.VertexPosition(IndexBuffer->Get(IndexIdx)));
+				Corners.Add(Position);
+				Bounds += Position;
+			}
+		}
 
-				MergeMesh->SetSkelMirrorAxis(SrcMesh->GetSkelMirrorAxis());
-				MergeMesh->SetSkelMirrorFlipAxis(SrcMesh->GetSkelMirrorFlipAxis());
+		const int32 NumTriangles = Corners.Num() / 3;
+		if (NumTriangles == 0)
+		{
+			return;
+		}
 
-				// only initialize once
-				bNeedsInit = false;
-			}
-			else
+		// about one triangle per cell
+		const int32 Resolution = FMath::Clamp(FMath::CeilToInt(FMath::Pow((float)NumTriangles, 1.f / 3.f)), 1, 64);
+		CellSize = FMath::Max(Bounds.GetSize().GetMax() / Resolution, UE_KINDA_SMALL_NUMBER);
+		NumCells = GetCell(Bounds.Max) + FIntVector(1);
+		Cells.SetNum(NumCells.X * NumCells.Y * NumCells.Z);
+
+		for (int32 TriIdx = 0; TriIdx < NumTriangles; TriIdx++)
+		{
+			FBox3f TriangleBounds(ForceInit);
+			TriangleBounds += Corners[TriIdx * 3];
+			TriangleBounds += Corners[TriIdx * 3 + 1];
+			TriangleBounds += Corners[TriIdx * 3 + 2];
+			ForEachCell(TriangleBounds, [this, TriIdx](TArray<int32>& Cell) { Cell.Add(TriIdx); return true; });
+		}
+	}
+
+	FIntVector GetCell(const FVector3f& Position) const
+	{
+		const FVector3f Local = (Position - Bounds.Min) / CellSize;
+		return FIntVector(
+			FMath::Clamp(FMath::FloorToInt(Local.X), 0, FMath::Max(NumCells.X - 1, 0)),
+			FMath::Clamp(FMath::FloorToInt(Local.Y), 0, FMath::Max(NumCells.Y - 1, 0)),
+			FMath::Clamp(FMath::FloorToInt(Local.Z), 0, FMath::Max(NumCells.Z - 1, 0)));
+	}
+
+	/** Calls 'Visitor' on every cell overlapping 'Box' until it returns false. */
+	template<typename VisitorType>
+	bool ForEachCell(const FBox3f& Box, VisitorType&& Visitor)
+	{
+		const FIntVector Min = GetCell(Box.Min);
+		const FIntVector Max = GetCell(Box.Max);
+		for (int32 Z = Min.Z; Z <= Max.Z; Z++)
+		{
+			for (int32 Y = Min.Y; Y <= Max.Y; Y++)
 			{
-				// add bounds
-				MergeMesh->SetImportedBounds(MergeMesh->GetImportedBounds() + SrcMesh->GetImportedBounds());
+				for (int32 X = Min.X; X <= Max.X; X++)
+				{
+					if (!Visitor(Cells[(Z * NumCells.Y + Y) * NumCells.X + X]))
+					{
+						return false;
+					}
+				}
 			}
 		}
+		return true;
 	}
-PRAGMA_ENABLE_DEPRECATION_WARNINGS
-	// Rebuild inverse ref pose matrices.
-	MergeMesh->GetRefBasesInvMatrix().Empty();
-	MergeMesh->CalculateInvRefMatrices();
 
-	return Result;
-}
+	/** Returns true if the segment hits a triangle. */
+	bool Raycast(const FVector3f& Start, const FVector3f& End)
+	{
+		FBox3f SegmentBounds(ForceInit);
+		SegmentBounds += Start;
+		SegmentBounds += End;
+		if (Cells.Num() == 0 || !SegmentBounds.Intersect(Bounds))
+		{
+			return false;
+		}
 
-int32 FJrSkeletalMeshMerge::CalculateLodCount(const TArray<USkeletalMesh*>& SourceMeshList) const
+		const bool bNoHit = ForEachCell(SegmentBounds, [this, &Start, &End](const TArray<int32>& Cell)
+		{
+			for (const int32 TriIdx : Cell)
+			{
+				FVector HitPoint, HitNormal;
+				if (FMath::SegmentTriangleIntersection(FVector(Start), FVector(End),
+					FVector(Corners[TriIdx * 3]), FVector(Corners[TriIdx * 3 + 1]), FVector(Corners[TriIdx * 3 + 2]), HitPoint, HitNormal))
+				{
+					return false;
+				}
+			}
+			return true;
+		});
+		return !bNoHit;
+	}
+};
+
+bool FJrSkeletalMeshMerge::MaskCoveredTriangles(const FMergeSectionInfo& MergeSectionInfo, int32 LODIdx, const TArray<uint32>& InIndices, TArray<uint32>& OutIndices)
 {
-	int32 LodCount = INT_MAX;
+	const int32 MergedLODIdx = LODIdx - StripTopLODs;
+	const USkeletalMesh* MaskedMesh = MergeSectionInfo.SkelMesh;
 
-	for (int32 i = 0, MeshCount = SourceMeshList.Num(); i < MeshCount; ++i)
+	// rules masking this section at this LOD, the covering mesh must be part of the LOD
+	TArray<const FJrPartMaskRule*, TInlineAllocator<4>> Rules;
+	for (const FJrPartMaskRule& Rule : MergeOptions.PartMaskRules)
 	{
-		USkeletalMesh* SourceMesh = SourceMeshList[i];
+		const int32 CoveringMeshIdx = SrcMeshList.Find(Rule.CoveringMesh.Get());
+		if (CoveringMeshIdx != INDEX_NONE && SrcMeshInfo[CoveringMeshIdx].CullLODIdx > MergedLODIdx &&
+			(Rule.MaskTexture || Rule.bRayCastOcclusion) && Rule.MasksMesh(MaskedMesh))
+		{
+			Rules.Add(&Rule);
+		}
+	}
 
-		if (SourceMesh)
+	if (Rules.Num() == 0)
+	{
+		return false;
+	}
+
+	const FSkeletalMeshRenderData* SrcResource = MaskedMesh->GetResourceForRendering();
+	const FSkeletalMeshLODRenderData& SrcLODData = SrcResource->LODRenderData[FMath::Min(LODIdx, SrcResource->LODRenderData.Num() - 1)];
+	const FStaticMeshVertexBuffer& StaticMeshBuffer = SrcLODData.StaticVertexBuffers.StaticMeshVertexBuffer;
+	const uint32 BaseVertexIndex = MergeSectionInfo.Section->BaseVertexIndex;
+	const int32 NumVertices = MergeSectionInfo.Section->NumVertices;
+	// the parts are compared in the merged root space, where the merged vertices end up (same transform as the vertex copy)
+	const FMatrix44f MaskedRebaseMatrix = GetSourceRebaseMatrix(MaskedMesh);
+
+	// 0 = not evaluated yet, 1 = visible, 2 = hidden
+	TArray<uint8> VertexStates;
+	VertexStates.SetNumZeroed(NumVertices);
+	auto IsVertexHidden = [&](uint32 VertIdx)
+	{
+		uint8& State = VertexStates[VertIdx - BaseVertexIndex];
+		if (State == 0)
 		{
-			LodCount = FMath::Min<int32>(LodCount, SourceMesh->GetLODNum());
+			bool bHidden = false;
+			for (const FJrPartMaskRule* Rule : Rules)
+			{
+				if (Rule->MaskTexture && (uint32)Rule->MaskUVChannel < StaticMeshBuffer.GetNumTexCoords())
+				{
+					TSharedPtr<FMaskImage>& MaskImage = MaskImages.FindOrAdd(Rule->MaskTexture.Get());
+					if (!MaskImage)
+					{
+						MaskImage = MakeShared<FMaskImage>(Rule->MaskTexture.Get());
+					}
+					bHidden = MaskImage->IsMasked(StaticMeshBuffer.GetVertexUV(VertIdx, Rule->MaskUVChannel));
+				}
+
+				if (!bHidden && Rule->bRayCastOcclusion)
+				{
+					const FSkeletalMeshRenderData* CoveringResource = Rule->CoveringMesh->GetResourceForRendering();
+					const int32 CoveringLODIdx = FMath::Min(LODIdx, CoveringResource->LODRenderData.Num() - 1);
+					TSharedPtr<FMaskOccluder>& Occluder = MaskOccluders.FindOrAdd(MakeTuple(Rule->CoveringMesh.Get(), CoveringLODIdx));
+					if (!Occluder)
+					{
+						Occluder = MakeShared<FMaskOccluder>(CoveringResource->LODRenderData[CoveringLODIdx], GetSourceRebaseMatrix(Rule->CoveringMesh.Get()));
+					}
+
+					// cast along the normal towards the covering surface, both in the merged root space
+					const FVector3f Position = MaskedRebaseMatrix.TransformPosition(SrcLODData.StaticVertexBuffers.PositionVertexBuffer.VertexPosition(VertIdx));
+					const FVector3f Normal = MaskedRebaseMatrix.TransformVector(FVector3f(StaticMeshBuffer.VertexTangentZ(VertIdx))).GetSafeNormal();
+					bHidden = !Normal.IsZero() && Occluder->Raycast(Position, Position + Normal * Rule->RayCastDistance);
+				}
+
+				if (bHidden)
+				{
+					break;
+				}
+			}
+			State = bHidden ? 2 : 1;
+		}
+		return State == 2;
+	};
+
+	OutIndices.Reset(InIndices.Num());
+	for (int32 Idx = 0; Idx + 2 < InIndices.Num(); Idx += 3)
+	{
+		// keep the triangles that are partially visible
+		if (!IsVertexHidden(InIndices[Idx]) || !IsVertexHidden(InIndices[Idx + 1]) || !IsVertexHidden(InIndices[Idx + 2]))
+		{
+			OutIndices.Append(&InIndices[Idx], 3);
 		}
 	}
 
-	if (LodCount == INT_MAX)
+	if (OutIndices.Num() == 0 && InIndices.Num() > 0)
 	{
-		return -1;
+		// an empty section can't be rendered, keep it whole
+		OutIndices = InIndices;
+		return true;
 	}
 
-	// Decrease the number of LODs we are going to make based on StripTopLODs.
-	// But, make sure there is at least one.
+	// count the vertices no triangle references anymore
+	TBitArray<> UsedVertices(false, NumVertices);
+	TBitArray<> StillUsedVertices(false, NumVertices);
+	for (const uint32 Index : InIndices)
+	{
+		UsedVertices[Index - BaseVertexIndex] = true;
+	}
+	for (const uint32 Index : OutIndices)
+	{
+		StillUsedVertices[Index - BaseVertexIndex] = true;
+	}
 
-	LodCount -= StripTopLODs;
-	LodCount = FMath::Max(LodCount, 1);
-	
-	return LodCount;
+	FJrLODMaskingStats& Stats = MaskingStats[MergedLODIdx];
+	Stats.RemovedTriangles += (InIndices.Num() - OutIndices.Num()) / 3;
+	Stats.RemovedVertices += UsedVertices.CountSetBits() - StillUsedVertices.CountSetBits();
+	return true;
 }
 
-void FJrSkeletalMeshMerge::BuildReferenceSkeleton(const TArray<USkeletalMesh*>& SourceMeshList, FReferenceSkeleton& RefSkeleton, const USkeleton* SkeletonAsset)
+void FJrSkeletalMeshMerge::BuildReferenceSkeleton(const TArray<USkeletalMesh*>& SourceMeshList, FReferenceSkeleton& RefSkeleton, const USkeleton* SkeletonAsset) const
 {
 	RefSkeleton.Empty();
 
@@ -910,14 +2735,25 @@ void FJrSkeletalMeshMerge::BuildReferenceSkeleton(const TArray<USkeletalMesh*>&
 		if (RefSkeleton.GetRawBoneNum() == 0)
 		{
 			RefSkeleton = SourceMesh->GetRefSkeleton();
+			for (int32 i = 0; i < RefSkeleton.GetRawBoneNum(); ++i)
+			{
+				const FName BoneName = RefSkeleton.GetBoneName(i);
+				const FName MergedBoneName = GetSourceBoneName(SourceMesh, i);
+				if (MergedBoneName != BoneName)
+				{
+					RefSkelModifier.Rename(BoneName, MergedBoneName);
+				}
+			}
 			continue;
 		}
 
 		// For subsequent meshes, add any missing bones.
+		// The root is shared, unless BoneNameRemaps renamed it: the renamed root is then added under the merged root.
 
-		for (int32 i = 1; i < SourceMesh->GetRefSkeleton().GetRawBoneNum(); ++i)
+		const int32 FirstBoneIndex = GetSourceBoneName(SourceMesh, 0) != SourceMesh->GetRefSkeleton().GetBoneName(0) ? 0 : 1;
+		for (int32 i = FirstBoneIndex; i < SourceMesh->GetRefSkeleton().GetRawBoneNum(); ++i)
 		{
-			FName SourceBoneName = SourceMesh->GetRefSkeleton().GetBoneName(i);
+			FName SourceBoneName = GetSourceBoneName(SourceMesh, i);
 			int32 TargetBoneIndex = RefSkeleton.FindRawBoneIndex(SourceBoneName);
 
 			// If the source bone is present in the new RefSkeleton, we skip it.
@@ -930,8 +2766,7 @@ void FJrSkeletalMeshMerge::BuildReferenceSkeleton(const TArray<USkeletalMesh*>&
 			// Add the source bone to the RefSkeleton.
 
 			int32 SourceParentIndex = SourceMesh->GetRefSkeleton().GetParentIndex(i);
-			FName SourceParentName = SourceMesh->GetRefSkeleton().GetBoneName(SourceParentIndex);
-			int32 TargetParentIndex = RefSkeleton.FindRawBoneIndex(SourceParentName);
+			int32 TargetParentIndex = SourceParentIndex != INDEX_NONE ? RefSkeleton.FindRawBoneIndex(GetSourceBoneName(SourceMesh, SourceParentIndex)) : 0;
 
 			if (TargetParentIndex == INDEX_NONE)
 			{
@@ -940,12 +2775,194 @@ void FJrSkeletalMeshMerge::BuildReferenceSkeleton(const TArray<USkeletalMesh*>&
 
 			FMeshBoneInfo MeshBoneInfo = SourceMesh->GetRefSkeleton().GetRefBoneInfo()[i];
 			MeshBoneInfo.ParentIndex = TargetParentIndex;
+			MeshBoneInfo.Name = SourceBoneName;
+#if WITH_EDITORONLY_DATA
+			MeshBoneInfo.ExportName = SourceBoneName.ToString();
+#endif
 
 			RefSkelModifier.Add(MeshBoneInfo, SourceMesh->GetRefSkeleton().GetRefBonePose()[i]);
 		}
 	}
 }
 
+FName FJrSkeletalMeshMerge::GetSourceBoneName(const USkeletalMesh* SrcMesh, int32 BoneIndex) const
+{
+	const FName BoneName = SrcMesh->GetRefSkeleton().GetBoneName(BoneIndex);
+	return MergeOptions.BoneNameRemaps.Num() > 0 ? MergeOptions.RemapBoneName(SrcMesh->GetSkeleton(), BoneName) : BoneName;
+}
+
+bool FJrSkeletalMeshMerge::CheckRemappedBones(const FReferenceSkeleton& RefSkeleton) const
+{
+	bool bResolved = true;
+	for (const USkeletalMesh* SrcMesh : SrcMeshList)
+	{
+		if (!SrcMesh || MergeOptions.BoneNameRemaps.Num() == 0)
+		{
+			continue;
+		}
+
+		const FReferenceSkeleton& SrcRefSkeleton = SrcMesh->GetRefSkeleton();
+		for (int32 BoneIndex = 0; BoneIndex < SrcRefSkeleton.GetRawBoneNum(); BoneIndex++)
+		{
+			const FName MergedBoneName = GetSourceBoneName(SrcMesh, BoneIndex);
+			if (MergedBoneName == SrcRefSkeleton.GetBoneName(BoneIndex))
+			{
+				continue;
+			}
+
+			// the renamed bone must exist, under the merged bone of its source parent
+			const int32 MergedBoneIndex = RefSkeleton.FindRawBoneIndex(MergedBoneName);
+			const int32 SrcParentIndex = SrcRefSkeleton.GetParentIndex(BoneIndex);
+			const int32 MergedParentIndex = MergedBoneIndex != INDEX_NONE ? RefSkeleton.GetParentIndex(MergedBoneIndex) : INDEX_NONE;
+			const bool bParentResolved = SrcParentIndex == INDEX_NONE ||
+				(MergedParentIndex != INDEX_NONE && RefSkeleton.GetBoneName(MergedParentIndex) == GetSourceBoneName(SrcMesh, SrcParentIndex));
+			if (MergedBoneIndex == INDEX_NONE || !bParentResolved)
+			{
+				UE_LOG(LogSkeletalMesh, Error, TEXT("FJrSkeletalMeshMerge: bone %s of %s is renamed %s, which doesn't resolve to its bone in the merged skeleton."),
+					*SrcRefSkeleton.GetBoneName(BoneIndex).ToString(), *SrcMesh->GetName(), *MergedBoneName.ToString());
+				bResolved = false;
+			}
+		}
+	}
+	return bResolved;
+}
+
+void FJrSkeletalMeshMerge::PruneUnusedBones(FReferenceSkeleton& RefSkeleton, bool bFromBoneMaps) const
+{
+	const int32 NumBones = RefSkeleton.GetRawBoneNum();
+	if (NumBones == 0)
+	{
+		return;
+	}
+
+	TBitArray<> KeepBones(false, NumBones);
+	auto KeepBone = [&RefSkeleton, &KeepBones](FName BoneName)
+	{
+		const int32 BoneIndex = RefSkeleton.FindRawBoneIndex(BoneName);
+		if (BoneIndex != INDEX_NONE)
+		{
+			KeepBones[BoneIndex] = true;
+		}
+	};
+	auto KeepSkeletonBones = [this, &KeepBone](const USkeleton* Skeleton)
+	{
+		if (Skeleton)
+		{
+			for (const USkeletalMeshSocket* Socket : Skeleton->Sockets)
+			{
+				KeepBone(MergeOptions.RemapBoneName(Skeleton, Socket->BoneName));
+			}
+			for (const FVirtualBone& VirtualBone : Skeleton->GetVirtualBones())
+			{
+				KeepBone(MergeOptions.RemapBoneName(Skeleton, VirtualBone.SourceBoneName));
+				KeepBone(MergeOptions.RemapBoneName(Skeleton, VirtualBone.TargetBoneName));
+			}
+		}
+	};
+
+	KeepBones[0] = true;
+	for (const FName& BoneName : MergeOptions.BonesToKeep)
+	{
+		KeepBone(BoneName);
+	}
+	KeepSkeletonBones(MergeMesh->GetSkeleton());
+
+	for (const USkeletalMesh* SrcMesh : SrcMeshList)
+	{
+		if (!SrcMesh)
+		{
+			continue;
+		}
+
+		for (const USkeletalMeshSocket* Socket : SrcMesh->GetMeshOnlySocketList())
+		{
+			KeepBone(MergeOptions.RemapBoneName(SrcMesh->GetSkeleton(), Socket->BoneName));
+		}
+		KeepSkeletonBones(SrcMesh->GetSkeleton());
+
+		// bones actually weighted by a vertex, in any LOD
+		for (const FSkeletalMeshLODRenderData& SrcLODData : SrcMesh->GetResourceForRendering()->LODRenderData)
+		{
+			const FSkinWeightVertexBuffer* SkinWeights = SrcLODData.GetSkinWeightVertexBuffer();
+			for (const FSkelMeshRenderSection& Section : SrcLODData.RenderSections)
+			{
+				if (bFromBoneMaps)
+				{
+					for (const FBoneIndexType BoneIndex : Section.BoneMap)
+					{
+						KeepBone(GetSourceBoneName(SrcMesh, BoneIndex));
+					}
+					continue;
+				}
+
+				TBitArray<> UsedBoneMapEntries(false, Section.BoneMap.Num());
+				const uint32 MaxVertIdx = FMath::Min<uint32>(Section.BaseVertexIndex + Section.NumVertices, SkinWeights->GetNumVertices());
+				for (uint32 VertIdx = Section.BaseVertexIndex; VertIdx < MaxVertIdx; VertIdx++)
+				{
+					const FSkinWeightInfo Weights = SkinWeights->GetVertexSkinWeights(VertIdx);
+					for (int32 Influence = 0; Influence < MAX_TOTAL_INFLUENCES; Influence++)
+					{
+						if (Weights.InfluenceWeights[Influence] > 0 && UsedBoneMapEntries.IsValidIndex(Weights.InfluenceBones[Influence]))
+						{
+							UsedBoneMapEntries[Weights.InfluenceBones[Influence]] = true;
+						}
+					}
+				}
+
+				for (TConstSetBitIterator<> It(UsedBoneMapEntries); It; ++It)
+				{
+					KeepBone(GetSourceBoneName(SrcMesh, Section.BoneMap[It.GetIndex()]));
+				}
+			}
+
+			if (MergeOptions.bKeepRequiredBones)
+			{
+				for (const FBoneIndexType RequiredBone : SrcLODData.RequiredBones)
+				{
+					KeepBone(GetSourceBoneName(SrcMesh, RequiredBone));
+				}
+			}
+		}
+	}
+
+	// keep the ancestors of the kept bones (parents always come before their children)
+	for (int32 BoneIndex = NumBones - 1; BoneIndex > 0; --BoneIndex)
+	{
+		if (KeepBones[BoneIndex])
+		{
+			KeepBones[RefSkeleton.GetRawParentIndex(BoneIndex)] = true;
+		}
+	}
+
+	const int32 NumKeptBones = KeepBones.CountSetBits();
+	if (NumKeptBones == NumBones)
+	{
+		return;
+	}
+
+	// rebuild the skeleton with the kept bones only, remapping the parent indices
+	FReferenceSkeleton PrunedRefSkeleton;
+	{
+		FReferenceSkeletonModifier RefSkelModifier(PrunedRefSkeleton, MergeMesh->GetSkeleton());
+		TArray<int32> OldToNewBoneIndex;
+		OldToNewBoneIndex.Init(INDEX_NONE, NumBones);
+
+		int32 NumAddedBones = 0;
+		for (TConstSetBitIterator<> It(KeepBones); It; ++It)
+		{
+			const int32 BoneIndex = It.GetIndex();
+			FMeshBoneInfo MeshBoneInfo = RefSkeleton.GetRawRefBoneInfo()[BoneIndex];
+			MeshBoneInfo.ParentIndex = BoneIndex > 0 ? OldToNewBoneIndex[MeshBoneInfo.ParentIndex] : INDEX_NONE;
+
+			RefSkelModifier.Add(MeshBoneInfo, RefSkeleton.GetRawRefBonePose()[BoneIndex]);
+			OldToNewBoneIndex[BoneIndex] = NumAddedBones++;
+		}
+	}
+
+	UE_LOG(LogSkeletalMesh, Log, TEXT("SkeletalMeshMerge: pruned %d unused bones (%d -> %d)"), NumBones - NumKeptBones, NumBones, NumKeptBones);
+	RefSkeleton = PrunedRefSkeleton;
+}
+
 void FJrSkeletalMeshMerge::OverrideReferenceSkeletonPose(const TArray<FJrRefPoseOverride>& PoseOverrides, FReferenceSkeleton& TargetSkeleton, const USkeleton* SkeletonAsset)
 {
 	for (int32 i = 0, PoseMax = PoseOverrides.Num(); i < PoseMax; ++i)
@@ -1014,7 +3031,7 @@ void FJrSkeletalMeshMerge::ReleaseResources(int32 Slack)
 	MergeMesh->GetMaterials().Empty();
 }
 
-bool FJrSkeletalMeshMerge::AddSocket(const USkeletalMeshSocket* NewSocket, bool bIsSkeletonSocket)
+bool FJrSkeletalMeshMerge::AddSocket(const USkeletalMeshSocket* NewSocket, bool bIsSkeletonSocket, const USkeleton* SourceSkeleton)
 {
 	TArray<USkeletalMeshSocket*>& MergeMeshSockets = MergeMesh->GetMeshOnlySocketList();
 
@@ -1040,16 +3057,17 @@ bool FJrSkeletalMeshMerge::AddSocket(const USkeletalMeshSocket* NewSocket, bool
 	}
 
 	USkeletalMeshSocket* NewSocketDuplicate = CastChecked<USkeletalMeshSocket>(StaticDuplicateObject(NewSocket, MergeMesh));
+	NewSocketDuplicate->BoneName = MergeOptions.RemapBoneName(SourceSkeleton, NewSocket->BoneName);
 	MergeMeshSockets.Add(NewSocketDuplicate);
 
 	return true;
 }
 
-void FJrSkeletalMeshMerge::AddSockets(const TArray<USkeletalMeshSocket*>& NewSockets, bool bAreSkeletonSockets)
+void FJrSkeletalMeshMerge::AddSockets(const TArray<USkeletalMeshSocket*>& NewSockets, bool bAreSkeletonSockets, const USkeleton* SourceSkeleton)
 {
 	for (USkeletalMeshSocket* NewSocket : NewSockets)
 	{
-		AddSocket(NewSocket, bAreSkeletonSockets);
+		AddSocket(NewSocket, bAreSkeletonSockets, SourceSkeleton);
 	}
 }
 
@@ -1065,7 +3083,7 @@ void FJrSkeletalMeshMerge::BuildSockets(const TArray<USkeletalMesh*>& SourceMesh
 		if (SourceMesh)
 		{
 			const TArray<USkeletalMeshSocket*>& NewMeshSocketList = SourceMesh->GetMeshOnlySocketList();
-			AddSockets(NewMeshSocketList, false);
+			AddSockets(NewMeshSocketList, false, SourceMesh->GetSkeleton());
 		}
 	}
 
@@ -1076,13 +3094,19 @@ void FJrSkeletalMeshMerge::BuildSockets(const TArray<USkeletalMesh*>& SourceMesh
 		if (SourceMesh && SourceMesh->GetSkeleton())
 		{
 			const TArray<USkeletalMeshSocket*>& NewSkeletonSocketList = SourceMesh->GetSkeleton()->Sockets;
-			AddSockets(NewSkeletonSocketList, true);
+			AddSockets(NewSkeletonSocketList, true, SourceMesh->GetSkeleton());
 		}
 	}
 
 	MergeMesh->RebuildSocketMap();
 }
 
+void FJrSkeletalMeshMerge::BuildMergedSockets()
+{
+	check(IsInGameThread());
+	BuildSockets(SrcMeshList);
+}
+
 void FJrSkeletalMeshMerge::OverrideSocket(const USkeletalMeshSocket* SourceSocket)
 {
 	TArray<USkeletalMeshSocket*>& SocketList = MergeMesh->GetMeshOnlySocketList();
@@ -1,6 +1,7 @@
 // Copyright Epic Games, Inc. All Rights Reserved.
 
 #include "JrSkeletalMeshMerger.h"
+#include "JrHierarchicalMerge.h"
 
 #define LOCTEXT_NAMESPACE "FJrSkeletalMeshMergerModule"
 
@@ -13,6 +14,9 @@ void FJrSkeletalMeshMergerModule::ShutdownModule()
 {
 	// This function may be called during shutdown to clean up your module.  For modules that support dynamic reloading,
 	// we call this function before unloading the module.
+
+	// the cached intermediate meshes must be released while the UObject system is still alive
+	FJrHierarchicalMerge::ClearSubgroupCache();
 }
 
 #undef LOCTEXT_NAMESPACE
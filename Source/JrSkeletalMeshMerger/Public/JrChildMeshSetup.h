@@ -0,0 +1,49 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class USkeletalMesh;
+
+/**
+* How a child mesh left out of the merge is set up in the Blueprint generated after merging.
+*/
+enum class EJrChildMeshMode : uint8
+{
+	/** Kept as it is, with its own animation. */
+	Independent,
+	/** Skeletal mesh component following the merged mesh pose (SetLeaderPoseComponent), no animation of its own. */
+	LeaderPose,
+	/** Static mesh component attached to the merged mesh bone that skins every vertex. */
+	StaticOnBone,
+};
+
+/**
+* Checks of the child meshes of UJrSkeletalMergingLibrary::CreateBlueprintAssetAfterMerging.
+*
+* A leader pose follower copies the component space bone transforms of the leader by bone name, so a child can follow the merged
+* mesh when every bone skinning it exists in the merged skeleton with the same reference pose. A child skinned by a single bone (helmet, weapon holster...)
+* doesn't need skinning at all: a static mesh attached to that bone draws the same thing.
+*/
+class JRSKELETALMESHMERGER_API FJrChildMeshSetup
+{
+public:
+	/**
+	* Returns how 'ChildMesh' can be drawn next to 'LeaderMesh'.
+	* @param OutBoneName - [out] bone of the static mesh for StaticOnBone
+	*/
+	static EJrChildMeshMode Classify(const USkeletalMesh* ChildMesh, const USkeletalMesh* LeaderMesh, FName& OutBoneName);
+
+	/**
+	* Returns whether every bone skinning 'ChildMesh' exists in the reference skeleton of 'LeaderMesh' with the same component space reference pose.
+	* @param Tolerance - largest difference of the translation (cm), rotation (quaternion components) and scale of a bone
+	*/
+	static bool CanFollowLeaderPose(const USkeletalMesh* ChildMesh, const USkeletalMesh* LeaderMesh, float Tolerance = 0.01f);
+
+	/** Returns the bone skinning every vertex of every LOD with its full weight, NAME_None if the mesh has several bones, morph targets or cloth. */
+	static FName FindRigidBone(const USkeletalMesh* Mesh);
+
+	/** Returns the transform of a static mesh converted from 'Mesh' relative to its rigid bone 'BoneName', so it matches the skinned mesh. */
+	static FTransform GetRigidMeshRelativeTransform(const USkeletalMesh* Mesh, FName BoneName);
+};
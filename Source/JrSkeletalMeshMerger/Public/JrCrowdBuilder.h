@@ -0,0 +1,133 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "JrCrowdBuilder.generated.h"
+
+class AActor;
+class UInstancedStaticMeshComponent;
+class USkeletalMesh;
+class UStaticMesh;
+
+/**
+* AnimToTexture playback of a crowd instance, written to its per-instance custom data (see FJrCrowdBuilder).
+*/
+USTRUCT(BlueprintType)
+struct JRSKELETALMESHMERGER_API FJrCrowdAnimation
+{
+	GENERATED_BODY()
+
+	/** Animation of the AnimToTexture data asset. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Crowd", meta = (ClampMin = "0"))
+	int32 AnimationIndex = 0;
+
+	/** Frames added to the animation time, so instances sharing an animation don't move in sync. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Crowd")
+	float FrameOffset = 0.f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Crowd")
+	float PlayRate = 1.f;
+};
+
+/**
+* One agent of an instanced crowd.
+*/
+USTRUCT(BlueprintType)
+struct JRSKELETALMESHMERGER_API FJrCrowdInstance
+{
+	GENERATED_BODY()
+
+	/** Static mesh of the agent, e.g. the AnimToTexture static mesh of a merged character. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Crowd")
+	TObjectPtr<UStaticMesh> StaticMesh = nullptr;
+
+	/** Merged character drawn when StaticMesh is null, converted to a static mesh under FJrCrowdSettings::ConvertedMeshPath. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Crowd")
+	TObjectPtr<USkeletalMesh> SkeletalMesh = nullptr;
+
+	/** World transform of the agent. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Crowd")
+	FTransform Transform;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Crowd")
+	FJrCrowdAnimation Animation;
+};
+
+USTRUCT(BlueprintType)
+struct JRSKELETALMESHMERGER_API FJrCrowdSettings
+{
+	GENERATED_BODY()
+
+	/** HISM components (per cluster culling and LOD) instead of ISM components. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Crowd")
+	bool bUseHierarchicalInstancing = true;
+
+	/** Write FJrCrowdInstance::Animation to the per-instance custom data. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Crowd")
+	bool bWriteAnimationCustomData = true;
+
+	/** Package path of the static meshes converted from FJrCrowdInstance::SkeletalMesh (e.g. /Game/Crowd). */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Crowd")
+	FString ConvertedMeshPath = TEXT("/Game/JrCrowd");
+
+	/** Cull distances of the instances, 0 never culls. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Crowd", meta = (ClampMin = "0"))
+	int32 InstanceStartCullDistance = 0;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Crowd", meta = (ClampMin = "0"))
+	int32 InstanceEndCullDistance = 0;
+};
+
+/**
+* Result of FJrCrowdBuilder::Build and UJrSkeletalMergingLibrary::BuildInstancedCrowd.
+*/
+USTRUCT(BlueprintType)
+struct JRSKELETALMESHMERGER_API FJrCrowdBuildResult
+{
+	GENERATED_BODY()
+
+	/** One component per static mesh. */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Crowd")
+	TArray<TObjectPtr<UInstancedStaticMeshComponent>> Components;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Crowd")
+	int32 NumInstances = 0;
+
+	/** Instances without a mesh, or whose skeletal mesh could not be converted. */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Crowd")
+	int32 NumSkippedInstances = 0;
+
+	/** Draws of the crowd at LOD 0 (one per component and mesh section, before culling and shadows). */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Crowd")
+	int32 NumDrawCalls = 0;
+
+	/** Draws of the same crowd as one component per agent. */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Crowd")
+	int32 NumDrawCallsWithoutInstancing = 0;
+};
+
+/**
+* Builds instanced crowds, the native counterpart of the EUW_CreateISM widget.
+*
+* The agents are grouped by static mesh, each group is one ISM / HISM component of the owner actor whose instances are added in one batch.
+* With bWriteAnimationCustomData the components have 3 custom data floats per instance, read by the AnimToTexture material
+* through PerInstanceCustomData: 0 animation index, 1 frame offset, 2 play rate.
+*/
+class JRSKELETALMESHMERGER_API FJrCrowdBuilder
+{
+public:
+	/** Custom data float of each animation parameter. */
+	static constexpr int32 AnimationIndexCustomData = 0;
+	static constexpr int32 FrameOffsetCustomData = 1;
+	static constexpr int32 PlayRateCustomData = 2;
+	static constexpr int32 NumAnimationCustomData = 3;
+
+	/**
+	* Adds the crowd components to 'Owner'.
+	* @param Owner - actor owning the components, they are attached to its root component
+	* @param Instances - agents of the crowd
+	* @param Settings - component type, custom data and mesh conversion settings
+	*/
+	static FJrCrowdBuildResult Build(AActor* Owner, const TArray<FJrCrowdInstance>& Instances, const FJrCrowdSettings& Settings);
+};
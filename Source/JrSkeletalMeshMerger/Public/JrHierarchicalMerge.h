@@ -0,0 +1,64 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "JrSkeletalMeshMergeTypes.h"
+#include "UObject/StrongObjectPtr.h"
+
+struct FSkeletalMeshMergeParams;
+class USkeletalMesh;
+class USkeleton;
+
+/**
+* Intermediate meshes of a hierarchical merge, to be merged by the final merge.
+*/
+struct JRSKELETALMESHMERGER_API FJrHierarchicalMergeResult
+{
+	/** Meshes of the final merge, in source order. */
+	TArray<TStrongObjectPtr<USkeletalMesh>> Meshes;
+
+	/** Per mesh, source mesh index (X) and source vertex index (Y) of each LOD 0 vertex. Empty if bRecordVertexProvenance is off. */
+	TArray<TArray<FIntPoint>> VertexProvenance;
+
+	/** Options of the final merge: the source LOD stripping, UV transforms and LOD synthesis are already applied to the intermediates. */
+	FJrSkeletalMeshMergeOptions FinalOptions;
+
+	/** Intermediate meshes built, and reused from the subgroup cache. */
+	int32 NumMerges = 0;
+	int32 CacheHits = 0;
+};
+
+/**
+* Tree reduction of a merge (bHierarchicalMerge).
+*
+* The sources are split in consecutive groups of HierarchicalGroupSize meshes which are merged in parallel, without render
+* resources, into intermediate meshes; the intermediates are grouped again until at most HierarchicalGroupSize are left for the final merge.
+* Merged sections keep their material order and the part order inside a section, so the final mesh matches the flat merge.
+* The per-mesh steps run on the leaf groups, the per-merged-mesh steps (pruning, LOD bone reduction, position error report) on the final merge.
+*/
+class JRSKELETALMESHMERGER_API FJrHierarchicalMerge
+{
+public:
+	/**
+	* Returns whether a merge of 'NumSources' meshes is split in groups: the option is on, there are more sources than a group,
+	* and nothing needs to see every part at once (part mask rules, part culling, forced section mappings).
+	*/
+	static bool CanMergeHierarchically(const FSkeletalMeshMergeParams& Params, const FJrSkeletalMeshMergeOptions& Options, int32 NumSources);
+
+	/**
+	* Merges the groups of every level but the last one.
+	* @param Params - merge params, for the source LOD stripping, UV transforms and cache keys
+	* @param SourceMeshes - source meshes as given by the caller, used by the cache keys
+	* @param MeshesToMerge - meshes to merge, 'SourceMeshes' with the duplicated entries
+	* @param Options - merge options of the whole merge
+	* @param Skeleton - skeleton asset of the intermediate meshes
+	* @param OutResult - [out] meshes and options of the final merge
+	* @return false if an intermediate merge failed
+	*/
+	static bool MergeSubgroups(const FSkeletalMeshMergeParams& Params, const TArray<USkeletalMesh*>& SourceMeshes, const TArray<USkeletalMesh*>& MeshesToMerge,
+		const FJrSkeletalMeshMergeOptions& Options, USkeleton* Skeleton, FJrHierarchicalMergeResult& OutResult);
+
+	/** Releases the intermediate meshes kept by bCacheSubgroups. */
+	static void ClearSubgroupCache();
+};
@@ -0,0 +1,170 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "JrMergeBenchmark.generated.h"
+
+class UMaterialInterface;
+class USkeletalMesh;
+
+/**
+* Input sizes swept by FJrMergeBenchmark::Run.
+* Each axis is swept on its own while the two others stay at their baseline value.
+*/
+USTRUCT(BlueprintType)
+struct JRSKELETALMESHMERGER_API FJrMergeBenchmarkSettings
+{
+	GENERATED_BODY()
+
+	/** Numbers of parts to merge. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Benchmark")
+	TArray<int32> PartCounts = { 2, 4, 8, 16, 32, 64, 128, 256 };
+
+	/** Numbers of bones of the merged skeleton, half are shared by every part and half are unique to a part. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Benchmark")
+	TArray<int32> BoneCounts = { 64, 128, 256, 512, 1024, 2048 };
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Benchmark")
+	TArray<int32> SectionCounts = { 1, 2, 4, 8 };
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Benchmark")
+	int32 BaselineParts = 16;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Benchmark")
+	int32 BaselineBones = 256;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Benchmark")
+	int32 BaselineSections = 2;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Benchmark", meta = (ClampMin = "3"))
+	int32 VerticesPerSection = 512;
+
+	/** Materials shared by the part sections, sections with the same material end up in the same merged section. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Benchmark", meta = (ClampMin = "1"))
+	int32 NumMaterials = 8;
+
+	/** Merges per sample, the fastest one is kept. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Benchmark", meta = (ClampMin = "1"))
+	int32 Repetitions = 3;
+
+	/** An axis fails when the merge time grows faster than InputSize^MaxScalingExponent. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Benchmark")
+	float MaxScalingExponent = 1.3f;
+
+	/** Writes the samples to Saved/JrMergeBenchmark as a CSV file. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Benchmark")
+	bool bWriteCSV = true;
+};
+
+/**
+* One benchmarked merge.
+*/
+USTRUCT(BlueprintType)
+struct JRSKELETALMESHMERGER_API FJrMergeBenchmarkSample
+{
+	GENERATED_BODY()
+
+	/** Swept axis: Parts, Bones or Sections. */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Benchmark")
+	FName Axis;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Benchmark")
+	int32 Parts = 0;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Benchmark")
+	int32 Bones = 0;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Benchmark")
+	int32 SectionsPerPart = 0;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Benchmark")
+	int32 InputVertices = 0;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Benchmark")
+	int32 MergedSections = 0;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Benchmark")
+	int32 MergedBones = 0;
+
+	/** Fastest DoMerge time of the repetitions. */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Benchmark")
+	float MergeMilliseconds = 0.f;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Benchmark")
+	float SkeletonMilliseconds = 0.f;
+
+	/**
+	 * Largest growth of the used physical memory between the start and the end of a merge, i.e. what the merged mesh keeps.
+	 * Allocations freed before the merge returns are not seen, this is not the transient peak of the merge.
+	 */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Benchmark")
+	int64 RetainedMemoryBytes = 0;
+};
+
+/**
+* Fitted growth of the merge time along one axis.
+*/
+USTRUCT(BlueprintType)
+struct JRSKELETALMESHMERGER_API FJrMergeScalingResult
+{
+	GENERATED_BODY()
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Benchmark")
+	FName Axis;
+
+	/** Slope of log(time) over log(input size): 1 is linear, 2 quadratic. */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Benchmark")
+	float TimeExponent = 0.f;
+
+	/** Same slope for RetainedMemoryBytes. */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Benchmark")
+	float MemoryExponent = 0.f;
+
+	/** TimeExponent is above MaxScalingExponent. */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Benchmark")
+	bool bSuperlinear = false;
+};
+
+/**
+* Result of FJrMergeBenchmark::Run.
+*/
+USTRUCT(BlueprintType)
+struct JRSKELETALMESHMERGER_API FJrMergeBenchmarkReport
+{
+	GENERATED_BODY()
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Benchmark")
+	TArray<FJrMergeBenchmarkSample> Samples;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Benchmark")
+	TArray<FJrMergeScalingResult> Scaling;
+
+	/** No axis scales superlinearly. */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Benchmark")
+	bool bPassed = true;
+
+	/** Written CSV file, empty if bWriteCSV is off. */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Benchmark")
+	FString CSVFile;
+};
+
+/**
+* Measures how FJrSkeletalMeshMerge scales with the number of parts, bones and sections.
+* The parts are generated in memory (render data only, nothing is saved) so the benchmark runs in any project.
+*/
+class JRSKELETALMESHMERGER_API FJrMergeBenchmark
+{
+public:
+	static FJrMergeBenchmarkReport Run(const FJrMergeBenchmarkSettings& InSettings);
+
+private:
+	/** Builds a single LOD part skinned to 'NumSharedBones' common bones and 'NumUniqueBones' bones of its own. */
+	static USkeletalMesh* CreatePart(int32 PartIdx, int32 NumSharedBones, int32 NumUniqueBones, int32 NumSections, int32 VerticesPerSection, const TArray<UMaterialInterface*>& Materials);
+
+	/** Merges a generated set of parts 'Repetitions' times. */
+	static FJrMergeBenchmarkSample MeasureMerge(FName Axis, int32 NumParts, int32 NumBones, int32 NumSections, const FJrMergeBenchmarkSettings& Settings, const TArray<UMaterialInterface*>& Materials);
+
+	/** Least squares slope of log(Y) over log(X). */
+	static float FitExponent(const TArray<double>& X, const TArray<double>& Y);
+};
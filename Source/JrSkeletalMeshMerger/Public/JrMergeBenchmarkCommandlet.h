@@ -0,0 +1,23 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "JrMergeBenchmarkCommandlet.generated.h"
+
+/**
+* Runs the merge scaling benchmark from the command line, for automated regression checks.
+* UnrealEditor-Cmd <Project> -run=JrMergeBenchmark [-Parts=2,4,8] [-Bones=64,128] [-Sections=1,2] [-Vertices=512] [-Repetitions=3] [-MaxExponent=1.3]
+* Returns 1 if the merge time of an axis grows superlinearly.
+*/
+UCLASS()
+class UJrMergeBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UJrMergeBenchmarkCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
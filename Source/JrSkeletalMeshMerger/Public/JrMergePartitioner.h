@@ -0,0 +1,107 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "JrMergePartitioner.generated.h"
+
+struct FJrSkeletalMeshMergeOptions;
+struct FSkeletalMeshMergeParams;
+class USkeletalMesh;
+
+/**
+* Limits of a single merged mesh, measured on merged LOD 0. 0 disables a limit.
+*/
+USTRUCT(BlueprintType)
+struct JRSKELETALMESHMERGER_API FJrMergeBudget
+{
+	GENERATED_BODY()
+
+	/** Vertices of a merged mesh (platform vertex budget). */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Budget", meta = (ClampMin = "0"))
+	int32 MaxVertices = 0;
+
+	/** Bones of a merged reference skeleton. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Budget", meta = (ClampMin = "0"))
+	int32 MaxBones = 0;
+
+	/** Bones of a merged section (GPU skinning bone limit of the target platforms). Parts sharing a material are drawn by the same section. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Budget", meta = (ClampMin = "0"))
+	int32 MaxSectionBones = 0;
+
+	/** Keep every merged mesh within 16-bit indices. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Budget")
+	bool bFitIn16BitIndices = true;
+};
+
+/**
+* Sources merged into one mesh of a partitioned merge.
+*/
+USTRUCT(BlueprintType)
+struct JRSKELETALMESHMERGER_API FJrMergePartition
+{
+	GENERATED_BODY()
+
+	/** Merged mesh of the partition, the source mesh itself when the partition has a single source. Null for a plan. */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Partition")
+	TObjectPtr<USkeletalMesh> Mesh = nullptr;
+
+	/** Indices of the partition sources in FSkeletalMeshMergeParams::MeshesToMerge, in merge order. */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Partition")
+	TArray<int32> SourceIndices;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Partition")
+	int32 NumVertices = 0;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Partition")
+	int32 NumBones = 0;
+
+	/** Bones of the largest merged section. */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Partition")
+	int32 MaxSectionBones = 0;
+
+	/** False if a single source is already over the budget. */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Partition")
+	bool bWithinBudget = true;
+};
+
+/**
+* Result of FJrMergePartitioner::Partition and UJrSkeletalMergingLibrary::MergeMeshesWithinBudget.
+*
+* Each partition is drawn by its own skeletal mesh component. The first partition holds the first source (the body):
+* its component is the leader pose component of the others, which share its skeleton asset.
+*/
+USTRUCT(BlueprintType)
+struct JRSKELETALMESHMERGER_API FJrMergePartitionResult
+{
+	GENERATED_BODY()
+
+	/** Partitions ordered by their first source. */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Partition")
+	TArray<FJrMergePartition> Partitions;
+
+	/** Partition of each entry of MeshesToMerge, INDEX_NONE for null entries. */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Partition")
+	TArray<int32> SourcePartitions;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Partition")
+	bool bWithinBudget = true;
+};
+
+/**
+* Splits a merge that goes over a budget into several merged meshes.
+*
+* Sources sharing a material (directly or through other sources) form a cluster that stays in one merged mesh, so each material
+* is still drawn once. The clusters are then bin-packed, largest first, into the fewest merged meshes within the budget.
+* A cluster over the budget on its own is split by source.
+*/
+class JRSKELETALMESHMERGER_API FJrMergePartitioner
+{
+public:
+	/**
+	* Plans the partitions of a merge, nothing is merged (the partition meshes are null).
+	* Vertices and sections are measured on the source LOD StripTopLODS; bones follow the reference skeleton union of the merge,
+	* or only the skinned bones and their ancestors with bPruneUnusedBones.
+	*/
+	static FJrMergePartitionResult Partition(const FSkeletalMeshMergeParams& Params, const FJrSkeletalMeshMergeOptions& Options, const FJrMergeBudget& Budget);
+};
@@ -0,0 +1,83 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "JrMergeValidator.generated.h"
+
+class FSkeletalMeshLODRenderData;
+class UAnimSequence;
+class USkeletalMesh;
+
+/**
+* Vertex position error of one merged part.
+*/
+USTRUCT(BlueprintType)
+struct JRSKELETALMESHMERGER_API FJrPartValidationResult
+{
+	GENERATED_BODY()
+
+	/** Source mesh of the part. */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Validation")
+	TObjectPtr<USkeletalMesh> Part = nullptr;
+
+	/** Number of merged LOD 0 vertices coming from the part. */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Validation")
+	int32 NumVertices = 0;
+
+	/** Largest distance between a merged vertex and the same vertex on the part, over every sampled frame. */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Validation")
+	float MaxError = 0.f;
+
+	/** Mean distance over every vertex and sampled frame. */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Validation")
+	float MeanError = 0.f;
+};
+
+/**
+* Result of FJrMergeValidator::Validate.
+*/
+USTRUCT(BlueprintType)
+struct JRSKELETALMESHMERGER_API FJrMergeValidationReport
+{
+	GENERATED_BODY()
+
+	/** False if the merged mesh could not be validated (no provenance data, missing parts, ...). */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Validation")
+	bool bValid = false;
+
+	/** Number of sampled poses, the reference pose included. */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Validation")
+	int32 NumFrames = 0;
+
+	/** Largest error of all the parts. */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Validation")
+	float MaxError = 0.f;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Validation")
+	TArray<FJrPartValidationResult> Parts;
+};
+
+/**
+* Checks that a merged mesh deforms like the original multi-component actor.
+* The merged mesh and each original part are skinned on the CPU over a set of animation frames, and every merged LOD 0 vertex
+* is compared with the vertex it was copied from (see UJrMergeProvenanceUserData).
+*/
+class JRSKELETALMESHMERGER_API FJrMergeValidator
+{
+public:
+	/**
+	* @param MergedMesh - mesh merged with bRecordVertexProvenance
+	* @param PartTransforms - component relative transform of each part in the original actor, in merge order (identity if missing)
+	* @param Animations - animations to sample, the reference pose is always sampled
+	* @param NumFramesPerAnimation - number of evenly spaced frames sampled in each animation
+	*/
+	static FJrMergeValidationReport Validate(USkeletalMesh* MergedMesh, const TArray<FTransform>& PartTransforms, const TArray<UAnimSequence*>& Animations, int32 NumFramesPerAnimation = 10);
+
+private:
+	/** Skinning matrices of 'Mesh' for the pose of 'Animation' at 'Time', or for the reference pose if 'Animation' is null. */
+	static void ComputeSkinningMatrices(const USkeletalMesh* Mesh, const UAnimSequence* Animation, double Time, TArray<FMatrix44f>& OutMatrices);
+
+	/** Skinned position of the vertex 'VertIdx' of 'LODData'. */
+	static FVector3f SkinVertex(const FSkeletalMeshLODRenderData& LODData, int32 VertIdx, const TArray<FMatrix44f>& SkinningMatrices);
+};
@@ -0,0 +1,42 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+enum class EJrCPUAccessStream : uint8;
+struct FJrSkeletalMeshMergeOptions;
+struct FSkeletalMeshMergeParams;
+class USkeletalMesh;
+
+/**
+* On-disk cache of merged meshes, reloaded across sessions without going through the package pipeline.
+*
+* A cache file is a versioned header followed by 16 byte aligned blocks: the raw CPU images of the merged LOD buffers
+* (positions, tangents, UVs, colors, packed skin weights and their lookup, indices) plus small tables for the sections, skeleton,
+* materials, sockets and the vertex provenance.
+* The loader maps the file and copies each block straight into the matching render buffer, nothing is parsed per vertex.
+*/
+class JRSKELETALMESHMERGER_API FJrMergedMeshCache
+{
+public:
+	/** Cache key of a merge: hash of the merge params, the options, and the content id of each source mesh. */
+	static FString MakeKey(const FSkeletalMeshMergeParams& Params, const FJrSkeletalMeshMergeOptions& Options);
+
+	/** Saved/JrMergeCache/<Key>.jrmc */
+	static FString GetCacheFilename(const FString& Key);
+
+	/**
+	* Writes the render data of a merged mesh, its buffers must still have their CPU data: call it before the mesh InitResources
+	* (FJrSkeletalMeshMerge::SetBuildRenderResources(false)), or merge with EMeshBufferAccess::ForceCPUAndGPU.
+	* The file is written next to its final name and moved in place, so a reader never maps a partial file.
+	*/
+	static bool Save(USkeletalMesh* MergedMesh, const FString& Filename);
+
+	/**
+	* Maps a cache file and builds a transient mesh from it, with initialized render resources.
+	* @param CPUAccessStreams - vertex streams keeping a CPU copy after the upload, every stream if the mesh needs CPU skinning
+	* @return nullptr if the file is missing, from another format version, or corrupt
+	*/
+	static USkeletalMesh* Load(const FString& Filename, UObject* Outer, EJrCPUAccessStream CPUAccessStreams);
+};
@@ -0,0 +1,125 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/AssetUserData.h"
+#include "JrPartCooker.generated.h"
+
+class FSkeletalMeshLODRenderData;
+class USkeletalMesh;
+struct FReferenceSkeleton;
+
+/**
+* Section of a cooked part LOD.
+*/
+USTRUCT()
+struct JRSKELETALMESHMERGER_API FJrCookedPartSection
+{
+	GENERATED_BODY()
+
+	/** Section bone map in master skeleton bone indices. */
+	UPROPERTY()
+	TArray<int32> MasterBoneMap;
+
+	UPROPERTY()
+	int32 NumVertices = 0;
+
+	UPROPERTY()
+	int32 NumTriangles = 0;
+
+	UPROPERTY()
+	int32 MaxBoneInfluences = 0;
+};
+
+/**
+* Part LOD with its vertices already moved to the master skeleton root space.
+*/
+USTRUCT()
+struct JRSKELETALMESHMERGER_API FJrCookedPartLOD
+{
+	GENERATED_BODY()
+
+	/** FJrPartCooker::MakeLODKey of the LOD when it was cooked. A LOD changed since then is merged the regular way. */
+	UPROPERTY()
+	uint64 LODKey = 0;
+
+	/** The part root already matches the master root: the source vertices are used as they are and nothing is stored. */
+	UPROPERTY()
+	bool bInMasterSpace = false;
+
+	UPROPERTY()
+	TArray<FVector3f> Positions;
+
+	UPROPERTY()
+	TArray<FVector3f> TangentsX;
+
+	/** W is the binormal sign. */
+	UPROPERTY()
+	TArray<FVector4f> TangentsZ;
+
+	UPROPERTY()
+	TArray<FJrCookedPartSection> Sections;
+};
+
+/**
+* Merge data of a part precomputed for a master skeleton, see FJrPartCooker.
+*/
+UCLASS()
+class JRSKELETALMESHMERGER_API UJrCookedPartUserData : public UAssetUserData
+{
+	GENERATED_BODY()
+
+public:
+	/** Mesh whose reference skeleton the part was cooked against. */
+	UPROPERTY(VisibleAnywhere, Category = "Cooking")
+	TSoftObjectPtr<USkeletalMesh> MasterMesh;
+
+	/** FJrPartCooker::HashSkeleton of the master and of the part when the part was cooked. */
+	UPROPERTY()
+	uint64 MasterSkeletonHash = 0;
+
+	UPROPERTY()
+	uint64 PartSkeletonHash = 0;
+
+	/** Master bone index of each part bone. */
+	UPROPERTY()
+	TArray<int32> PartToMasterBone;
+
+	/** One entry per part LOD. */
+	UPROPERTY()
+	TArray<FJrCookedPartLOD> LODs;
+};
+
+/**
+* Offline preparation of part meshes for a master skeleton.
+*
+* A cooked part stores what FJrSkeletalMeshMerge otherwise computes on every merge: its bone indices in the master skeleton
+* (no bone name lookups) and its vertices moved to the master root space (no per vertex transform).
+* The data is only used when the merged reference skeleton is the master one, e.g. parts authored against a master skeleton
+* merged without pruning.
+*/
+class JRSKELETALMESHMERGER_API FJrPartCooker
+{
+public:
+	/**
+	* Cooks 'Part' against the reference skeleton of 'MasterMesh' and attaches the result to the part (replacing an older one).
+	* @return nullptr if the part has bones the master doesn't have
+	*/
+	static UJrCookedPartUserData* CookPart(USkeletalMesh* Part, USkeletalMesh* MasterMesh);
+
+	/** Returns the cooked data of 'Part' if it is still valid for a merged reference skeleton of hash 'MergedSkeletonHash'. */
+	static const UJrCookedPartUserData* FindCookedData(const USkeletalMesh* Part, uint64 MergedSkeletonHash);
+
+	/** Hash of the bone names, parents and reference pose of a reference skeleton. */
+	static uint64 HashSkeleton(const FReferenceSkeleton& RefSkeleton);
+
+	/**
+	* Identity of a mesh LOD checked before using its cooked data: the imported model id of the mesh, which changes with every reimport
+	* or build, and the LOD vertex, index and section counts. Reads no vertex data.
+	*/
+	static uint64 MakeLODKey(const USkeletalMesh* Mesh, int32 LODIndex);
+
+	/** Hash of the vertex buffers (positions, tangents, UVs, colors, skin weights) of a LOD, 0 if the LOD has no CPU copy. */
+	static uint64 HashLODVertices(const FSkeletalMeshLODRenderData& LODData);
+};
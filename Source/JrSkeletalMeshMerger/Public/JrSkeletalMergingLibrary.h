@@ -3,6 +3,12 @@
 #pragma once
 
 #include "AnimToTextureDataAsset.h"
+#include "JrCrowdBuilder.h"
+#include "JrMergeBenchmark.h"
+#include "JrMergePartitioner.h"
+#include "JrPartCooker.h"
+#include "JrMergeValidator.h"
+#include "JrSkeletalMeshMergeTypes.h"
 #include "SkeletalMergingLibrary.h"
 #include "AssetRegistry/AssetRegistryModule.h"
 #include "Engine/SCS_Node.h"
@@ -27,8 +33,11 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "SkelMerge", meta = (UnsafeDuringActorConstruction = "true"))
 	static bool SaveMergeSkeletons(const FSkeletonMergeParams& mergeParams, TSubclassOf<AActor> ActorClass, const FString& fileName, const FString& AbsolutePath, USkeleton* &ResultMesh);
 
-	UFUNCTION(BlueprintCallable, Category = "SkelMerge", meta = (UnsafeDuringActorConstruction = "true"))
-	static bool SaveMergeMeshes(const FSkeletalMeshMergeParams& mergeParams, TSubclassOf<AActor> ActorClass, const FString& fileName, const FString& AbsolutePath, USkeletalMesh* &ResultMesh);
+	/**
+	 * @param MergeReport 合并的统计 (节省的DrawCall, 顶点/三角形/骨骼数量, 各阶段耗时)
+	 */
+	UFUNCTION(BlueprintCallable, Category = "SkelMerge", meta = (UnsafeDuringActorConstruction = "true", AutoCreateRefTerm = "mergeOptions"))
+	static bool SaveMergeMeshes(const FSkeletalMeshMergeParams& mergeParams, const FJrSkeletalMeshMergeOptions& mergeOptions, TSubclassOf<AActor> ActorClass, const FString& fileName, const FString& AbsolutePath, USkeletalMesh* &ResultMesh, FJrMergeReport& MergeReport);
 
 	static void CreateComponentsByNode(USCS_Node* RootNode, UBlueprint* NewBlueprint);
 
@@ -38,9 +47,18 @@ public:
 	 * @param ActorClass 原蓝图类
 	 * @param fileName 新创建的资产名
 	 * @param AbsolutePath 资产路径
+	 * @param bSetupChildMeshes 不需要合并的Mesh跟随合并后的Mesh (见 SetupChildMeshes)
 	 */
 	UFUNCTION(BlueprintCallable, Category = "SkelMerge", meta = (UnsafeDuringActorConstruction = "true"))
-	static bool CreateBlueprintAssetAfterMerging(USkeletalMesh* SkelMesh, TArray<USkeletalMesh*> ChildSkelMesh, TSubclassOf<AActor> ActorClass, const FString& fileName, const FString& AbsolutePath);
+	static bool CreateBlueprintAssetAfterMerging(USkeletalMesh* SkelMesh, TArray<USkeletalMesh*> ChildSkelMesh, TSubclassOf<AActor> ActorClass, const FString& fileName, const FString& AbsolutePath, bool bSetupChildMeshes = true);
+
+	/**
+	 * Makes the child mesh components of a Blueprint generated after merging follow the merged mesh, see FJrChildMeshSetup:
+	 * children skinned by merged skeleton bones get SetLeaderPoseComponent in the construction script and no animation of their own,
+	 * children skinned by a single bone become static mesh components on that bone (the static meshes are saved next to the Blueprint).
+	 * @return number of child components set up
+	 */
+	static int32 SetupChildMeshes(UBlueprint* Blueprint, USkeletalMesh* SkelMesh, const TArray<USkeletalMesh*>& ChildSkelMesh, const FString& PackageName);
 
 	static TArray<USCS_Node*> GetSkeletalNodesByClass(const TSubclassOf<AActor> ActorClass);
 
@@ -80,16 +98,73 @@ public:
 		return ActorComponents;
 	}
 
+	/**
+	 * Renames the bones of each skeleton that an earlier skeleton already has to Bone_Skeleton, and saves the skeletons and the meshes using them.
+	 * Prefer MakeBoneNameRemaps, which leaves the assets untouched.
+	 */
 	UFUNCTION(BlueprintCallable, Category = "SkelMerge", meta = (UnsafeDuringActorConstruction = "true"))
 	static void BoneNameCheck(TArray<USkeleton*> Skeletons);
 
-	static void ModifySameBoneName(TArray<TObjectPtr<USkeleton>>& Skeletons);
+	/**
+	 * Returns the renames of BoneNameCheck as merge options (FJrSkeletalMeshMergeOptions::BoneNameRemaps), applied in memory by the merge.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "SkelMerge")
+	static TArray<FJrBoneNameRemap> MakeBoneNameRemaps(const TArray<USkeleton*>& Skeletons);
+
+	static TArray<FJrBoneNameRemap> ModifySameBoneName(const TArray<TObjectPtr<USkeleton>>& Skeletons);
 
     static void MergeSkeletal(FSkeletalMeshMergeParams& SkeletalMeshMergeParams, FSkeletonMergeParams& SkeletonMergeParams, TArray<USCS_Node*> SkeletalNodes);
 
-	static USkeleton* MergeSkeletons(const FSkeletonMergeParams& Params, TArray<USCS_Node*> SkeletalNodes);
+	static USkeleton* MergeSkeletons(const FSkeletonMergeParams& Params, TArray<USCS_Node*> SkeletalNodes, const TArray<FJrBoneNameRemap>* BoneNameRemaps = nullptr);
+
+	static USkeletalMesh* MergeMeshes(const FSkeletalMeshMergeParams& Params, const FJrSkeletalMeshMergeOptions& Options = FJrSkeletalMeshMergeOptions(), FJrMergeReport* OutReport = nullptr);
+
+	/**
+	 * Predicts the result of MergeMeshes (sections, bones, vertices, LOD count, buffer sizes) without building the merged mesh,
+	 * to check a part combination against its budget.
+	 * 缺失的LOD按SynthesizedLODTriangleRatios估算, 不会调用引擎减面
+	 */
+	UFUNCTION(BlueprintCallable, Category = "SkelMerge", meta = (AutoCreateRefTerm = "Options"))
+	static FJrMergeReport PlanMerge(const FSkeletalMeshMergeParams& Params, const FJrSkeletalMeshMergeOptions& Options);
 
-	static USkeletalMesh* MergeMeshes(const FSkeletalMeshMergeParams& Params);
+	/**
+	 * Splits the merge into the fewest merged meshes within 'Budget' (see FJrMergePartitioner) and merges each of them.
+	 * 每个分区用一个SkeletalMeshComponent显示, 第一个分区的组件作为其他组件的LeaderPoseComponent
+	 */
+	UFUNCTION(BlueprintCallable, Category = "SkelMerge", meta = (AutoCreateRefTerm = "Options,Budget"))
+	static FJrMergePartitionResult MergeMeshesWithinBudget(const FSkeletalMeshMergeParams& Params, const FJrSkeletalMeshMergeOptions& Options, const FJrMergeBudget& Budget);
+
+	/**
+	 * Measures how the merge time and memory scale with the number of parts, bones and sections, on generated parts.
+	 * 结果同时写入Saved/JrMergeBenchmark下的CSV, 也可以用JrMergeBenchmark命令行运行
+	 */
+	UFUNCTION(BlueprintCallable, Category = "SkelMerge", meta = (AutoCreateRefTerm = "Settings"))
+	static FJrMergeBenchmarkReport RunMergeBenchmark(const FJrMergeBenchmarkSettings& Settings);
+
+	/**
+	 * Precomputes the merge data of part meshes against the reference skeleton of a master mesh (see FJrPartCooker) and stores it on each part.
+	 * 合并骨骼与Master一致时 (部件都基于Master骨骼制作, 不裁剪骨骼), 合并直接使用这些数据
+	 * @return number of parts cooked
+	 */
+	UFUNCTION(BlueprintCallable, Category = "SkelMerge")
+	static int32 CookPartsForMaster(const TArray<USkeletalMesh*>& Parts, USkeletalMesh* MasterMesh);
+
+	/**
+	 * Compares the deformation of a merged mesh with the one of its original parts over animation frames.
+	 * @param MergedMesh 合并后的Mesh (需要开启bRecordVertexProvenance)
+	 * @param PartTransforms 原蓝图里每个部件组件的相对变换, 与合并顺序一致
+	 * @param Animations 用来采样的动画
+	 * @param NumFramesPerAnimation 每个动画采样的帧数
+	 */
+	UFUNCTION(BlueprintCallable, Category = "SkelMerge", meta = (AutoCreateRefTerm = "PartTransforms,Animations"))
+	static FJrMergeValidationReport ValidateMergedMesh(USkeletalMesh* MergedMesh, const TArray<FTransform>& PartTransforms, const TArray<UAnimSequence*>& Animations, int32 NumFramesPerAnimation = 10);
+
+	/**
+	 * Adds instanced crowd components to 'Owner', one per agent static mesh, with the AnimToTexture playback of each agent
+	 * in its per-instance custom data. See FJrCrowdBuilder.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "SkelMerge", meta = (AutoCreateRefTerm = "Settings"))
+	static FJrCrowdBuildResult BuildInstancedCrowd(AActor* Owner, const TArray<FJrCrowdInstance>& Instances, const FJrCrowdSettings& Settings);
 
 	UFUNCTION(BlueprintCallable, Category="Mesh Merge", meta=(UnsafeDuringActorConstruction="true"))
 	static TArray<USkeletalMeshComponent*> GetSkeletalMeshByClass(const TSubclassOf<AActor> ActorClass);
@@ -15,6 +15,7 @@ FJrSkeletalMeshMerge
 #include "ReferenceSkeleton.h"
 #include "Components.h"
 #include "SkeletalMeshMerge.h"
+#include "JrSkeletalMeshMergeTypes.h"
 // #include "JrSkeletalMeshMergeFunc.generated.h"
 
 class UMaterialInterface;
@@ -23,6 +24,10 @@ class USkeletalMeshSocket;
 class USkeleton;
 class FSkeletalMeshLODRenderData;
 struct FSkelMeshRenderSection;
+struct FSkinWeightInfo;
+struct FJrVertexCopyParams;
+struct FJrCookedPartLOD;
+class UJrCookedPartUserData;
 
 
 struct FJrRefPoseOverride
@@ -91,6 +96,7 @@ public:
 	* @param StripTopLODs - number of high LODs to remove from input meshes
     * @param bMeshNeedsCPUAccess - (optional) if the resulting mesh needs to be accessed by the CPU for any reason (e.g. for spawning particle effects).
 	* @param UVTransforms - optional array to transform the UVs in each mesh
+	* @param InMergeOptions - optional extra merge settings (LOD synthesis, ...)
 	*/
 	FJrSkeletalMeshMerge( 
 		USkeletalMesh* InMergeMesh, 
@@ -98,7 +104,8 @@ public:
 		const TArray<FSkelMeshMergeSectionMapping>& InForceSectionMapping,
 		int32 StripTopLODs,
         EMeshBufferAccess MeshBufferAccess=EMeshBufferAccess::Default,
-		const FSkelMeshMergeUVTransformMapping* InSectionUVTransforms = nullptr
+		const FSkelMeshMergeUVTransformMapping* InSectionUVTransforms = nullptr,
+		const FJrSkeletalMeshMergeOptions* InMergeOptions = nullptr
 		);
 
 	UE_DEPRECATED(5.0, "FSkelMeshMergeUVTransforms has been replaced with FSkelMeshMergeMeshUVTransforms, use different signature")
@@ -138,6 +145,40 @@ public:
 	 */
 	bool FinalizeMesh();
 
+	/**
+	 * Predicts the merge result without building it: only the skeleton union, the LOD count, the part culling and the
+	 * section grouping are run, no vertex data is copied and neither the merge mesh nor the sources are modified.
+	 * Synthesized LODs get their screen sizes but are estimated from the triangle ratios instead of being reduced, the pruned bones
+	 * are estimated from the section bone maps, and the part mask rules are not evaluated (the masked triangles are counted as kept).
+	 * @param OutPlan - [out] predicted statistics (bDryRun is set)
+	 * @return 'false' if the source mesh list is invalid
+	 */
+	bool PlanMerge(FJrMergeReport& OutPlan);
+
+	/** Triangles and vertices removed by the part mask rules, for each merged LOD. */
+	const TArray<FJrLODMaskingStats>& GetMaskingStats() const { return MaskingStats; }
+
+	/** Statistics and timings of the last merge. */
+	const FJrMergeReport& GetReport() const { return Report; }
+
+	/** Source mesh index (X) and source vertex index (Y) of each merged LOD 0 vertex, if bRecordVertexProvenance is set. */
+	const TArray<FIntPoint>& GetVertexProvenance() const { return VertexProvenance; }
+
+	/**
+	 * Whether DoMerge releases and reinitializes the merge mesh render resources (default true).
+	 * Meshes only used as the source of another merge skip it, which also lets them be merged off the game thread.
+	 */
+	void SetBuildRenderResources(bool bInBuildRenderResources) { bBuildRenderResources = bInBuildRenderResources; }
+
+	/**
+	 * Whether MergeSkeleton duplicates the source sockets into the merge mesh (default true).
+	 * Merges run off the game thread skip it and call BuildMergedSockets on the game thread once merged, as the sockets are UObjects.
+	 */
+	void SetBuildSockets(bool bInBuildSockets) { bBuildSockets = bInBuildSockets; }
+
+	/** Duplicates the sockets of the source meshes and of their skeletons into the merge mesh. Game thread only. */
+	void BuildMergedSockets();
+
 private:
 	/** Destination merged mesh */
 	USkeletalMesh* MergeMesh;
@@ -151,16 +192,74 @@ private:
     /** Whether or not the resulting mesh needs to be accessed by the CPU (e.g. for particle spawning).*/
     EMeshBufferAccess MeshBufferAccess;
 
+	/** Extra merge settings. */
+	FJrSkeletalMeshMergeOptions MergeOptions;
+
+	/** LOD generated at merge time for a source mesh that has fewer LODs than the merged mesh. */
+	struct FSynthesizedLOD
+	{
+		/** Index of the authored source LOD whose vertices are referenced by the reduced indices. */
+		int32 BaseLODIdx = INDEX_NONE;
+		/** Screen size used for this LOD, since the source mesh has no LOD info for it. */
+		float ScreenSize = 0.f;
+		/** Reduced index list (absolute indices into the base LOD vertex buffer) for each section of the base LOD. */
+		TArray<TArray<uint32>> SectionIndices;
+	};
+
 	/** Info about source mesh used in merge. */
 	struct FMergeMeshInfo
 	{
 		/** Mapping from RefSkeleton bone index in source mesh to output bone index. */
 		TArray<int32> SrcToDestRefSkeletonMap;
+		/** LODs synthesized for this source, the first entry follows the last authored LOD. */
+		TArray<FSynthesizedLOD> SynthesizedLODs;
+		/** First merged LOD (after StripTopLODs) the source is culled from, MAX_int32 if never culled. */
+		int32 CullLODIdx;
+		/** Cooked data of the source for the merged skeleton (FJrPartCooker), null if it has none. */
+		const UJrCookedPartUserData* CookedPart;
 	};
 
 	/** Array of source mesh info structs. */
 	TArray<FMergeMeshInfo> SrcMeshInfo;
 
+	/** Decoded mask texture used by the part mask rules. */
+	struct FMaskImage;
+	/** Triangles of a covering mesh LOD bucketed in a uniform grid, for the ray-cast masking. */
+	struct FMaskOccluder;
+
+	/** Mask textures decoded for this merge. */
+	TMap<const UTexture2D*, TSharedPtr<FMaskImage>> MaskImages;
+
+	/** Occluders built for this merge, per covering mesh and source LOD. */
+	TMap<TPair<const USkeletalMesh*, int32>, TSharedPtr<FMaskOccluder>> MaskOccluders;
+
+	/** Per merged LOD masking stats. */
+	TArray<FJrLODMaskingStats> MaskingStats;
+
+	/** Source of each merged LOD 0 vertex. */
+	TArray<FIntPoint> VertexProvenance;
+
+	/** Content hash of the vertex buffers of each source LOD, 0 when the LOD has no CPU copy. */
+	TMap<TPair<const USkeletalMesh*, int32>, uint64> SourceLODVertexHashes;
+
+	/** Vertex layout of the last generated merged LOD, see GetLODVertexLayout. */
+	TArray<uint64> PreviousLODVertexLayout;
+
+	/** Hash of the reference skeleton the merge mesh inverse reference matrices were built from, 0 if not built. */
+	uint64 InvRefMatricesSkeletonHash = 0;
+
+	/** See SetBuildRenderResources. */
+	bool bBuildRenderResources = true;
+
+	/** See SetBuildSockets. */
+	bool bBuildSockets = true;
+
+	/** Whether every bone renamed by BoneNameRemaps was found in the merged reference skeleton, see CheckRemappedBones. */
+	bool bRemappedBonesResolved = true;
+
+	/** Statistics of the last merge. */
+	FJrMergeReport Report;
+
 	/** New reference skeleton, made from creating union of each part's skeleton. */
 	FReferenceSkeleton NewRefSkeleton;
 
@@ -187,11 +286,17 @@ private:
 		TArray<FBoneIndexType> BoneMapToMergedBoneMap;
 		/** transform from the original UVs */
 		TArray<FTransform> UVTransforms;
+		/** optional reduced index list replacing the source section indices (synthesized LODs) */
+		const TArray<uint32>* OverrideIndices;
+		/** screen size to use instead of the source LOD info one, negative if unused */
+		float OverrideScreenSize;
 
 		FMergeSectionInfo( const USkeletalMesh* InSkelMesh,const FSkelMeshRenderSection* InSection, TArray<FTransform> & InUVTransforms )
 			:	SkelMesh(InSkelMesh)
 			,	Section(InSection)
 			,	UVTransforms(InUVTransforms)
+			,	OverrideIndices(nullptr)
+			,	OverrideScreenSize(-1.f)
 		{}
 	};
 
@@ -254,15 +359,106 @@ private:
 	*/
 	bool ProcessMergeMesh();
 
+	/**
+	* Rebuilds the merge mesh inverse reference matrices if its reference skeleton changed since they were last built.
+	* Every step that needs the matrices calls this instead of rebuilding them.
+	*/
+	void UpdateInvRefMatrices();
+
+	/**
+	 * Maps the bones of each source mesh to the merged reference skeleton (SrcMeshInfo), pruned bones map to their nearest kept ancestor.
+	 */
+	void BuildSourceBoneMaps();
+
+	/**
+	 * Returns the number of sections the source meshes draw as separate components at source LOD 'LODIdx'.
+	 */
+	int32 CountInputSections(int32 LODIdx) const;
+
 	/**
 	 * Returns the number of LODs that can be supported by the meshes in 'SourceMeshList'.
 	 */
 	int32 CalculateLodCount(const TArray<USkeletalMesh*>& SourceMeshList) const;
 
 	/**
-	 * Builds a new 'RefSkeleton' from the reference skeletons in the 'SourceMeshList'.
+	 * Generates the reduced LODs of the source meshes that have less than 'NumMergedLODs' LODs (after StripTopLODs).
+	 * @param bReduceIndices - false only sets the synthesized LOD screen sizes, with empty section indices (merge plans)
 	 */
-	static void BuildReferenceSkeleton(const TArray<USkeletalMesh*>& SourceMeshList, FReferenceSkeleton& RefSkeleton, const USkeleton* SkeletonAsset);
+	void SynthesizeMissingLODs(int32 NumMergedLODs, bool bReduceIndices = true);
+
+	/**
+	 * Finds the merged LOD each source mesh drops out at, from the per-mesh cull rules and the part screen size threshold.
+	 */
+	void CalculatePartCulling(int32 NumMergedLODs);
+
+	/**
+	* Removes the triangles of a merge section hidden by the covering parts (part mask rules).
+	* @param MergeSectionInfo - section to mask
+	* @param LODIdx - source LOD being processed
+	* @param InIndices - source indices of the section (absolute indices in the source LOD vertex buffer)
+	* @param OutIndices - [out] remaining indices
+	* @return false if no rule masks the section, OutIndices is then left untouched
+	*/
+	bool MaskCoveredTriangles(const FMergeSectionInfo& MergeSectionInfo, int32 LODIdx, const TArray<uint32>& InIndices, TArray<uint32>& OutIndices);
+
+	/**
+	* Applies the LOD bone reductions to a generated LOD: the skin weights of the removed bones move to their nearest kept
+	* ancestor, and the section bone maps, ActiveBoneIndices and RequiredBones are rebuilt without them.
+	* @param MergedLODIdx - merged LOD being generated
+	* @param LODData - merged LOD render data, with its sections set up
+	* @param SkinWeights - merged skin weights of the LOD, influences index the section bone maps
+	*/
+	void ReduceLODBones(int32 MergedLODIdx, FSkeletalMeshLODRenderData& LODData, TArray<FSkinWeightInfo>& SkinWeights) const;
+
+	/**
+	* Returns the content hash of the vertex buffers (positions, tangents, UVs, colors, skin weights) of a source LOD.
+	*/
+	uint64 GetSourceLODVertexHash(const USkeletalMesh* SkelMesh, int32 SourceLODIdx);
+
+	/**
+	* Returns what the merged vertices of a LOD are made of: the merged sections, and for each merged part section its mesh,
+	* vertex range, bone map and source LOD vertex hash. Two consecutive LODs with the same layout have the same merged vertices.
+	* @return an empty layout if the LOD vertices can't be shared (synthesized LOD, masking, bone reduction or missing CPU data)
+	*/
+	TArray<uint64> GetLODVertexLayout(int32 LODIdx, const TArray<FNewSectionInfo>& NewSectionInfos);
+
+	/**
+	* Sets the UV channel densities of the merged materials from the triangles of a merged LOD, as the engine computes them on import:
+	* per UV channel, the area weighted average of sqrt(triangle area / UV area) without the 10% lowest and highest triangle densities.
+	* The sections are measured in parallel.
+	* @param LODData - merged LOD render data, with its vertex buffers and sections built
+	* @param Indices - merged LOD index buffer
+	*/
+	void ComputeUVDensities(const FSkeletalMeshLODRenderData& LODData, const TArray<uint32>& Indices);
+
+	/**
+	* Measures the half and 16 bit position errors of a merged LOD, to tell which LODs could afford packed positions (bMeasurePositionErrors).
+	* @param LODData - merged LOD render data, with its position buffer built
+	* @param LODStats - [in/out] stats of the LOD, the errors are filled
+	*/
+	void MeasurePositionErrors(const FSkeletalMeshLODRenderData& LODData, FJrLODMergeStats& LODStats) const;
+
+	/**
+	 * Builds a new 'RefSkeleton' from the reference skeletons in the 'SourceMeshList', with the bones renamed by BoneNameRemaps.
+	 */
+	void BuildReferenceSkeleton(const TArray<USkeletalMesh*>& SourceMeshList, FReferenceSkeleton& RefSkeleton, const USkeleton* SkeletonAsset) const;
+
+	/**
+	 * Returns the merged name of a source mesh bone: its name, or its BoneNameRemaps entry.
+	 */
+	FName GetSourceBoneName(const USkeletalMesh* SrcMesh, int32 BoneIndex) const;
+
+	/**
+	 * Checks that every source bone renamed by BoneNameRemaps resolves to its own bone in 'RefSkeleton', under the merged bone of its parent.
+	 * @return false if a renamed bone is missing or reparented, the merge then fails instead of skinning it to another bone
+	 */
+	bool CheckRemappedBones(const FReferenceSkeleton& RefSkeleton) const;
+
+	/**
+	 * Removes the bones of 'RefSkeleton' that no source vertex, socket, virtual bone or keep-list entry needs (see bPruneUnusedBones).
+	 * @param bFromBoneMaps - keep every bone of the section bone maps instead of reading the skin weights (merge plans, may keep a few more bones)
+	 */
+	void PruneUnusedBones(FReferenceSkeleton& RefSkeleton, bool bFromBoneMaps = false) const;
 
 	/**
 	 * Overrides the 'TargetSkeleton' bone poses with the bone poses specified in the 'PoseOverrides' array.
@@ -284,12 +480,12 @@ private:
 	 * Copies and adds the 'NewSocket' to the MergeMesh's MeshOnlySocketList only if the socket does not already exist.
 	 * @return 'true' if the socket is added; 'false' otherwise.
 	 */
-	bool AddSocket(const USkeletalMeshSocket* NewSocket, bool bIsSkeletonSocket);
+	bool AddSocket(const USkeletalMeshSocket* NewSocket, bool bIsSkeletonSocket, const USkeleton* SourceSkeleton = nullptr);
 
 	/**
 	 * Adds only the new sockets from the 'NewSockets' array to the 'ExistingSocketList'.
 	 */
-	void AddSockets(const TArray<USkeletalMeshSocket*>& NewSockets, bool bAreSkeletonSockets);
+	void AddSockets(const TArray<USkeletalMeshSocket*>& NewSockets, bool bAreSkeletonSockets, const USkeleton* SourceSkeleton = nullptr);
 
 	/**
 	 * Builds a new 'SocketList' from the sockets in the 'SourceMeshList'.
@@ -313,9 +509,18 @@ private:
 	 */
 	void OverrideMergedSockets(const TArray<FJrRefPoseOverride>& PoseOverrides);
 
-	/*
-	 * Copy Vertex Buffer from Source LOD Model
+	/**
+	 * Computes the per-section constants of the vertex copy: root bone rebase, UV transforms and source UV count.
 	 */
-	template<typename VertexDataType>
-	void CopyVertexFromSource(VertexDataType& DestVert, const FSkeletalMeshLODRenderData& SrcLODData, int32 SourceVertIdx, const FMergeSectionInfo& MergeSectionInfo);
+	void MakeVertexCopyParams(const FSkeletalMeshLODRenderData& SrcLODData, int32 SourceLODIdx, const FMergeSectionInfo& MergeSectionInfo, FJrVertexCopyParams& OutParams);
+
+	/**
+	 * Returns the transform of the vertices of a source mesh from its root bone space to the merged root bone space, identity for the first mesh.
+	 */
+	FMatrix44f GetSourceRebaseMatrix(const USkeletalMesh* SkelMesh) const;
+
+	/**
+	 * Returns the cooked vertices of a source LOD, nullptr if the source isn't cooked for the merged skeleton or changed since.
+	 */
+	const FJrCookedPartLOD* FindCookedLOD(const USkeletalMesh* SkelMesh, int32 SourceLODIdx);
 };
@@ -0,0 +1,542 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/AssetUserData.h"
+#include "Engine/SkeletalMesh.h"
+#include "Engine/Texture2D.h"
+#include "JrSkeletalMeshMergeTypes.generated.h"
+
+/**
+* How the merged skin weight buffer stores the bone influences.
+*/
+UENUM(BlueprintType)
+enum class EJrBoneInfluenceMode : uint8
+{
+	/** Variable when the parts have different influence counts and the platform supports unlimited bone influences, fixed otherwise. */
+	Auto,
+	/** Every vertex stores the largest influence count of the parts (engine FSkeletalMeshMerge behavior). */
+	Fixed,
+	/** Every vertex stores only its non-zero influences, through the engine unlimited bone influences lookup buffer. Fixed if the project doesn't enable unlimited bone influences. */
+	Variable,
+};
+
+/**
+* Vertex streams of a merged LOD that can keep a CPU copy, see FJrSkeletalMeshMergeOptions::CPUAccessStreams.
+*/
+UENUM(BlueprintType, meta = (Bitflags, UseEnumValuesAsMaskValuesInEditor = "true"))
+enum class EJrCPUAccessStream : uint8
+{
+	None = 0 UMETA(Hidden),
+	/** Positions (e.g. spawning particles on the mesh). */
+	Positions = 1 << 0,
+	/** Tangents and UVs. */
+	TangentsAndUVs = 1 << 1,
+	/** Skin weights (e.g. sampling the skinned surface on the CPU). */
+	SkinWeights = 1 << 2,
+	/** Vertex colors. */
+	Colors = 1 << 3,
+};
+ENUM_CLASS_FLAGS(EJrCPUAccessStream);
+
+/**
+* Drops a source mesh from the merged mesh starting at a given LOD.
+*/
+USTRUCT(BlueprintType)
+struct JRSKELETALMESHMERGER_API FJrPartLODCullRule
+{
+	GENERATED_BODY()
+
+	/** Source mesh (one of the meshes to merge) this rule applies to. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LOD")
+	TObjectPtr<USkeletalMesh> Mesh = nullptr;
+
+	/** First merged LOD (after StripTopLODs) that doesn't contain the mesh anymore. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LOD", meta = (ClampMin = "1"))
+	int32 DropAtLOD = 1;
+};
+
+/**
+* Removes bones from a merged LOD and the LODs after it. The weights of a removed bone go to its nearest kept ancestor.
+*/
+USTRUCT(BlueprintType)
+struct JRSKELETALMESHMERGER_API FJrLODBoneReduction
+{
+	GENERATED_BODY()
+
+	/** First merged LOD (after StripTopLODs) the reduction applies to. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Skeleton", meta = (ClampMin = "0"))
+	int32 LODIndex = 1;
+
+	/** Bones removed from the LOD skin weights. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Skeleton")
+	TArray<FName> BonesToRemove;
+
+	/** Maximum number of skinning bones of the LOD, the bones with the lowest total weight are removed first. 0 disables it. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Skeleton", meta = (ClampMin = "0"))
+	int32 MaxBoneCount = 0;
+};
+
+/**
+* Renames bones of the meshes using a skeleton asset, in the merged skeleton only: the source assets keep their names.
+* See UJrSkeletalMergingLibrary::MakeBoneNameRemaps.
+*/
+USTRUCT(BlueprintType)
+struct JRSKELETALMESHMERGER_API FJrBoneNameRemap
+{
+	GENERATED_BODY()
+
+	/** Skeleton asset of the renamed source meshes. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Skeleton")
+	TObjectPtr<USkeleton> Skeleton = nullptr;
+
+	/** Source bone name to merged bone name. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Skeleton")
+	TMap<FName, FName> BoneNames;
+};
+
+/**
+* Hides the surface of underlying parts covered by a part (e.g. the body under clothing).
+* Triangles whose three vertices are hidden are removed from the merged mesh.
+*/
+USTRUCT(BlueprintType)
+struct JRSKELETALMESHMERGER_API FJrPartMaskRule
+{
+	GENERATED_BODY()
+
+	/** Source mesh that covers the others. The masking only applies to the LODs this mesh is part of. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Masking")
+	TObjectPtr<USkeletalMesh> CoveringMesh = nullptr;
+
+	/** Source meshes that are covered. Empty masks every other source mesh. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Masking")
+	TArray<TObjectPtr<USkeletalMesh>> MaskedMeshes;
+
+	/** Mask in the UV space of the covered meshes, texels brighter than half (red channel) are hidden. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Masking")
+	TObjectPtr<UTexture2D> MaskTexture = nullptr;
+
+	/** UV channel of the covered meshes the mask texture is sampled with. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Masking", meta = (ClampMin = "0", ClampMax = "7"))
+	int32 MaskUVChannel = 0;
+
+	/** Hide the vertices whose normal ray hits the covering mesh in the reference pose. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Masking")
+	bool bRayCastOcclusion = false;
+
+	/** Maximum distance between a covered vertex and the covering surface. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Masking", meta = (ClampMin = "0", EditCondition = "bRayCastOcclusion"))
+	float RayCastDistance = 10.f;
+
+	/** Returns true if the rule masks 'Mesh'. */
+	bool MasksMesh(const USkeletalMesh* Mesh) const
+	{
+		return Mesh != CoveringMesh && (MaskedMeshes.Num() == 0 || MaskedMeshes.Contains(Mesh));
+	}
+};
+
+/**
+* Triangles and vertices removed from a merged LOD by the part mask rules.
+*/
+USTRUCT(BlueprintType)
+struct JRSKELETALMESHMERGER_API FJrLODMaskingStats
+{
+	GENERATED_BODY()
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Masking")
+	int32 LODIndex = 0;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Masking")
+	int32 RemovedTriangles = 0;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Masking")
+	int32 RemovedVertices = 0;
+};
+
+/**
+* Statistics of one merged LOD.
+*/
+USTRUCT(BlueprintType)
+struct JRSKELETALMESHMERGER_API FJrLODMergeStats
+{
+	GENERATED_BODY()
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Report")
+	int32 LODIndex = 0;
+
+	/** Sections the source meshes draw at this LOD as separate components. */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Report")
+	int32 InputSections = 0;
+
+	/** Sections of the merged LOD. */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Report")
+	int32 OutputSections = 0;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Report")
+	int32 DrawCallsSaved = 0;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Report")
+	int32 Vertices = 0;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Report")
+	int32 Triangles = 0;
+
+	/** Bones skinning the LOD vertices. */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Report")
+	int32 ActiveBones = 0;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Report")
+	int32 RequiredBones = 0;
+
+	/** Maximum bone influences per vertex. */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Report")
+	int32 MaxBoneInfluences = 0;
+
+	/** The skin weights store a variable number of influences per vertex. */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Report")
+	bool bVariableBoneInfluences = false;
+
+	/** Triangles and vertices removed by the part mask rules. */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Report")
+	int32 MaskedTriangles = 0;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Report")
+	int32 MaskedVertices = 0;
+
+	/**
+	 * Merged LOD whose vertex buffers this LOD copied instead of rebuilding them from the parts, -1 if none.
+	 * Saves build time only: the LOD still owns its own copy of the buffers, the runtime memory is unchanged.
+	 */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Report")
+	int32 VerticesSharedWithLOD = INDEX_NONE;
+
+	/** Vertices of parts already in the merged space, copied with one memcpy per stream instead of vertex by vertex. */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Report")
+	int32 BulkCopiedVertices = 0;
+
+	/** The LOD index buffer is 32 bit: skeletal sections are drawn with absolute indices, so this happens past 65536 merged vertices. */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Report")
+	bool b32BitIndices = false;
+
+	/**
+	 * Largest position error (cm) the LOD would have with half positions relative to its bounds center (6 bytes per vertex instead of 12).
+	 * Only measured with FJrSkeletalMeshMergeOptions::bMeasurePositionErrors, 0 otherwise.
+	 */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Report")
+	float HalfPositionError = 0.f;
+
+	/** Largest position error (cm) the LOD would have with 16 bit positions spread over its bounds. */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Report")
+	float Quantized16PositionError = 0.f;
+
+	/** Size of the LOD render data (vertex, skin weight and index buffers). */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Report")
+	int64 BufferBytes = 0;
+
+	/** Part of BufferBytes kept in CPU memory after the upload, see FJrSkeletalMeshMergeOptions::CPUAccessStreams. */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Report")
+	int64 CPUAccessBytes = 0;
+};
+
+/**
+* Duration of a merge phase.
+*/
+USTRUCT(BlueprintType)
+struct JRSKELETALMESHMERGER_API FJrMergePhaseTiming
+{
+	GENERATED_BODY()
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Report")
+	FName Phase;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Report")
+	float Milliseconds = 0.f;
+};
+
+/**
+* What a merge did and what it saved, filled on every merge.
+*/
+USTRUCT(BlueprintType)
+struct JRSKELETALMESHMERGER_API FJrMergeReport
+{
+	GENERATED_BODY()
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Report")
+	bool bSuccess = false;
+
+	/** The report is a prediction (PlanMerge), nothing was built: vertex, triangle and buffer sizes are estimates and masking is not predicted. */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Report")
+	bool bDryRun = false;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Report")
+	int32 NumInputMeshes = 0;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Report")
+	TArray<FJrLODMergeStats> LODs;
+
+	/** Sum of the bones of the source meshes, each part component evaluates its own. */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Report")
+	int32 BonesBefore = 0;
+
+	/** Bones of the merged reference skeleton. */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Report")
+	int32 BonesAfter = 0;
+
+	/** Sockets found both on the merged mesh and on its skeleton. */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Report")
+	int32 DuplicateSockets = 0;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Report")
+	TArray<FJrMergePhaseTiming> PhaseTimings;
+
+	/** Merge results reused from a cache instead of being rebuilt. */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Report")
+	int32 CacheHits = 0;
+
+	/** Intermediate meshes built by a hierarchical merge, subgroup cache hits excluded. */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Report")
+	int32 IntermediateMerges = 0;
+
+	/** Adds the time elapsed since 'StartSeconds' (FPlatformTime::Seconds) to 'Phase'. */
+	void AddPhaseTime(FName Phase, double StartSeconds)
+	{
+		FJrMergePhaseTiming* Timing = PhaseTimings.FindByPredicate([Phase](const FJrMergePhaseTiming& Other) { return Other.Phase == Phase; });
+		if (!Timing)
+		{
+			Timing = &PhaseTimings.AddDefaulted_GetRef();
+			Timing->Phase = Phase;
+		}
+		Timing->Milliseconds += (float)((FPlatformTime::Seconds() - StartSeconds) * 1000.0);
+	}
+
+	/** Total draw calls saved over every LOD. */
+	int32 GetTotalDrawCallsSaved() const
+	{
+		int32 Total = 0;
+		for (const FJrLODMergeStats& LOD : LODs)
+		{
+			Total += LOD.DrawCallsSaved;
+		}
+		return Total;
+	}
+};
+
+/**
+* Extra merge settings for FJrSkeletalMeshMerge that are not covered by FSkeletalMeshMergeParams.
+*/
+USTRUCT(BlueprintType)
+struct JRSKELETALMESHMERGER_API FJrSkeletalMeshMergeOptions
+{
+	GENERATED_BODY()
+
+	/**
+	 * Generate the LODs that low-LOD parts are missing instead of clamping the merged mesh to the smallest LOD count.
+	 * The merged mesh then keeps the largest LOD count of the sources, or MaxLODCount when it is set.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LOD")
+	bool bSynthesizeMissingLODs = false;
+
+	/** Number of merged LODs when synthesizing missing LODs. 0 keeps the largest source LOD count. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LOD", meta = (ClampMin = "0", EditCondition = "bSynthesizeMissingLODs"))
+	int32 MaxLODCount = 0;
+
+	/**
+	 * Fraction of triangles kept by each synthesized LOD, relative to the last LOD authored on the part.
+	 * Entry 0 is the first missing LOD; missing entries keep halving the previous ratio.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LOD", meta = (EditCondition = "bSynthesizeMissingLODs"))
+	TArray<float> SynthesizedLODTriangleRatios;
+
+	/** Use the engine skeletal mesh reduction when it is available, otherwise fall back to the built-in edge collapse. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LOD", meta = (EditCondition = "bSynthesizeMissingLODs"))
+	bool bPreferEngineReduction = true;
+
+	/** Per source mesh LOD at which the mesh is removed from the merged mesh (its sections, and bones only it uses). */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LOD")
+	TArray<FJrPartLODCullRule> PartCullRules;
+
+	/**
+	 * Parts whose screen size falls below this value are removed from a merged LOD. The part screen size is the LOD screen size
+	 * scaled by the part bounds radius relative to the merged bounds radius. 0 disables it; LOD 0 always keeps every part.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "LOD", meta = (ClampMin = "0", ClampMax = "1"))
+	float MinPartScreenSize = 0.f;
+
+	/**
+	 * Remove the merged reference skeleton bones nothing needs: bones without skin weights, sockets, virtual bones
+	 * or keep-list entries, and that are not an ancestor of such a bone. Only the mesh reference skeleton is pruned,
+	 * the USkeleton asset (shared with the animations) keeps every bone.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Skeleton")
+	bool bPruneUnusedBones = false;
+
+	/**
+	 * Also keep the RequiredBones of the source LODs when pruning.
+	 * RequiredBones usually lists every bone of the source mesh, so this mostly keeps bones of parts with custom LOD bone lists.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Skeleton", meta = (EditCondition = "bPruneUnusedBones"))
+	bool bKeepRequiredBones = false;
+
+	/** Bones always kept when pruning (e.g. bones driven by gameplay code or attachments added at runtime). */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Skeleton", meta = (EditCondition = "bPruneUnusedBones"))
+	TArray<FName> BonesToKeep;
+
+	/** Per-LOD bone reduction of the merged mesh, for far LODs / crowds. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Skeleton")
+	TArray<FJrLODBoneReduction> LODBoneReductions;
+
+	/**
+	 * Bone renames applied while merging, to keep same-named bones of different skeletons apart.
+	 * Bones, sockets and skin weights of the merged mesh use the new names; keep lists and bone reductions use the merged names.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Skeleton")
+	TArray<FJrBoneNameRemap> BoneNameRemaps;
+
+	/** Skin weight storage of the merged LODs, see EJrBoneInfluenceMode. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Skinning")
+	EJrBoneInfluenceMode BoneInfluenceMode = EJrBoneInfluenceMode::Auto;
+
+	/**
+	 * Recompute the UV channel densities of the merged materials (texture streaming) from the merged LOD 0 triangles, instead of
+	 * taking the largest density of the sources, which is wrong once the UVs are transformed (atlasing).
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Streaming")
+	bool bRecomputeUVDensities = true;
+
+	/**
+	 * Vertex streams keeping a CPU copy, instead of every stream with FSkeletalMeshMergeParams::bNeedsCpuAccess.
+	 * Indices have no switch, the engine index container always keeps the merged indices on the CPU.
+	 * Ignored when every stream is needed anyway (CPU skinning). Also applies to meshes loaded from the merge cache.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Memory", meta = (Bitmask, BitmaskEnum = "/Script/JrSkeletalMeshMerger.EJrCPUAccessStream"))
+	int32 CPUAccessStreams = 0;
+
+	/**
+	 * Measure, for each merged LOD, the position error half or 16 bit positions would have (FJrLODMergeStats::HalfPositionError).
+	 * Report only: the merged positions stay float3, which is what the engine skin vertex factory reads. Costs two passes over the positions.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Memory")
+	bool bMeasurePositionErrors = false;
+
+	/** Hidden-surface removal between layered parts. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Masking")
+	TArray<FJrPartMaskRule> PartMaskRules;
+
+	/**
+	 * Store where each merged LOD 0 vertex comes from on the merged mesh (editor only), used by the merge validator.
+	 * Debugging aid: two int32 per LOD 0 vertex, also written to the merge cache files.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Validation")
+	bool bRecordVertexProvenance = false;
+
+	/**
+	 * Reuse merged meshes across sessions through the cache files in Saved/JrMergeCache, keyed by the sources content and the settings.
+	 * The cache file is written before the upload, the merged mesh keeps the CPU copies asked by CPUAccessStreams only.
+	 * The vertex provenance is stored with the cached mesh.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Cache")
+	bool bUseMergeCache = false;
+
+	/**
+	 * Merge large source lists as a tree: disjoint groups of HierarchicalGroupSize consecutive sources are merged in parallel
+	 * into intermediate meshes, which are merged the same way until one final merge is left. The sections keep the flat merge order.
+	 * Merges using part mask rules, part culling or forced section mappings are always flat.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Hierarchical")
+	bool bHierarchicalMerge = false;
+
+	/** Number of meshes merged together at each level of a hierarchical merge. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Hierarchical", meta = (ClampMin = "3", EditCondition = "bHierarchicalMerge"))
+	int32 HierarchicalGroupSize = 8;
+
+	/**
+	 * Keep the intermediate meshes of a hierarchical merge for the session, keyed by their sources and settings,
+	 * so outfits sharing a group of parts (e.g. body + underwear) merge it once. The 64 most recently used ones are kept,
+	 * see FJrHierarchicalMerge::ClearSubgroupCache.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Hierarchical", meta = (EditCondition = "bHierarchicalMerge"))
+	bool bCacheSubgroups = true;
+
+	/** Replaces 'Original' by 'Copy' in the per-mesh rules, for source meshes that are duplicated before merging. */
+	void RemapSourceMesh(const USkeletalMesh* Original, USkeletalMesh* Copy)
+	{
+		for (FJrPartLODCullRule& Rule : PartCullRules)
+		{
+			if (Rule.Mesh == Original)
+			{
+				Rule.Mesh = Copy;
+			}
+		}
+		for (FJrPartMaskRule& Rule : PartMaskRules)
+		{
+			if (Rule.CoveringMesh == Original)
+			{
+				Rule.CoveringMesh = Copy;
+			}
+			for (TObjectPtr<USkeletalMesh>& MaskedMesh : Rule.MaskedMeshes)
+			{
+				if (MaskedMesh == Original)
+				{
+					MaskedMesh = Copy;
+				}
+			}
+		}
+	}
+
+	/** Returns the triangle ratio of the synthesized LOD that is 'StepsPastLastLOD' LODs past the last authored one. */
+	float GetSynthesizedLODTriangleRatio(int32 StepsPastLastLOD) const
+	{
+		float Ratio = 1.f;
+		for (int32 Step = 0; Step <= StepsPastLastLOD; ++Step)
+		{
+			Ratio = SynthesizedLODTriangleRatios.IsValidIndex(Step) ? SynthesizedLODTriangleRatios[Step] : Ratio * 0.5f;
+		}
+		return FMath::Clamp(Ratio, 0.01f, 1.f);
+	}
+
+	/** Returns the merged name of a bone of 'Skeleton', 'BoneName' if no remap renames it. */
+	FName RemapBoneName(const USkeleton* Skeleton, FName BoneName) const
+	{
+		for (const FJrBoneNameRemap& Remap : BoneNameRemaps)
+		{
+			if (Remap.Skeleton == Skeleton)
+			{
+				if (const FName* NewName = Remap.BoneNames.Find(BoneName))
+				{
+					return *NewName;
+				}
+			}
+		}
+		return BoneName;
+	}
+};
+
+/**
+* Source of every LOD 0 vertex of a merged mesh, so the merged mesh can be compared with its parts.
+* Editor only, it is not cooked.
+*/
+UCLASS()
+class JRSKELETALMESHMERGER_API UJrMergeProvenanceUserData : public UAssetUserData
+{
+	GENERATED_BODY()
+
+public:
+	/** Meshes that were merged, in merge order. */
+	UPROPERTY(VisibleAnywhere, Category = "Validation")
+	TArray<TSoftObjectPtr<USkeletalMesh>> SourceMeshes;
+
+	/** Source LOD merged into LOD 0 (StripTopLODs). */
+	UPROPERTY(VisibleAnywhere, Category = "Validation")
+	int32 SourceLODIndex = 0;
+
+	/** Index in SourceMeshes of each merged vertex. */
+	UPROPERTY()
+	TArray<int32> VertexPartIndices;
+
+	/** Vertex index in the source LOD of each merged vertex. */
+	UPROPERTY()
+	TArray<int32> VertexSourceIndices;
+
+	virtual bool IsEditorOnly() const override { return true; }
+};